@@ -12,6 +12,7 @@ parser.add_argument('--tscale', dest='tscale', type=float, default=1)
 parser.add_argument('--start', dest='start', type=int, default=0)
 parser.add_argument('--stop', dest='stop', type=int, default=0)
 parser.add_argument('--f', dest='fname', type=str, default="")
+parser.add_argument('--summary', dest='summary', action='store_true')
 
 args = parser.parse_args()
 
@@ -22,13 +23,22 @@ tscale = max(args.tscale,1)
 
 xs = []
 distances = []
-for time, _, dlist in OrbitData.read(sys.stdin):
-	xs.append(time)
-	distances.append(dlist)
+lows, highs = [], []
+if args.summary:  # nbody -S output: window means, with min to max shaded
+	for time, _, mean, low, high, _, _, _, _ in OrbitData.read_summaries(sys.stdin):
+		xs.append(time)
+		distances.append(mean)
+		lows.append(low)
+		highs.append(high)
+else:
+	for time, _, dlist in OrbitData.read(sys.stdin):
+		xs.append(time)
+		distances.append(dlist)
 
 print "Read all data"
 
 distances = numpy.transpose(distances)
+lows, highs = numpy.transpose(lows), numpy.transpose(highs)
 
 print "Transposed distance arrays"
 
@@ -36,7 +46,7 @@ def movingaverage(interval, window_size):
 	window = numpy.ones(int(window_size))/float(window_size)
 	return numpy.convolve(interval, window, 'same')
 
-if smooth > 1:
+if smooth > 1 and not args.summary:  # summaries are averaged already
 	avrgdt = sum(b-a for a,b in zip(xs,xs[1:]))/(len(xs)-1)
 	window = int(round(smooth/(2*avrgdt)))
 	xs = xs[window:-window]
@@ -48,11 +58,14 @@ while xs[starti] < start: starti += 1
 if stop <= start:
 	xs = xs[starti:]
 	distances = [dl[starti:] for dl in distances]
+	lows, highs = [dl[starti:] for dl in lows], [dl[starti:] for dl in highs]
 else:
 	stopi = len(xs) - 1
 	while xs[stopi] > stop: stopi -= 1
 	xs = xs[starti:stopi]
 	distances = [dl[starti:stopi] for dl in distances]
+	lows = [dl[starti:stopi] for dl in lows]
+	highs = [dl[starti:stopi] for dl in highs]
 
 if tscale > 1:
 	xs = [t/tscale for t in xs]
@@ -62,6 +75,9 @@ for i, dlist in enumerate(distances):
 	plt.subplot(rows, 1, i+1)
 	plt.plot(xs, dlist)
 	ymin, ymax = min(dlist), max(dlist)
+	if args.summary:
+		plt.fill_between(xs, lows[i], highs[i], alpha=0.3)
+		ymin, ymax = min(lows[i]), max(highs[i])
 	buffer = (ymax - ymin)/10.0
 	plt.ylim(ymin-buffer, ymax+buffer)
 	print "Finished Plot ", (i+1)
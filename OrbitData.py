@@ -1,4 +1,5 @@
 from itertools import combinations
+import struct
 from mpmath import hypot
 
 def read(input):
@@ -23,6 +24,22 @@ def read(input):
 			state = "num"
 			yield time, bodies, distances
 
+def read_summaries(input):
+	"""Distance summaries, as written by nbody -S (see src/summary.cpp).
+	Yields (time, start, mean, min, max, closest, closest_time, a, e) for
+	each: the time of the summary and the start of its window, lists of the
+	mean, minimum and maximum distance of each pair over the window, of the
+	closest approach of each pair so far and its time, and lists of the
+	semi-major axis and eccentricity of particles 1 to n-1 around
+	particle 0."""
+	while True:
+		line = input.readline()
+		if line == "": return
+		if line.strip() == "": continue
+		count, time, start = map(float, line.split())
+		rows = [list(map(float, input.readline().split())) for _ in range(7)]
+		yield tuple([time, start] + rows)
+
 def write(output, time, bodies):
 	output.write("%d %f\n" % (len(bodies), time))
 	for b in bodies:
@@ -30,4 +47,188 @@ def write(output, time, bodies):
 	distances = []
 	for p, b in combinations(bodies, 2):
 		distances.append(str(hypot(p.x-b.x, p.y-b.y)))
-	output.write(" ".join(distances)+'\n')
\ No newline at end of file
+	output.write(" ".join(distances)+'\n')
+
+# Binary snapshot files, as written by nbody -O (see src/snapfile.cpp).
+
+SNAP_HEADER = [('magic', 'S8'), ('version', '<i4'), ('ndim', '<i4'),
+	('n', '<i8'), ('ndst', '<i8'), ('nrec', '<i8'), ('index_offset', '<i8'),
+	('unit_mass', '<f8'), ('unit_length', '<f8'), ('unit_time', '<f8'),
+	('G', '<f8'), ('codec', '<i4'), ('keep_bits', '<i4'),
+	('key_interval', '<i8'), ('reserved', 'V32')]
+
+class SnapshotFile(object):
+	"""A binary snapshot file, mapped into memory.  Records are read in
+	place, without copying: s.mass[r], s.pos[r], s.vel[r] and s.dst[r] are
+	numpy arrays for record r, and s.times holds the time of every record.
+	s.at(t) returns the index of the first record at or after time t.
+	Iterating gives (time, bodies, distances) like read()."""
+
+	def __init__(self, path):
+		import numpy, os
+		head = numpy.fromfile(path, dtype=SNAP_HEADER, count=1)[0]
+		if head['magic'] != b'SOLIASNP':
+			raise ValueError("%s is not a binary snapshot file" % path)
+		if head['codec'] != 0:
+			raise ValueError("%s is compressed, see CompressedSnapshotFile" % path)
+		n, ndim, ndst = int(head['n']), int(head['ndim']), int(head['ndst'])
+		record = numpy.dtype([('t', '<f8'), ('mass', '<f8', (n,)),
+			('pos', '<f8', (n, ndim)), ('vel', '<f8', (n, ndim)),
+			('dst', '<f8', (ndst,))])
+		hsize = numpy.dtype(SNAP_HEADER).itemsize
+		if head['index_offset'] > 0:
+			nrec = int(head['nrec'])
+		else:  # unfinished file: count the complete records
+			nrec = (os.path.getsize(path) - hsize) // record.itemsize
+		self.header = head
+		self.records = numpy.memmap(path, dtype=record, mode='r',
+			offset=hsize, shape=(nrec,))
+		if head['index_offset'] > 0:
+			self.times = numpy.memmap(path, dtype='<f8', mode='r',
+				offset=int(head['index_offset']), shape=(nrec,))
+		else:
+			self.times = self.records['t']
+		self.mass = self.records['mass']
+		self.pos = self.records['pos']
+		self.vel = self.records['vel']
+		self.dst = self.records['dst']
+
+	def __len__(self):
+		return len(self.records)
+
+	def at(self, t):
+		import numpy
+		return int(numpy.searchsorted(self.times, t))
+
+	def __iter__(self):
+		for r in range(len(self.records)):
+			bodies = [(m,) + tuple(p) + tuple(v) for m, p, v in
+				zip(self.mass[r], self.pos[r], self.vel[r])]
+			yield self.times[r], bodies, self.dst[r]
+
+def _bits(x):
+	return struct.unpack('<Q', struct.pack('<d', x))[0]
+
+def _double(b):
+	return struct.unpack('<d', struct.pack('<Q', b & 0xffffffffffffffff))[0]
+
+def _round(b, drop):
+	if drop == 0: return b
+	half = 1 << (drop - 1)
+	return (b + half) & ~((half << 1) - 1)
+
+class CompressedSnapshotFile(object):
+	"""A compressed binary snapshot file, as written by nbody -O with -Z,
+	decoded as it is read (see src/compress.cpp for the encoding).
+	s.times holds the time of every record, s.record(r) returns (time, mass,
+	pos, vel, dst) for record r as numpy arrays, and s.at(t) the first
+	record at or after time t.  Iterating gives (time, bodies, distances)
+	like read(), decoding each record once.  Pure Python, so slow for large
+	files; snapconv turns them into plain binary or text much faster."""
+
+	def __init__(self, path):
+		import numpy
+		head = numpy.fromfile(path, dtype=SNAP_HEADER, count=1)[0]
+		if head['magic'] != b'SOLIASNP' or head['codec'] != 1:
+			raise ValueError("%s is not a compressed snapshot file" % path)
+		self.header = head
+		self.n, self.ndim = int(head['n']), int(head['ndim'])
+		self.ndst = int(head['ndst'])
+		self.nval = 1 + self.n * (1 + 2 * self.ndim) + self.ndst
+		self.nexact = 1 + self.n
+		self.drop = 52 - int(head['keep_bits'])
+		self.key = int(head['key_interval'])
+		self.file = open(path, 'rb')
+		self.next = -1
+		if head['index_offset'] > 0:
+			nrec = int(head['nrec'])
+			self.file.seek(int(head['index_offset']))
+			self.times = numpy.fromfile(self.file, dtype='<f8', count=nrec)
+			self.offsets = numpy.fromfile(self.file, dtype='<i8', count=nrec)
+		else:  # unfinished file: follow the byte counts
+			times, offsets = [], []
+			offset = numpy.dtype(SNAP_HEADER).itemsize
+			while True:
+				offsets.append(offset)
+				rec = self._decode(len(offsets) - 1, offsets)
+				if rec is None:
+					offsets.pop()
+					break
+				times.append(rec[0])
+				offset += 4 + self.size
+			self.times = numpy.array(times)
+			self.offsets = numpy.array(offsets, dtype='<i8')
+
+	def _decode(self, r, offsets):
+		"""Decodes record r, which must follow the last one decoded unless it
+		is a key record; None if it is incomplete."""
+		self.file.seek(int(offsets[r]))
+		count = self.file.read(4)
+		if len(count) < 4: return None
+		self.size = struct.unpack('<I', count)[0]
+		data = bytearray(self.file.read(self.size))
+		if len(data) < self.size: return None
+		if r % self.key == 0:
+			self.hist = []
+		h = self.hist
+		a = h[0] if len(h) > 0 else [0.0] * self.nval
+		b = h[1] if len(h) > 1 else a
+		c = h[2] if len(h) > 2 else b
+		rec = [0.0] * self.nval
+		p = 0
+		for i in range(self.nval):
+			if i % 2 == 0:
+				codes = data[p]
+				p += 1
+			code = (codes >> (4 * (i % 2))) & 0xf
+			zeros = code & 7
+			if zeros >= 4: zeros += 1
+			res = 0
+			for k in range(8 - zeros):
+				res |= data[p + k] << (8 * k)
+			p += 8 - zeros
+			drop = 0 if i < self.nexact else self.drop
+			d = a[i] - b[i]
+			pred = d + d + d + c[i] if code & 8 else a[i] + d
+			rec[i] = _double((res << drop) ^ _round(_bits(pred), drop))
+		self.hist = [rec] + h[:2]
+		self.next = r + 1
+		return rec
+
+	def __len__(self):
+		return len(self.times)
+
+	def at(self, t):
+		import numpy
+		return int(numpy.searchsorted(self.times, t))
+
+	def record(self, r):
+		import numpy
+		if r != self.next:
+			for k in range(r - r % self.key, r):
+				self._decode(k, self.offsets)
+		rec = numpy.array(self._decode(r, self.offsets))
+		n, ndim = self.n, self.ndim
+		mass = rec[1:1 + n]
+		pos = rec[1 + n:1 + n + n * ndim].reshape(n, ndim)
+		vel = rec[1 + n + n * ndim:1 + n + 2 * n * ndim].reshape(n, ndim)
+		return rec[0], mass, pos, vel, rec[1 + n + 2 * n * ndim:]
+
+	def __iter__(self):
+		for r in range(len(self.times)):
+			t, mass, pos, vel, dst = self.record(r)
+			bodies = [(m,) + tuple(q) + tuple(v) for m, q, v in
+				zip(mass, pos, vel)]
+			yield t, bodies, dst
+
+def open_snapshots(path):
+	"""Snapshots from the file at path, binary, compressed or text."""
+	with open(path, 'rb') as f:
+		binary = f.read(8) == b'SOLIASNP'
+	if binary:
+		import numpy
+		head = numpy.fromfile(path, dtype=SNAP_HEADER, count=1)[0]
+		if head['codec'] != 0:
+			return CompressedSnapshotFile(path)
+		return SnapshotFile(path)
+	return read(open(path))
\ No newline at end of file
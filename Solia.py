@@ -0,0 +1,159 @@
+"""The nbody integrator in process, through libsolia.so (make libsolia.so;
+see inc/solia.h and src/library.cpp).  Positions, velocities and distances
+are numpy arrays over the integrator's own memory, so looking at a system
+between steps costs no copying and no text parsing."""
+
+import ctypes, os
+
+class State(ctypes.Structure):
+	_fields_ = [('n', ctypes.c_int), ('ndim', ctypes.c_int),
+		('real_size', ctypes.c_int), ('ndst', ctypes.c_int),
+		('t', ctypes.c_double), ('steps', ctypes.c_longlong),
+		('energy', ctypes.c_double), ('gm', ctypes.c_void_p),
+		('pos', ctypes.c_void_p), ('vel', ctypes.c_void_p),
+		('dst', ctypes.c_void_p), ('stop', ctypes.c_char_p),
+		('stop_t', ctypes.c_double), ('stop_i', ctypes.c_int),
+		('stop_j', ctypes.c_int), ('stop_value', ctypes.c_double)]
+
+CALLBACK = ctypes.CFUNCTYPE(ctypes.c_int, ctypes.c_void_p,
+	ctypes.POINTER(State))
+
+_lib = None
+
+def library():
+	"""Loads libsolia.so from $SOLIA_LIB, or else from next to this file."""
+	global _lib
+	if _lib is None:
+		path = os.environ.get('SOLIA_LIB') or os.path.join(
+			os.path.dirname(os.path.abspath(__file__)), 'libsolia.so')
+		lib = ctypes.CDLL(path)
+		doubles = ctypes.POINTER(ctypes.c_double)
+		lib.solia_create.restype = ctypes.c_void_p
+		lib.solia_create.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_int,
+			doubles, doubles, doubles, ctypes.c_double]
+		lib.solia_destroy.argtypes = [ctypes.c_void_p]
+		lib.solia_set_option.argtypes = [ctypes.c_void_p, ctypes.c_char_p,
+			ctypes.c_double]
+		lib.solia_set_callback.argtypes = [ctypes.c_void_p, CALLBACK,
+			ctypes.c_void_p, ctypes.c_double]
+		lib.solia_evolve.argtypes = [ctypes.c_void_p, ctypes.c_double]
+		lib.solia_modified.argtypes = [ctypes.c_void_p]
+		lib.solia_get_state.argtypes = [ctypes.c_void_p,
+			ctypes.POINTER(State)]
+		_lib = lib
+	return _lib
+
+def _view(address, count, real_size, shape, writeable):
+	"""A numpy array of count reals at address, without copying."""
+	import numpy
+	dtype = numpy.float64 if real_size == 8 else numpy.longdouble
+	buf = (ctypes.c_char * (count * real_size)).from_address(address)
+	a = numpy.frombuffer(buf, dtype=dtype).reshape(shape)
+	a.flags.writeable = writeable
+	return a
+
+class View(object):
+	"""The state of a system at one moment: t, steps, energy (J), and gm
+	(masses times G), pos, vel and dst as numpy arrays over the integrator's
+	memory, in long double for a long double system.  mass gives the
+	masses in kg, computed.  stop is the stop condition that ended the last
+	evolve(), or None, with stop_t, stop_i, stop_j and stop_value."""
+
+	def __init__(self, state):
+		s = state
+		n, ndim, size = s.n, s.ndim, s.real_size
+		self.t, self.steps, self.energy = s.t, s.steps, s.energy
+		self.gm = _view(s.gm, n, size, (n,), False)
+		self.pos = _view(s.pos, n * ndim, size, (n, ndim), True)
+		self.vel = _view(s.vel, n * ndim, size, (n, ndim), True)
+		self.dst = _view(s.dst, s.ndst, size, (s.ndst,), False)
+		self.stop = s.stop.decode() if s.stop else None
+		self.stop_t, self.stop_value = s.stop_t, s.stop_value
+		self.stop_i, self.stop_j = s.stop_i, s.stop_j
+
+	@property
+	def mass(self):
+		return self.gm / G
+
+G = 6.67384e-11  # as in inc/nbody.h
+
+class System(object):
+	"""A system of particles, integrated by nbody's Hermite scheme.  mass
+	(kg), pos and vel (n x ndim) are as in a text snapshot; the system is
+	moved to its center of mass frame like nbody does.  Keyword options are
+	those of nbody by their names in inc/options.h: dt_param (-a), theta
+	(-B), nthreads (-j), s_flag, D_flag, P_flag, stop_dist (-c), esc_dist
+	(-r), hill_factor (-H) and max_derr (-m).
+
+	s.evolve(t) integrates up to time t; s.state() views the system after
+	it.  s.pos and s.vel stay views of the same memory from one evolve() to
+	the next, for as long as s lives, and can be written to, after which
+	s.modified() must be called.  s.on_output(f, dt) calls f(view) at the
+	first step at or after every dt of time during evolve(); the view is
+	only valid during the call, and f returning True ends the evolve()."""
+
+	def __init__(self, mass, pos, vel, t=0.0, long_double=False, **options):
+		import numpy
+		lib = library()
+		mass = numpy.ascontiguousarray(mass, dtype=numpy.float64)
+		pos = numpy.ascontiguousarray(pos, dtype=numpy.float64)
+		vel = numpy.ascontiguousarray(vel, dtype=numpy.float64)
+		n, ndim = pos.shape
+		doubles = ctypes.POINTER(ctypes.c_double)
+		self._lib = lib
+		self._sys = lib.solia_create(n, ndim, int(long_double),
+			mass.ctypes.data_as(doubles), pos.ctypes.data_as(doubles),
+			vel.ctypes.data_as(doubles), t)
+		if not self._sys:
+			raise ValueError("invalid system")
+		self._callback = None
+		for name, value in options.items():
+			self.set_option(name, value)
+		view = self.state()
+		self.pos, self.vel, self.gm = view.pos, view.vel, view.gm
+
+	def __del__(self):
+		if getattr(self, '_sys', None):
+			self._lib.solia_destroy(self._sys)
+			self._sys = None
+
+	def set_option(self, name, value):
+		if self._lib.solia_set_option(self._sys, name.encode(), float(value)):
+			raise KeyError(name)
+
+	def on_output(self, f, dt):
+		if f is None:
+			self._callback = None
+			self._lib.solia_set_callback(self._sys, CALLBACK(), None, 0)
+			return
+		def call(user, state):
+			try:
+				return 1 if f(View(state.contents)) else 0
+			except Exception:
+				import traceback
+				traceback.print_exc()
+				return 1
+		self._callback = CALLBACK(call)   # kept alive with the system
+		self._lib.solia_set_callback(self._sys, self._callback, None, dt)
+
+	def evolve(self, t_end):
+		"""Returns None at t_end, else why the integration ended: the stop
+		condition met, or 'callback'."""
+		r = self._lib.solia_evolve(self._sys, t_end)
+		if r < 0:
+			raise ValueError("options that do not go together")
+		if r == 1:
+			return self.state().stop
+		return 'callback' if r == 2 else None
+
+	def modified(self):
+		self._lib.solia_modified(self._sys)
+
+	def state(self):
+		s = State()
+		self._lib.solia_get_state(self._sys, ctypes.byref(s))
+		return View(s)
+
+	@property
+	def t(self):
+		return self.state().t
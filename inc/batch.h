@@ -0,0 +1,81 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <functional>
+#include "stop.h"
+
+struct options;
+
+namespace NBODY_VARIANT {
+
+struct output_target;
+
+/*-----------------------------------------------------------------------------
+ *  batch_state  --  W systems of n particles each, integrated side by side,
+ *                   one per vector lane: value l of every array belongs to
+ *                   system l, so that the same coordinate of the same
+ *                   particle in all W systems is one vector.  See batch.cpp.
+ *-----------------------------------------------------------------------------
+ */
+
+struct batch_state {
+	int n;                            // particles per system
+	int lanes;                        // W, systems side by side
+	real *block;
+	real *mass;                       // mass[i*W + l]
+	real *pos, *vel, *acc, *jrk;      // pos[(i*NDIM + k)*W + l]
+	real *old_pos, *old_vel, *old_acc, *old_jrk;
+	real *dst;                        // dst[p*W + l], p as in pair_rows()
+	real *dt;                         // time step of each lane, 0 for none
+	real *epot, *coll_time;           // of each lane, after the step
+
+	batch_state() : n(0), lanes(0), block(0) {}
+	batch_state(const batch_state &) = delete;
+	batch_state & operator=(const batch_state &) = delete;
+	~batch_state();
+
+	void reserve(int n, int lanes);
+	void swap();
+};
+
+int batch_width();
+
+const char *batch_kernel_name();
+
+void batch_step(batch_state & b);
+
+void load_lane(batch_state & b, int l, const real mass[],
+			   const real pos[][NDIM], const real vel[][NDIM],
+			   const real acc[][NDIM], const real jrk[][NDIM],
+			   real epot, real coll_time);
+
+void store_lane(const batch_state & b, int l, real pos[][NDIM],
+				real vel[][NDIM], real acc[][NDIM], real jrk[][NDIM],
+				real dst[]);
+
+void copy_lane(batch_state & b, int from, int to);
+
+/*-----------------------------------------------------------------------------
+ *  batch_system  --  one system handed to evolve_batch(), integrated in
+ *                    place, with its output target.
+ *-----------------------------------------------------------------------------
+ */
+
+struct batch_system {
+	const real *mass;
+	real (*pos)[NDIM];
+	real (*vel)[NDIM];
+	real t;
+	output_target *to;        // where its output goes, set by begin()
+	stop_reason why;          // why the integration stopped early, if it did
+};
+
+bool batch_suits(const real mass[], int n);
+
+void evolve_batch(batch_system sys[], int nsys, int n, const options & opt,
+				  const std::function<bool(int)> & begin,
+				  const std::function<void(int)> & end);
+
+}
+
+#endif
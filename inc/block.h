@@ -0,0 +1,19 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+struct options;
+
+namespace NBODY_VARIANT {
+
+struct stop_reason;
+
+real block_step(real desired, real dt_max);
+
+real next_block_step(real dt, real desired, real tau, real dt_max);
+
+stop_reason evolve_block(const real mass[], real pos[][NDIM], real vel[][NDIM],
+						 real dst[], int n, real t, const options & opt);
+
+}
+
+#endif
\ No newline at end of file
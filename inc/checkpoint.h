@@ -0,0 +1,47 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <vector>
+#include "summary.h"
+
+struct options;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  checkpoint  --  the complete state of a run of evolve() between two steps,
+ *                  as written to and read from a checkpoint file; see
+ *                  checkpoint.cpp.
+ *-----------------------------------------------------------------------------
+ */
+
+struct checkpoint {
+	int n = 0;
+	real t = 0;                    // time of the state
+	real t_start = 0, t_end = 0;   // start and end of the whole run
+	real t_dia = 0, t_out = 0;     // next diagnostics and snapshot times
+	real t_sum = 0;                // and summary time
+	int k_out = 0;                 // dense output count, see evolve()
+	int nsteps = 0;                // steps taken since t_start
+	real epot = 0, coll_time = 0;  // of the last force calculation
+	real einit = 0;                // initial energy for the stop conditions
+	real dia_einit = 0;            // and for the diagnostics
+	std::vector<real> mass;        // including G
+	std::vector<real> pos, vel, acc, jrk;   // n*NDIM each
+	summary sum;                   // if the run writes summaries
+};
+
+bool write_checkpoint(const char *name, const checkpoint & ck,
+					  const options & opt);
+
+int checkpoint_ndim(const char *name, bool & long_double);
+
+bool read_checkpoint(const char *name, checkpoint & ck, options & opt);
+
+void catch_stop_signals();
+
+int stop_signal();
+
+}
+
+#endif
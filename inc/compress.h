@@ -0,0 +1,34 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*-----------------------------------------------------------------------------
+ *  xor_codec  --  the state of the encoder or decoder of one stream of
+ *                 records of nval doubles; see compress.cpp.
+ *-----------------------------------------------------------------------------
+ */
+
+struct xor_codec {
+	int nval = 0;                  // doubles per record
+	int nexact = 0;                // leading values never rounded
+	int drop = 0;                  // mantissa bits dropped from the others
+	long long count = 0;           // records since the last reset
+	std::vector<double> prev1, prev2, prev3;   // the last three records
+};
+
+int keep_bits_for(double bound);
+
+void start_codec(xor_codec & c, int nval, int nexact, int keep_bits);
+
+void reset_codec(xor_codec & c);
+
+void encode_record(xor_codec & c, double rec[],
+				   std::vector<unsigned char> & out);
+
+bool decode_record(xor_codec & c, const unsigned char *in, size_t size,
+				   double rec[]);
+
+#endif
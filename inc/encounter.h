@@ -0,0 +1,47 @@
+#ifndef ENCOUNTER_H
+#define ENCOUNTER_H
+
+#include <iosfwd>
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  encounter  --  a close pair taken out of the Hermite integration, with the
+ *                 reduced system in which it is replaced by its center of
+ *                 mass, and statistics over all encounters of a run.
+ *-----------------------------------------------------------------------------
+ */
+
+struct encounter {
+	int i = -1, j = -1;            // the pair, i < j, or -1 if there is none
+	real mi = 0, mj = 0;           // masses of the pair, including G
+	real gm = 0;                   // and their sum
+	real rel_pos[NDIM];            // pos[j] - pos[i]
+	real rel_vel[NDIM];            // vel[j] - vel[i]
+
+	int nr = 0;                    // particles in the reduced system
+	real *mass = 0;
+	particle_state st;             // kept for the next encounter
+	real *dst = 0;
+	real epot = 0, coll_time = 0;
+
+	int count = 0;                 // encounters handled
+	long long steps = 0;           // steps taken in regularized form
+	real time = 0;                 // simulated time spent in them
+	double wall = 0;               // and wall clock time, in seconds
+};
+
+bool start_encounter(const real mass[], const real pos[][NDIM],
+					 const real vel[][NDIM], const real dst[], int n,
+					 real r_reg, encounter & e);
+
+void encounter_step(encounter & e, real pos[][NDIM], real vel[][NDIM],
+					int n, real dt, real r_reg);
+
+void end_encounter(encounter & e);
+
+void write_encounters(const encounter & e, std::ostream & out);
+
+}
+
+#endif
\ No newline at end of file
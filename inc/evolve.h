@@ -1,25 +1,120 @@
 #ifndef EVOLVE_H
 #define EVOLVE_H
 
-void evolve_step(const double mass[], double pos[][NDIM], double vel[][NDIM],
-				 double acc[][NDIM], double jrk[][NDIM], double dst[],
-				 double old_pos[][NDIM], double old_vel[][NDIM],
-				 double old_acc[][NDIM], double old_jrk[][NDIM],
-				 int n, double dt, double & epot, double & coll_time);
-
-void predict_step(double pos[][NDIM], double vel[][NDIM],
-				  const double acc[][NDIM], const double jrk[][NDIM],
-				  int n, double dt);
-
-void correct_step(double pos[][NDIM], double vel[][NDIM],
-				  const double acc[][NDIM], const double jrk[][NDIM],
-				  const double old_pos[][NDIM], const double old_vel[][NDIM],
-				  const double old_acc[][NDIM], const double old_jrk[][NDIM],
-				  int n, double dt);
-
-void get_acc_jrk_pot_coll(const double mass[], const double pos[][NDIM],
-						  const double vel[][NDIM], double acc[][NDIM],
-						  double jrk[][NDIM], double dst[], int n, double & epot,
-						  double & coll_time);
+namespace NBODY_VARIANT {
+
+struct particle_state;
+
+/*-----------------------------------------------------------------------------
+ *  hermite_predict, hermite_correct  --  the Hermite predictor and corrector
+ *                                        for one coordinate of one particle,
+ *                                        for any type with the arithmetic of
+ *                                        real: real itself in evolve.cpp, or
+ *                                        a vector of the same coordinate in
+ *                                        several systems in simd.cpp.
+ *-----------------------------------------------------------------------------
+ */
+
+template<class T>
+inline void hermite_predict(T pos, T vel, T acc, T jrk, T dt,
+							T & new_pos, T & new_vel){
+	new_pos = pos + (vel*dt + acc*dt*dt/2 + jrk*dt*dt*dt/6);
+	new_vel = vel + (acc*dt + jrk*dt*dt/2);
+}
+
+template<class T>
+inline void hermite_correct(T old_pos, T old_vel, T old_acc, T old_jrk,
+							T acc, T jrk, T dt, T & pos, T & vel){
+	vel = old_vel + (old_acc + acc)*dt/2 + (old_jrk - jrk)*dt*dt/12;
+	pos = old_pos + (old_vel + vel)*dt/2 + (old_acc - acc)*dt*dt/12;
+}
+
+void evolve_step(const real mass[], particle_state & s, real dst[],
+				 int n, real dt, real & epot, real & coll_time);
+
+void evolve_step(const real mass[], real pos[][NDIM], real vel[][NDIM],
+				 real acc[][NDIM], real jrk[][NDIM], real dst[],
+				 real old_pos[][NDIM], real old_vel[][NDIM],
+				 real old_acc[][NDIM], real old_jrk[][NDIM],
+				 int n, real dt, real & epot, real & coll_time);
+
+void predict_step(real pos[][NDIM], real vel[][NDIM],
+				  const real acc[][NDIM], const real jrk[][NDIM],
+				  int n, real dt);
+
+void predict_step(const real pos[][NDIM], const real vel[][NDIM],
+				  const real acc[][NDIM], const real jrk[][NDIM],
+				  int n, real dt, real new_pos[][NDIM],
+				  real new_vel[][NDIM]);
+
+void correct_step(real pos[][NDIM], real vel[][NDIM],
+				  const real acc[][NDIM], const real jrk[][NDIM],
+				  const real old_pos[][NDIM], const real old_vel[][NDIM],
+				  const real old_acc[][NDIM], const real old_jrk[][NDIM],
+				  int n, real dt);
+
+void get_acc_jrk_pot_coll(const real mass[], const real pos[][NDIM],
+						  const real vel[][NDIM], real acc[][NDIM],
+						  real jrk[][NDIM], real dst[], int n, real & epot,
+						  real & coll_time);
+
+void get_acc_jrk_pot_coll_scalar(const real mass[], const real pos[][NDIM],
+								 const real vel[][NDIM], real acc[][NDIM],
+								 real jrk[][NDIM], real dst[], int n,
+								 real & epot, real & coll_time);
+
+void get_acc_jrk_pot_coll_parallel(const real mass[], const real pos[][NDIM],
+								   const real vel[][NDIM], real acc[][NDIM],
+								   real jrk[][NDIM], real dst[], int n,
+								   real & epot, real & coll_time);
+
+void pair_rows(const real mass[], const real pos[][NDIM],
+			   const real vel[][NDIM], real acc[][NDIM], real jrk[][NDIM],
+			   real dst[], int nm, int w, int i0, int i1,
+			   real & epot, real & coll_time_q);
+
+void test_rows(const real mass[], const real pos[][NDIM],
+			   const real vel[][NDIM], real acc[][NDIM], real jrk[][NDIM],
+			   real dst[], int n, int nm, int j0, int j1,
+			   real & coll_time_q);
+
+int massive_count(const real mass[], int n);
+
+int dst_width(int nm, int n);
+
+int dst_row(int i, int w);
+
+int dst_count(const real mass[], int n);
+
+void set_test_particles(bool dst, bool coll);
+
+bool test_particle_dst();
+
+bool test_particle_coll();
+
+void set_force_simd(bool simd);
+
+void set_force_threads(int nthreads);
+
+void get_acc_jrk_coll_active(const real mass[], const real pos[][NDIM],
+							 const real vel[][NDIM], real acc[][NDIM],
+							 real jrk[][NDIM], real coll_time[],
+							 const int active[], int nact, int n);
+
+void get_pot_dst(const real mass[], const real pos[][NDIM], real dst[],
+				 int n, real & epot);
+
+void get_dst(const real mass[], const real pos[][NDIM], real dst[],
+			 int n);
+
+void interpolate_step(const real old_pos[][NDIM],
+					  const real old_vel[][NDIM],
+					  const real old_acc[][NDIM],
+					  const real old_jrk[][NDIM], const real pos[][NDIM],
+					  const real vel[][NDIM], const real acc[][NDIM],
+					  const real jrk[][NDIM], int n, real dt, real tau,
+					  real ipos[][NDIM], real ivel[][NDIM]);
+
+}
 
 #endif
\ No newline at end of file
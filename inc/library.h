@@ -0,0 +1,26 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include "solia.h"
+
+/*-----------------------------------------------------------------------------
+ *  library_api  --  the functions behind the C API of solia.h for one
+ *                   variant of the integrator (see nbody.h), as library.cpp
+ *                   implements them; api.cpp picks the variant.  The system
+ *                   is opaque to api.cpp, hence void *.
+ *-----------------------------------------------------------------------------
+ */
+
+struct library_api {
+	void *(*create)(int n, const double mass[], const double pos[],
+					const double vel[], double t);
+	void (*destroy)(void *sys);
+	int (*set_option)(void *sys, const char *name, double value);
+	void (*set_callback)(void *sys, solia_callback cb, void *user,
+						 double dt_out);
+	int (*evolve)(void *sys, double t_end);
+	void (*modified)(void *sys);
+	void (*get_state)(void *sys, solia_state *state);
+};
+
+#endif
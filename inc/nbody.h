@@ -1,9 +1,39 @@
 #ifndef NBODY_H
 #define NBODY_H
 
+/*-----------------------------------------------------------------------------
+ *  The integrator is compiled once for each variant listed in VARIANTS in the
+ *  Makefile, with
+ *
+ *     NBODY_VARIANT      the namespace the variant goes in (d2, d3, l2, l3)
+ *     NBODY_NDIM         the number of spatial dimensions, 2 by default
+ *     NBODY_LONG_DOUBLE  to compute in long double rather than double
+ *
+ *  so that NDIM and real are compile time constants in every variant, and
+ *  the loops over the coordinates can be unrolled.  main() picks the variant
+ *  to run from the command line or a binary snapshot file; see main.cpp.
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef NBODY_VARIANT
+#define NBODY_VARIANT d2
+#endif
+
+#ifndef NBODY_NDIM
+#define NBODY_NDIM 2
+#endif
+
+namespace NBODY_VARIANT {
+
+#ifdef NBODY_LONG_DOUBLE
+typedef long double real;
+#else
 typedef double real;
+#endif
 
-const int NDIM = 2;          // number of spatial dimensions
+const int NDIM = NBODY_NDIM;      // number of spatial dimensions
 const real G = 6.67384e-11;
 
-#endif
\ No newline at end of file
+}
+
+#endif
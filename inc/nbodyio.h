@@ -1,15 +1,49 @@
 #ifndef NBODYIO_H
 #define NBODYIO_H
 
-void get_snapshot(double mass[], double pos[][NDIM], double vel[][NDIM], int n);
+#include <iostream>
+#include <atomic>
 
-void put_snapshot(const double mass[], const double pos[][NDIM],
-				  const double vel[][NDIM], const double dst[],
-				  int n, double t);
+namespace NBODY_VARIANT {
 
-void write_diagnostics(const double mass[], const double pos[][NDIM],
-					   const double vel[][NDIM], const double acc[][NDIM],
-					   const double jrk[][NDIM], int n, double t, double epot,
+struct snap_writer;
+
+/*-----------------------------------------------------------------------------
+ *  output_target  --  where the output of one integration goes, and the
+ *                     energy bookkeeping of its diagnostics.
+ *-----------------------------------------------------------------------------
+ */
+
+struct output_target {
+	std::ostream *snap = &std::cout;   // text snapshots, if set
+	snap_writer *bin = 0;              // binary snapshots instead, if set
+	std::ostream *dia = &std::cerr;    // diagnostics
+	real einit = 0;                    // initial total energy
+	real etot = 0;                     // total energy at the last diagnostics
+	std::ostream *sum = 0;             // summaries, if any (see summary.cpp)
+	std::ostream *prof = 0;            // profile, if any (see profile.cpp)
+	std::atomic<long long> snap_bytes{0};   // snapshot bytes written, counted
+											// only when profiling
+};
+
+void set_output(output_target *to);
+
+output_target *get_output();
+
+bool get_snapshot(real mass[], real pos[][NDIM], real vel[][NDIM], int n);
+
+bool set_up_snapshot(real mass[], real pos[][NDIM], real vel[][NDIM],
+					 int n);
+
+void put_snapshot(const real mass[], const real pos[][NDIM],
+				  const real vel[][NDIM], const real dst[], int ndst,
+				  int n, real t);
+
+void write_diagnostics(const real mass[], const real pos[][NDIM],
+					   const real vel[][NDIM], const real acc[][NDIM],
+					   const real jrk[][NDIM], int n, real t, real epot,
 					   int nsteps, bool x_flag);
 
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef NEIGHBOR_H
+#define NEIGHBOR_H
+
+#include <vector>
+#include <iosfwd>
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  neighbor_state  --  the Ahmad-Cohen split of the force on each particle
+ *                      into an irregular part, from the massive particles
+ *                      nearest to it, and a regular part from all
+ *                      others, kept with its derivatives from the last
+ *                      regular step; see neighbor.cpp.
+ *-----------------------------------------------------------------------------
+ */
+
+struct neighbor_state {
+	int target = 0;                       // neighbors wanted per particle
+	bool all = false;                     // every massive one is a neighbor
+	real eta = 0;                         // regular step per time scale
+	std::vector<std::vector<int>> list;   // neighbors of each particle
+	std::vector<real> radius;             // rank of the farthest neighbor
+	std::vector<real> reg_acc, reg_jrk;   // regular force, [i*NDIM + k],
+	std::vector<real> reg_snp;            // and its second derivative
+	std::vector<real> t_reg;              // time of the last regular step
+	std::vector<real> dt_reg;             // regular step size
+	std::vector<real> reg_want;           // next regular step wanted
+	std::vector<char> regular;            // 1 if the last step was regular
+	long long nreg = 0;                   // regular steps so far
+	long long nirr = 0;                   // irregular steps so far
+};
+
+void start_neighbors(neighbor_state & nb, int target, real eta,
+					 const real mass[], const real pos[][NDIM],
+					 const real vel[][NDIM], real acc[][NDIM],
+					 real jrk[][NDIM], real coll_time[], int n);
+
+void get_acc_jrk_coll_neighbors(neighbor_state & nb, const real mass[],
+								const real pos[][NDIM],
+								const real vel[][NDIM], real acc[][NDIM],
+								real jrk[][NDIM], real coll_time[],
+								const int active[], int nact, int n,
+								real tau);
+
+void next_regular_steps(neighbor_state & nb, real step[], const int active[],
+						int nact, real tau, real dt_max);
+
+void write_neighbors(const neighbor_state & nb, std::ostream & out);
+
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+/*-----------------------------------------------------------------------------
+ *  options  --  the run parameters set from the command line by
+ *               read_options(), with their defaults.
+ *-----------------------------------------------------------------------------
+ */
+
+struct options {
+	double dt_param = 0.03;  // control parameter to determine time step size
+	double dt_dia = 0;       // time interval between diagnostics output
+	double dt_out = 60;      // time interval between output of snapshots
+	double dt_tot = 3600;    // duration of the integration; default 1 hour
+	bool   x_flag = false;   // if true: extra debugging diagnostics output
+	bool   b_flag = false;   // if true: individual block time steps
+	int    nb_count = 0;     // neighbors per particle for the Ahmad-Cohen
+							 // scheme with -b; 0 for none
+	bool   s_flag = false;   // if true: vectorized force kernel
+	int    nthreads = 1;     // number of threads for the force calculation
+	double theta = 0;        // tree code opening angle; 0 for direct summation
+	bool   D_flag = false;   // if true: no distances for test particles
+	bool   P_flag = false;   // if true: test particles limit the time step
+	const char *in_file = 0;   // binary snapshot file to start from, or 0
+	const char *out_file = 0;  // binary snapshot file for output, or 0
+	double z_bound = -1;     // relative error of compressed binary output;
+							 // 0 for lossless, -1 for no compression
+	int    queue_depth = 4;  // snapshots waiting for the writer thread
+	bool   e_flag = false;   // if true: snapshots at exact output times
+	double dt_sum = 0;       // time interval between distance summaries,
+							 // instead of text snapshots; 0 for none
+	const char *ensemble = 0;  // output file prefix for an ensemble run, or 0
+	bool   V_flag = false;   // if true: ensemble systems batched across
+							 // vector lanes
+	double stop_dist = 0;    // stop at a closer approach of massive particles
+	double esc_dist = 0;     // stop at an unbound particle beyond this radius
+	double hill_factor = 0;  // stop within this many mutual Hill radii
+	double max_derr = 0;     // stop beyond this relative energy error
+	double wh_frac = 0;      // Wisdom-Holman step in shortest orbital periods;
+							 // 0 for the Hermite scheme
+	double r_reg = 0;        // regularize pairs closer than this; 0 for none
+	int    ndim = 0;         // number of dimensions; 0 to take it from the
+							 // -I file, or 2 without one
+	bool   L_flag = false;   // if true: long double precision
+	const char *profile = 0;   // profile output file, "-" for stderr, or 0
+	const char *checkpoint = 0;   // checkpoint file to write, or 0
+	double ck_interval = 600;  // wall clock seconds between checkpoints
+	int    slices = 0;       // parareal time slices; 0 for a serial run
+	double pr_tol = 1e-9;    // parareal tolerance, relative to the state
+};
+
+#endif
\ No newline at end of file
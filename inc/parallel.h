@@ -0,0 +1,18 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+void set_thread_count(int nthreads);
+
+int get_thread_count();
+
+void parallel_for(int ntasks, const std::function<void(int)> & task);
+
+int pair_task_count(double npairs);
+
+void balance_pair_rows(int n, int nparts, int bounds[]);
+
+void steal_for(int ntasks, int nthreads, const std::function<void(int)> & task);
+
+#endif
\ No newline at end of file
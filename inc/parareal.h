@@ -0,0 +1,40 @@
+#ifndef PARAREAL_H
+#define PARAREAL_H
+
+#include <vector>
+#include <functional>
+
+struct options;
+
+namespace NBODY_VARIANT {
+
+struct stop_reason;
+
+/*-----------------------------------------------------------------------------
+ *  parareal_result  --  the outcome of parareal(); see parareal.cpp.
+ *-----------------------------------------------------------------------------
+ */
+
+struct parareal_result {
+	int iterations = 0;       // fine sweeps done
+	real change = 0;          // largest relative change in the last one
+	bool converged = false;   // change fell to the tolerance
+	long long steps = 0;      // fine steps of the last sweep, all slices
+	double serial_s = 0;      // wall time of those steps, added up
+};
+
+long long propagate(const real mass[], real x[], int n, real t0, real t1,
+					real dt_param);
+
+parareal_result parareal(const real mass[], int n, real t0, real t1,
+						 int nslices, real dt_param, real tol, int nthreads,
+						 std::vector<real> & u,
+						 const std::function<void(int, real)> & progress);
+
+stop_reason evolve_parareal(const real mass[], real pos[][NDIM],
+							real vel[][NDIM], real dst[], int n, real t,
+							const options & opt);
+
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <iosfwd>
+#include <map>
+#include <utility>
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  profile  --  the counters of one profiled integration; see profile.cpp.
+ *               Only built into the program with NBODY_PROFILE defined.
+ *-----------------------------------------------------------------------------
+ */
+
+enum profile_phase { PROF_PREDICT, PROF_FORCE, PROF_CORRECT, PROF_OUTPUT,
+					 PROF_NPHASE };
+
+struct profile {
+	std::ostream *out;                 // where the JSON lines go
+	double start;                      // wall clock time at the start
+	double phase[PROF_NPHASE];         // wall time spent in each phase
+	long long steps;
+	std::map<int, long long> dt_hist;  // steps per binary exponent of dt
+	int limit_i, limit_j;              // pair limiting the last sampled step
+	std::map<std::pair<int, int>, long long> limits;   // and all samples
+};
+
+#ifdef NBODY_PROFILE
+#define PROFILE_START(t)        double t = profile_clock()
+#define PROFILE_STOP(phase, t)  profile_add(phase, t)
+#else
+#define PROFILE_START(t)
+#define PROFILE_STOP(phase, t)
+#endif
+
+void start_profile(profile & p, std::ostream & out);
+
+profile *get_profile();
+
+double profile_clock();
+
+void profile_add(profile_phase phase, double since);
+
+void profile_step(const real mass[], const real pos[][NDIM],
+				  const real vel[][NDIM], int n, real dt);
+
+void write_profile(real t, long long bytes, bool final);
+
+void stop_profile();
+
+}
+
+#endif
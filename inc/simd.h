@@ -0,0 +1,15 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+namespace NBODY_VARIANT {
+
+void get_acc_jrk_pot_coll_simd(const real mass[], const real pos[][NDIM],
+							   const real vel[][NDIM], real acc[][NDIM],
+							   real jrk[][NDIM], real dst[], int n,
+							   real & epot, real & coll_time);
+
+const char *simd_kernel_name();
+
+}
+
+#endif
\ No newline at end of file
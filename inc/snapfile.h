@@ -0,0 +1,91 @@
+#ifndef SNAPFILE_H
+#define SNAPFILE_H
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include "compress.h"
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  snap_header  --  the fixed 128-byte header at the start of a binary
+ *                   snapshot file; see snapfile.cpp for the layout.
+ *-----------------------------------------------------------------------------
+ */
+
+struct snap_header {
+	char    magic[8];         // "SOLIASNP"
+	int32_t version;          // SNAP_VERSION, or SNAP_VERSION_XOR if
+							  // compressed
+	int32_t ndim;             // number of dimensions
+	int64_t n;                // number of particles
+	int64_t ndst;             // number of distances per record
+	int64_t nrec;             // number of records, 0 until the file is closed
+	int64_t index_offset;     // byte offset of the time index, 0 if none
+	double  unit_mass;        // units of the stored values in kg, m, s
+	double  unit_length;
+	double  unit_time;
+	double  G;                // gravitational constant used by the run
+	int32_t codec;            // SNAP_RAW or SNAP_XOR
+	int32_t keep_bits;        // mantissa bits kept by SNAP_XOR, 52 lossless
+	int64_t key_interval;     // SNAP_XOR records between full records
+	char    reserved[32];
+};
+
+static_assert(sizeof(snap_header) == 128, "snap_header must be 128 bytes");
+
+struct snap_writer {
+	FILE *file;
+	snap_header head;
+	std::vector<double> times;     // the time index, written on closing
+	std::vector<double> record;    // one record, assembled before writing
+	std::vector<real> mass;        // masses in kg, for put_snapshot_binary()
+	int64_t end;                   // file offset after the last record
+	xor_codec codec;               // for SNAP_XOR
+	std::vector<unsigned char> packed;  // one encoded record
+	std::vector<int64_t> offsets;  // of every record, written on closing
+
+	snap_writer() : file(0) {}
+};
+
+struct snap_reader {
+	FILE *file;
+	snap_header head;
+	long long nrec;           // number of complete records
+	std::vector<double> record;    // one record, as read from the file
+	xor_codec codec;               // for SNAP_XOR:
+	long long next;                // the record the codec can decode next
+	std::vector<unsigned char> packed;
+	std::vector<double> times;     // and the index, read on opening
+	std::vector<int64_t> offsets;
+};
+
+bool open_snap_writer(const char *name, int n, int ndst, snap_writer & out,
+					  double bound = -1);
+
+void put_snap_record(snap_writer & out, real t, const real mass[],
+					 const real pos[][NDIM], const real vel[][NDIM],
+					 const real dst[]);
+
+void put_snapshot_binary(snap_writer & out, const real mass[],
+						 const real pos[][NDIM], const real vel[][NDIM],
+						 const real dst[], int ndst, int n, real t);
+
+void close_snap_writer(snap_writer & out);
+
+int snap_file_ndim(const char *name);
+
+bool open_snap_reader(const char *name, snap_reader & in);
+
+bool read_snap_record(snap_reader & in, long long r, real & t,
+					  real mass[], real pos[][NDIM], real vel[][NDIM],
+					  real dst[]);
+
+long long find_snap_record(snap_reader & in, real t);
+
+void close_snap_reader(snap_reader & in);
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef SOLIA_H
+#define SOLIA_H
+
+/*-----------------------------------------------------------------------------
+ *  solia.h: the C API of libsolia.so, the integrator of nbody as a shared
+ *           library, for programs that drive many integrations in process
+ *           and analyse the results as they go; see api.cpp.
+ *-----------------------------------------------------------------------------
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct solia_system solia_system;
+
+/*-----------------------------------------------------------------------------
+ *  solia_state  --  a view of a system, filled in by solia_get_state() and
+ *                   passed to the output callback.  The pointers are to the
+ *                   integrator's own arrays, not copies; their values are
+ *                   real_size bytes each.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct solia_state {
+	int n;                    /* number of particles */
+	int ndim;                 /* number of dimensions, 2 or 3 */
+	int real_size;            /* 8 for double, sizeof(long double) for -L */
+	int ndst;                 /* number of distances in dst */
+	double t;                 /* time */
+	long long steps;          /* steps taken since solia_create() */
+	double energy;            /* total energy in J, from the last forces */
+	const void *gm;           /* masses times G, n values */
+	void *pos, *vel;          /* positions and velocities, n*ndim values */
+	const void *dst;          /* distances between pairs, as in snapshots */
+	const char *stop;         /* the stop condition that ended the last
+								 solia_evolve(), or 0 */
+	double stop_t;            /* time it was met */
+	int stop_i, stop_j;       /* particles involved, -1 if none */
+	double stop_value;        /* distance or energy error that met it */
+} solia_state;
+
+/* Called at the first step at or after every dt_out of system time.  The
+   state is valid during the call only; a nonzero return value ends the
+   solia_evolve() in progress. */
+typedef int (*solia_callback)(void *user, const solia_state *state);
+
+solia_system *solia_create(int n, int ndim, int long_double,
+						   const double mass[], const double pos[],
+						   const double vel[], double t);
+
+void solia_destroy(solia_system *sys);
+
+int solia_set_option(solia_system *sys, const char *name, double value);
+
+void solia_set_callback(solia_system *sys, solia_callback cb, void *user,
+						double dt_out);
+
+int solia_evolve(solia_system *sys, double t_end);
+
+void solia_modified(solia_system *sys);
+
+void solia_get_state(solia_system *sys, solia_state *state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
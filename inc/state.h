@@ -0,0 +1,31 @@
+#ifndef STATE_H
+#define STATE_H
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  particle_state  --  positions, velocities, accelerations and jerks of the
+ *                      particles at the current step and at the previous
+ *                      one, in a single aligned block; see state.cpp.
+ *-----------------------------------------------------------------------------
+ */
+
+struct particle_state {
+	int cap;                          // particles there is room for
+	real *block;
+	real (*pos)[NDIM], (*vel)[NDIM], (*acc)[NDIM], (*jrk)[NDIM];
+	real (*old_pos)[NDIM], (*old_vel)[NDIM];
+	real (*old_acc)[NDIM], (*old_jrk)[NDIM];
+
+	particle_state() : cap(0), block(0) {}
+	particle_state(const particle_state &) = delete;
+	particle_state & operator=(const particle_state &) = delete;
+	~particle_state();
+
+	void reserve(int n);
+	void swap();
+};
+
+}
+
+#endif
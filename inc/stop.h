@@ -0,0 +1,37 @@
+#ifndef STOP_H
+#define STOP_H
+
+#include <iosfwd>
+
+struct options;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  stop_reason  --  why an integration ended early, as found by
+ *                   check_stop(); what is 0 for a run that reached its end.
+ *-----------------------------------------------------------------------------
+ */
+
+struct stop_reason {
+	const char *what = 0;     // "collision", "escape", "hill" or "energy"
+	real t = 0;               // time at which the condition was found
+	int i = -1, j = -1;       // particles involved, -1 if none
+	real value = 0;           // distance or energy error that triggered it
+};
+
+bool stop_checks(const options & opt);
+
+real total_energy(const real mass[], const real vel[][NDIM], int n,
+				  real epot);
+
+bool check_stop(const real mass[], const real pos[][NDIM],
+				const real vel[][NDIM], const real dst[], int n,
+				real t, real epot, real einit, const options & opt,
+				stop_reason & why);
+
+void write_stop(const stop_reason & why, std::ostream & out);
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <vector>
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  summary  --  the distances of dst[] reduced over the steps of a time
+ *               window, and over the whole run; see summary.cpp.
+ *-----------------------------------------------------------------------------
+ */
+
+struct summary {
+	int ndst = 0;
+	real t0 = 0;                   // start of the current window
+	real span = 0;                 // time covered by its steps
+	std::vector<real> sum;         // dst * dt, summed over the window
+	std::vector<real> min, max;    // extremes over the window
+	std::vector<real> closest;     // minimum over the whole run
+	std::vector<real> t_closest;   // and the time it was reached
+};
+
+void start_summary(summary & s, const real dst[], int ndst, real t);
+
+void add_summary_step(summary & s, const real dst[], real t, real dt);
+
+void next_summary_window(summary & s, const real dst[], real t);
+
+void put_summary(const real mass[], const real pos[][NDIM],
+				 const real vel[][NDIM], int n, real t, const summary & s);
+
+}
+
+#endif
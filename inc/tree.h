@@ -0,0 +1,17 @@
+#ifndef TREE_H
+#define TREE_H
+
+namespace NBODY_VARIANT {
+
+void get_acc_jrk_pot_coll_tree(const real mass[], const real pos[][NDIM],
+							   const real vel[][NDIM], real acc[][NDIM],
+							   real jrk[][NDIM], real dst[], int n,
+							   real & epot, real & coll_time);
+
+void set_force_tree(real theta);
+
+bool force_tree();
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef WH_H
+#define WH_H
+
+struct options;
+
+namespace NBODY_VARIANT {
+
+struct stop_reason;
+
+void kepler_drift(real gm, real pos[NDIM], real vel[NDIM], real dt);
+
+real wh_time_step(const real mass[], const real pos[][NDIM],
+				  const real vel[][NDIM], int n, real fraction);
+
+void to_democratic(const real mass[], const real pos[][NDIM],
+				   const real vel[][NDIM], int n, real hpos[][NDIM],
+				   real bvel[][NDIM]);
+
+void from_democratic(const real mass[], const real hpos[][NDIM],
+					 const real bvel[][NDIM], int n, real pos[][NDIM],
+					 real vel[][NDIM]);
+
+void wh_step(const real mass[], real hpos[][NDIM], real bvel[][NDIM],
+			 real acc[][NDIM], int n, real dt);
+
+stop_reason evolve_wh(const real mass[], real pos[][NDIM],
+					  real vel[][NDIM], real dst[], int n, real t,
+					  real dt, const options & opt);
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,28 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+namespace NBODY_VARIANT {
+
+struct summary;
+
+void start_writer(int depth);
+
+void flush_writer();
+
+void stop_writer();
+
+void queue_snapshot(const real mass[], const real pos[][NDIM],
+					const real vel[][NDIM], const real dst[], int ndst,
+					int n, real t);
+
+void queue_diagnostics(const real mass[], const real pos[][NDIM],
+					   const real vel[][NDIM], const real acc[][NDIM],
+					   const real jrk[][NDIM], int n, real t, real epot,
+					   int nsteps, bool x_flag);
+
+void queue_summary(const real mass[], const real pos[][NDIM],
+				   const real vel[][NDIM], int n, real t, const summary & s);
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,68 @@
+/*=============================================================================
+ *
+ *  api.cpp: the C API of libsolia.so (see solia.h), which, like main.cpp
+ *           for nbody, picks one of the variants of the integrator compiled
+ *           into the library (see nbody.h) and hands each call on to it;
+ *           see library.cpp.
+ *
+ *     Positions and velocities come in as n*ndim doubles, particle by
+ *     particle, and masses in kg, as in a text snapshot.  A long double
+ *     system keeps them as long double from then on; its state has
+ *     real_size sizeof(long double).
+ *=============================================================================
+ */
+
+#include "library.h"
+
+namespace d2 { const library_api & library_functions(); }
+namespace d3 { const library_api & library_functions(); }
+namespace l2 { const library_api & library_functions(); }
+namespace l3 { const library_api & library_functions(); }
+
+struct solia_system {
+	const library_api *f;     // of the variant
+	void *sys;
+};
+
+extern "C" {
+
+solia_system *solia_create(int n, int ndim, int long_double,
+						   const double mass[], const double pos[],
+						   const double vel[], double t){
+	if(ndim != 2 && ndim != 3){ return 0; }
+	const library_api *f = long_double
+		? &(ndim == 3 ? l3::library_functions() : l2::library_functions())
+		: &(ndim == 3 ? d3::library_functions() : d2::library_functions());
+	void *sys = f->create(n, mass, pos, vel, t);
+	if(!sys){ return 0; }
+	return new solia_system{f, sys};
+}
+
+void solia_destroy(solia_system *sys){
+	if(!sys){ return; }
+	sys->f->destroy(sys->sys);
+	delete sys;
+}
+
+int solia_set_option(solia_system *sys, const char *name, double value){
+	return sys->f->set_option(sys->sys, name, value);
+}
+
+void solia_set_callback(solia_system *sys, solia_callback cb, void *user,
+						double dt_out){
+	sys->f->set_callback(sys->sys, cb, user, dt_out);
+}
+
+int solia_evolve(solia_system *sys, double t_end){
+	return sys->f->evolve(sys->sys, t_end);
+}
+
+void solia_modified(solia_system *sys){
+	sys->f->modified(sys->sys);
+}
+
+void solia_get_state(solia_system *sys, solia_state *state){
+	sys->f->get_state(sys->sys, state);
+}
+
+}
@@ -0,0 +1,320 @@
+#include <cstdlib>    // for aligned_alloc() and free()
+#include <utility>    // for swap()
+#include <vector>
+#include "nbody.h"
+#include "nbodyio.h"
+#include "evolve.h"
+#include "batch.h"
+#include "writer.h"
+#include "stop.h"
+#include "options.h"
+
+using namespace std;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  batch.cpp: many small systems integrated side by side.
+ *
+ *     The force loops of a system of three to five bodies are too short to
+ *     fill a vector, so the kernels of simd.cpp do not help there.  A scan
+ *     over thousands of such systems can be vectorized the other way: a
+ *     batch_state holds W systems of the same n in the W lanes of the
+ *     vector unit, and batch_step() (in simd.cpp) takes a Hermite step of
+ *     all of them at once, each by the time step from its own collision
+ *     time.  The arithmetic is that of evolve_step(), so each system takes
+ *     the same steps as on its own, to rounding.
+ *
+ *     evolve_batch() keeps the lanes busy: it does the output and stop
+ *     conditions of evolve() for every lane after each step, and when a
+ *     system is done, the next one waiting takes over its lane.  Only when
+ *     none is left does the lane idle, with a time step of 0.
+ *
+ *     Memory layout: every array of batch_state is an array of vectors of W
+ *     values, the value of system l in lane l, all in one block like the
+ *     arrays of particle_state (see state.cpp).
+ *-----------------------------------------------------------------------------
+ */
+
+batch_state::~batch_state(){
+	free(block);
+}
+
+/*-----------------------------------------------------------------------------
+ *  reserve  --  makes room for W = lanes systems of n particles.  The values
+ *               are lost.
+ *-----------------------------------------------------------------------------
+ */
+
+void batch_state::reserve(int n_, int lanes_){
+	free(block);
+	n = n_;
+	lanes = lanes_;
+	int line = 64 / sizeof(real);
+	int len = (n * NDIM * lanes + line - 1) / line * line;   // per array
+	int npairs = n * (n - 1) / 2;
+	int lens[13] = {n * lanes, len, len, len, len, len, len, len, len,
+					npairs * lanes, lanes, lanes, lanes};
+	real **arrays[13] = {&mass, &pos, &vel, &acc, &jrk, &old_pos, &old_vel,
+						 &old_acc, &old_jrk, &dst, &dt, &epot, &coll_time};
+	size_t total = 0;
+	for(int a = 0; a < 13; a++){
+		lens[a] = (lens[a] + line - 1) / line * line;
+		total += lens[a];
+	}
+	block = (real *) aligned_alloc(64, total * sizeof(real));
+	real *p = block;
+	for(int a = 0; a < 13; a++){
+		*arrays[a] = p;
+		p += lens[a];
+	}
+	for(int l = 0; l < lanes; l++){ dt[l] = 0; }
+}
+
+/*-----------------------------------------------------------------------------
+ *  swap  --  makes the current values the old ones, as particle_state::swap()
+ *-----------------------------------------------------------------------------
+ */
+
+void batch_state::swap(){
+	std::swap(pos, old_pos);
+	std::swap(vel, old_vel);
+	std::swap(acc, old_acc);
+	std::swap(jrk, old_jrk);
+}
+
+/*-----------------------------------------------------------------------------
+ *  load_lane  --  puts a system in lane l, with its accelerations and jerks
+ *                 and the potential energy and collision time from them.
+ *-----------------------------------------------------------------------------
+ */
+
+void load_lane(batch_state & b, int l, const real mass[],
+			   const real pos[][NDIM], const real vel[][NDIM],
+			   const real acc[][NDIM], const real jrk[][NDIM],
+			   real epot, real coll_time){
+	int W = b.lanes;
+	for(int i = 0; i < b.n; i++){
+		b.mass[i*W + l] = mass[i];
+		for(int k = 0; k < NDIM; k++){
+			int q = (i*NDIM + k)*W + l;
+			b.pos[q] = pos[i][k];
+			b.vel[q] = vel[i][k];
+			b.acc[q] = acc[i][k];
+			b.jrk[q] = jrk[i][k];
+		}
+	}
+	b.epot[l] = epot;
+	b.coll_time[l] = coll_time;
+}
+
+/*-----------------------------------------------------------------------------
+ *  store_lane  --  copies the system in lane l out, with the distances of
+ *                  the last step.
+ *-----------------------------------------------------------------------------
+ */
+
+void store_lane(const batch_state & b, int l, real pos[][NDIM],
+				real vel[][NDIM], real acc[][NDIM], real jrk[][NDIM],
+				real dst[]){
+	int W = b.lanes;
+	for(int i = 0; i < b.n; i++){
+		for(int k = 0; k < NDIM; k++){
+			int q = (i*NDIM + k)*W + l;
+			pos[i][k] = b.pos[q];
+			vel[i][k] = b.vel[q];
+			acc[i][k] = b.acc[q];
+			jrk[i][k] = b.jrk[q];
+		}
+	}
+	int npairs = b.n * (b.n - 1) / 2;
+	for(int p = 0; p < npairs; p++){ dst[p] = b.dst[p*W + l]; }
+}
+
+/*-----------------------------------------------------------------------------
+ *  copy_lane  --  copies the system in one lane to another, to give a lane
+ *                 that has no system of its own valid values to compute on.
+ *-----------------------------------------------------------------------------
+ */
+
+void copy_lane(batch_state & b, int from, int to){
+	int W = b.lanes;
+	for(int i = 0; i < b.n; i++){
+		b.mass[i*W + to] = b.mass[i*W + from];
+		for(int k = 0; k < NDIM; k++){
+			int q = (i*NDIM + k)*W;
+			b.pos[q + to] = b.pos[q + from];
+			b.vel[q + to] = b.vel[q + from];
+			b.acc[q + to] = b.acc[q + from];
+			b.jrk[q + to] = b.jrk[q + from];
+		}
+	}
+	b.epot[to] = b.epot[from];
+	b.coll_time[to] = b.coll_time[from];
+}
+
+/*-----------------------------------------------------------------------------
+ *  batch_suits  --  returns true if a system can be integrated in a batch:
+ *                   at least two particles, and no test particles, which
+ *                   the batch kernel does not treat apart.
+ *-----------------------------------------------------------------------------
+ */
+
+bool batch_suits(const real mass[], int n){
+	return n >= 2 && massive_count(mass, n) == n;
+}
+
+/*-----------------------------------------------------------------------------
+ *  lane  --  the bookkeeping of evolve() for the system in one lane.
+ *-----------------------------------------------------------------------------
+ */
+
+struct lane {
+	int k = -1;               // index of the system in sys[], -1 for none
+	real t_dia = 0;           // next time for diagnostics output
+	real t_out = 0;           // next time for snapshot output
+	real t_end = 0;           // final time
+	real einit = 0;           // total energy at the start
+	int nsteps = 0;           // number of integration time steps completed
+};
+
+/*-----------------------------------------------------------------------------
+ *  evolve_batch  --  integrates the nsys systems of n particles in sys[],
+ *                    each as evolve() would with the options in opt,
+ *                    batch_width() at a time.  begin(k) is called when
+ *                    system k takes a lane, to set sys[k].to; it returns
+ *                    false if the system cannot be integrated, which then
+ *                    leaves its lane to the next one.  end(k) is called
+ *                    when it is done, with all its output queued.
+ *
+ *  Snapshots come at the first step at or after each multiple of dt_out,
+ *  and diagnostics likewise every dt_dia, as in evolve(); dense output,
+ *  summaries, regularization and profiling are not done here (main()
+ *  refuses them with -V).  The systems must suit batch_suits().
+ *-----------------------------------------------------------------------------
+ */
+
+void evolve_batch(batch_system sys[], int nsys, int n, const options & opt,
+				  const function<bool(int)> & begin,
+				  const function<void(int)> & end){
+	real dt_param = opt.dt_param;
+	real dt_dia = opt.dt_dia;
+	real dt_out = opt.dt_out;
+	real dt_tot = opt.dt_tot;
+	bool x_flag = opt.x_flag;
+	bool checking = stop_checks(opt);
+	int npairs = n * (n - 1) / 2;
+
+	int W = batch_width();
+	batch_state b;
+	b.reserve(n, W);
+	vector<lane> lanes(W);
+
+	real (*acc)[NDIM] = new real[n][NDIM];   // the system in one lane,
+	real (*jrk)[NDIM] = new real[n][NDIM];   // as output needs it
+	real *dst = new real[npairs];
+
+	int next = 0;             // the next system to take a lane
+	int active = 0;           // lanes with a system
+
+	auto finish = [&](int l){ // final diagnostics, and the lane is free
+		lane & ln = lanes[l];
+		batch_system & s = sys[ln.k];
+		if(dt_dia == 0 || s.t > (ln.t_dia - dt_dia)){
+			set_output(s.to);
+			queue_diagnostics(s.mass, s.pos, s.vel, acc, jrk, n, s.t,
+							  b.epot[l], ln.nsteps, x_flag);
+		}
+		set_output(0);
+		end(ln.k);
+		ln.k = -1;
+		b.dt[l] = 0;
+		active--;
+	};
+
+	auto start = [&](int l){  // the next system that begins takes lane l
+		while(lanes[l].k < 0 && next < nsys){
+			int k = next++;
+			if(!begin(k)){ continue; }
+			batch_system & s = sys[k];
+			real epot, coll_time;
+			get_acc_jrk_pot_coll(s.mass, s.pos, s.vel, acc, jrk, dst, n, epot,
+								 coll_time);
+			set_output(s.to);
+			queue_diagnostics(s.mass, s.pos, s.vel, acc, jrk,
+							  n, s.t, epot, 0, x_flag);
+			queue_snapshot(s.mass, s.pos, s.vel, dst, npairs, n, s.t);
+			load_lane(b, l, s.mass, s.pos, s.vel, acc, jrk, epot, coll_time);
+
+			lane & ln = lanes[l];
+			ln.k = k;
+			ln.t_dia = s.t + dt_dia;
+			ln.t_out = s.t + dt_out;
+			ln.t_end = s.t + dt_tot;
+			ln.einit = total_energy(s.mass, s.vel, n, epot);
+			ln.nsteps = 0;
+			active++;
+			if(!(s.t < ln.t_end)){ finish(l); }
+		}
+	};
+
+	int first = -1;           // lanes left empty compute on a copy of
+	for(int l = 0; l < W; l++){                   // the first one filled
+		start(l);
+		if(first < 0 && lanes[l].k >= 0){ first = l; }
+	}
+	for(int l = 0; l < W && first >= 0; l++){
+		if(lanes[l].k < 0){ copy_lane(b, first, l); }
+	}
+
+	while(active > 0){
+		for(int l = 0; l < W; l++){
+			b.dt[l] = lanes[l].k >= 0 ? dt_param * b.coll_time[l] : 0;
+		}
+		batch_step(b);
+
+		for(int l = 0; l < W; l++){
+			lane & ln = lanes[l];
+			if(ln.k < 0){ continue; }
+			batch_system & s = sys[ln.k];
+			s.t += b.dt[l];
+			ln.nsteps++;
+
+			bool stored = false;  // s.pos, acc, dst, ... hold the lane
+			auto store = [&](){
+				if(!stored){ store_lane(b, l, s.pos, s.vel, acc, jrk, dst); }
+				stored = true;
+			};
+			bool stop = false;
+			if(checking){
+				store();
+				stop = check_stop(s.mass, s.pos, s.vel, dst, n, s.t,
+								  b.epot[l], ln.einit, opt, s.why);
+			}
+			set_output(s.to);
+			if(dt_dia > 0 && s.t >= ln.t_dia){
+				store();
+				queue_diagnostics(s.mass, s.pos, s.vel, acc, jrk,
+								  n, s.t, b.epot[l], ln.nsteps, x_flag);
+				do{ ln.t_dia += dt_dia; } while(ln.t_dia < s.t);
+			}
+			if(s.t >= ln.t_out || stop){
+				store();
+				queue_snapshot(s.mass, s.pos, s.vel, dst, npairs, n, s.t);
+				do{ ln.t_out += dt_out; } while(ln.t_out < s.t);
+			}
+			set_output(0);
+			if(stop || !(s.t < ln.t_end)){
+				store();
+				finish(l);
+				start(l);             // or it idles on its last values
+			}
+		}
+	}
+
+	delete[] acc;
+	delete[] jrk;
+	delete[] dst;
+}
+
+}
@@ -0,0 +1,1192 @@
+/*=============================================================================
+ *
+ *  bench.cpp: benchmarks for the force calculation, the integrators and the
+ *             snapshot formats.
+ *
+ *     Each benchmark writes one line per measurement to the standard output,
+ *     as whitespace separated "key=value" fields, so that runs of different
+ *     versions can be compared with simple scripts.  Progress messages go to
+ *     the standard error stream.
+ *
+ *     usage: bench [benchmark ...]
+ *
+ *     With no arguments all benchmarks are run.  Available benchmarks:
+ *
+ *        force   the direct force calculation, scalar and vectorized, for N
+ *                from 3 to 10^4: time per call and pair interactions per
+ *                second.
+ *
+ *        simd    a check of the vectorized force kernel against the scalar
+ *                one, on the systems of "run" below, on 1 and 4 threads and
+ *                with both settings of test particle distances and
+ *                collision times: the largest relative difference of the
+ *                accelerations, jerks, potential energy, collision time and
+ *                distances.  bench exits with status 1 if any exceeds
+ *                simd_tol; make check runs this one.
+ *
+ *        tree    the tree code against direct summation, for a range of N
+ *                and opening angles: time per force calculation, and the rms
+ *                and maximum relative acceleration error of the tree code.
+ *                The crossover N is where tree_s drops below direct_s.
+ *
+ *        wh      the Wisdom-Holman scheme against the Hermite scheme, on
+ *                the star and two planets of GenerateSystems.py over 1e8 s:
+ *                wall time, number of steps and relative energy error, for
+ *                a range of step sizes of each.
+ *
+ *        step    the bookkeeping of a Hermite step (predictor, corrector and
+ *                saving the old values) with separate arrays copied every
+ *                step, against a particle_state swapped by pointer, for a
+ *                range of N: time per step without the force calculation,
+ *                the bytes each moves per step, and the time of the force
+ *                calculation for comparison.
+ *
+ *        io      writing and reading N = 1000 snapshots, text and binary:
+ *                bytes per snapshot and bandwidth in MB/s each way.
+ *
+ *        run     Hermite integrations of canonical systems for a fixed
+ *                number of steps: the co-orbital star and planets of
+ *                GenerateSystems.py, a Plummer sphere, and a ring of test
+ *                particles around a star with one planet.  Steps per
+ *                second, simulated time and relative energy error.
+ *
+ *        compress  compressed binary snapshot files (-Z), on the snapshots
+ *                of integrations of the GenerateSystems.py system and the
+ *                ring, uncompressed, lossless and with two error bounds:
+ *                file size and compression ratio, bandwidth in MB/s of
+ *                uncompressed data each way, and the largest relative
+ *                error of the values read back.
+ *
+ *        batch   256 small systems (a star and 2 to 4 planets) taken through
+ *                2000 Hermite steps each, one at a time with evolve_step()
+ *                and side by side in the lanes of batch_step(), for n = 3,
+ *                4 and 5: system steps per second of each, the speedup, and
+ *                the largest relative difference of the final positions.
+ *
+ *        neighbor  a check of the Ahmad-Cohen neighbor scheme (-b -N) on the
+ *                star and two planets of GenerateSystems.py over 3e6 s,
+ *                and on a star with four planets over 3e8 s: with as many
+ *                neighbors as other bodies the final state must be that of
+ *                block time steps alone, and with fewer the relative
+ *                energy error must stay below nb_tol.  bench exits with
+ *                status 1 otherwise; make check runs this one too.
+ *
+ *        stop      a check that block time steps stop at the first output
+ *                time (exactly, with -e, or at the first block time after
+ *                it) when the energy error limit (-m) is below rounding,
+ *                with and without dense output (-e) and neighbors.  Also
+ *                run by make check.
+ *
+ *        parareal  the star and two planets of GenerateSystems.py over
+ *                1e8 s, integrated serially and in 4, 8 and 16 parareal
+ *                time slices on as many threads as the machine has: wall
+ *                time of each, the speedup, the number of iterations, and
+ *                the largest difference of the final positions and
+ *                velocities, relative to the largest of each.
+ *=============================================================================
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cstdio>     // for remove()
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include "nbody.h"
+#include "nbodyio.h"
+#include "evolve.h"
+#include "state.h"
+#include "simd.h"
+#include "tree.h"
+#include "snapfile.h"
+#include "wh.h"
+#include "batch.h"
+#include "block.h"
+#include "stop.h"
+#include "options.h"
+#include "parareal.h"
+
+using namespace std;
+using namespace NBODY_VARIANT;   // the default variant, see nbody.h
+
+/*-----------------------------------------------------------------------------
+ *  plummer  --  sets up n equal-mass particles (total mass 1e30 kg) drawn
+ *               from a Plummer sphere of scale radius 1e11 m, projected on the
+ *               first NDIM coordinates, with small random velocities.  The
+ *               random sequence is fixed, so every run sees the same system.
+ *-----------------------------------------------------------------------------
+ */
+
+static void plummer(real mass[], real pos[][NDIM], real vel[][NDIM], int n){
+	srand(12345);
+	for(int i = 0; i < n; i++){
+		mass[i] = G * 1e30 / n;
+		real u = (rand() + 1.0) / (RAND_MAX + 2.0);
+		real r = 1e11 / sqrt(pow(u, -2.0/3) - 1);
+		real x[3], x2 = 0;
+		do{
+			x2 = 0;
+			for(int k = 0; k < 3; k++){
+				x[k] = 2.0 * rand() / RAND_MAX - 1;
+				x2 += x[k] * x[k];
+			}
+		}while(x2 > 1 || x2 == 0);
+		for(int k = 0; k < NDIM; k++){
+			pos[i][k] = r * x[k] / sqrt(x2);
+			vel[i][k] = 1e3 * (2.0 * rand() / RAND_MAX - 1);
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  seconds_per_call  --  times a force routine, repeating it until at least
+ *                        0.2 seconds have passed, and returns the mean time.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef void (*force_fn)(const real [], const real [][NDIM], const real [][NDIM],
+						 real [][NDIM], real [][NDIM], real [], int,
+						 real &, real &);
+
+static double seconds_per_call(force_fn f, const real mass[],
+							   const real pos[][NDIM], const real vel[][NDIM],
+							   real acc[][NDIM], real jrk[][NDIM], real dst[],
+							   int n){
+	real epot, coll_time;
+	int calls = 0;
+	auto start = chrono::steady_clock::now();
+	double elapsed;
+	do{
+		f(mass, pos, vel, acc, jrk, dst, n, epot, coll_time);
+		calls++;
+		elapsed = chrono::duration<double>(chrono::steady_clock::now()
+										   - start).count();
+	}while(elapsed < 0.2);
+	return elapsed / calls;
+}
+
+/*-----------------------------------------------------------------------------
+ *  bench_force  --  the direct force calculation, in pair interactions per
+ *                   second.
+ *-----------------------------------------------------------------------------
+ */
+
+static void bench_force(){
+	const int sizes[] = {3, 10, 30, 100, 300, 1000, 3000, 10000};
+
+	for(int n : sizes){
+		cerr << "force: N = " << n << endl;
+		real *mass = new real[n];
+		real (*pos)[NDIM] = new real[n][NDIM];
+		real (*vel)[NDIM] = new real[n][NDIM];
+		real (*acc)[NDIM] = new real[n][NDIM];
+		real (*jrk)[NDIM] = new real[n][NDIM];
+		real *dst = new real[n*(n-1)/2];
+		plummer(mass, pos, vel, n);
+
+		double pairs = 0.5 * n * (n-1);
+		double scalar_s = seconds_per_call(get_acc_jrk_pot_coll_scalar,
+										   mass, pos, vel, acc, jrk, dst, n);
+		cout << "bench=force kernel=scalar n=" << n << " call_s=" << scalar_s
+			 << " pairs_per_s=" << pairs / scalar_s << endl;
+		double simd_s = seconds_per_call(get_acc_jrk_pot_coll_simd,
+										 mass, pos, vel, acc, jrk, dst, n);
+		cout << "bench=force kernel=" << simd_kernel_name() << " n=" << n
+			 << " call_s=" << simd_s << " pairs_per_s=" << pairs / simd_s
+			 << endl;
+
+		delete[] mass;
+		delete[] pos;
+		delete[] vel;
+		delete[] acc;
+		delete[] jrk;
+		delete[] dst;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  bench_tree  --  the tree code against direct summation.
+ *-----------------------------------------------------------------------------
+ */
+
+static void bench_tree(){
+	const int sizes[] = {100, 300, 1000, 3000, 10000};
+	const real thetas[] = {0.3, 0.5, 0.7, 1.0};
+
+	for(int n : sizes){
+		cerr << "tree: N = " << n << endl;
+		real *mass = new real[n];
+		real (*pos)[NDIM] = new real[n][NDIM];
+		real (*vel)[NDIM] = new real[n][NDIM];
+		real (*acc)[NDIM] = new real[n][NDIM];
+		real (*jrk)[NDIM] = new real[n][NDIM];
+		real (*ref)[NDIM] = new real[n][NDIM];
+		real *dst = new real[n*(n-1)/2];
+		plummer(mass, pos, vel, n);
+
+		double direct_s = seconds_per_call(get_acc_jrk_pot_coll_scalar,
+										   mass, pos, vel, ref, jrk, dst, n);
+		for(real theta : thetas){
+			set_force_tree(theta);
+			double tree_s = seconds_per_call(get_acc_jrk_pot_coll_tree,
+											 mass, pos, vel, acc, jrk, dst, n);
+			double sum2 = 0, worst = 0;
+			for(int i = 0; i < n; i++){
+				real d2 = 0, a2 = 0;
+				for(int k = 0; k < NDIM; k++){
+					d2 += (acc[i][k] - ref[i][k]) * (acc[i][k] - ref[i][k]);
+					a2 += ref[i][k] * ref[i][k];
+				}
+				real err = sqrt(d2 / a2);
+				sum2 += err * err;
+				if(worst < err){ worst = err; }
+			}
+			cout << "bench=tree n=" << n << " theta=" << theta
+				 << " direct_s=" << direct_s << " tree_s=" << tree_s
+				 << " speedup=" << direct_s / tree_s
+				 << " acc_err_rms=" << sqrt(sum2 / n)
+				 << " acc_err_max=" << worst << endl;
+		}
+		set_force_tree(0);
+
+		delete[] mass;
+		delete[] pos;
+		delete[] vel;
+		delete[] acc;
+		delete[] jrk;
+		delete[] ref;
+		delete[] dst;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  solia  --  sets up the first system written by GenerateSystems.py: a star
+ *             with two planets on circular orbits, with the center of mass
+ *             at rest at the origin.
+ *-----------------------------------------------------------------------------
+ */
+
+static void solia(real mass[], real pos[][NDIM], real vel[][NDIM]){
+	const real M = 1.59128e29, R = 2591111127.56519;
+	const real m[3] = {M, 5.972e24, 5.972e24/4};
+	const real dist[3] = {0, R + 5e7/4, R - 5e7};
+	const real angle[3] = {0, 0, 300 * M_PI / 180};
+	real cpos[NDIM] = {}, cvel[NDIM] = {};
+	for(int i = 0; i < 3; i++){
+		real speed = i > 0 ? sqrt(G * M / dist[i]) : 0;
+		mass[i] = G * m[i];
+		pos[i][0] = cos(angle[i]) * dist[i];
+		pos[i][1] = sin(angle[i]) * dist[i];
+		vel[i][0] = -sin(angle[i]) * speed;
+		vel[i][1] = cos(angle[i]) * speed;
+		for(int k = 2; k < NDIM; k++){ pos[i][k] = vel[i][k] = 0; }
+		for(int k = 0; k < NDIM; k++){
+			cpos[k] += mass[i] * pos[i][k];
+			cvel[k] += mass[i] * vel[i][k];
+		}
+	}
+	real mtot = mass[0] + mass[1] + mass[2];
+	for(int i = 0; i < 3; i++){
+		for(int k = 0; k < NDIM; k++){
+			pos[i][k] -= cpos[k] / mtot;
+			vel[i][k] -= cvel[k] / mtot;
+		}
+	}
+}
+
+static real energy(const real mass[], const real pos[][NDIM],
+				   const real vel[][NDIM], real dst[], int n){
+	real epot, ekin = 0;
+	get_pot_dst(mass, pos, dst, n, epot);
+	for(int i = 0; i < n; i++){
+		for(int k = 0; k < NDIM; k++){
+			ekin += 0.5 * mass[i] * vel[i][k] * vel[i][k];
+		}
+	}
+	return ekin + epot;
+}
+
+/*-----------------------------------------------------------------------------
+ *  bench_wh  --  the Wisdom-Holman scheme against the Hermite scheme.
+ *-----------------------------------------------------------------------------
+ */
+
+static void bench_wh(){
+	const int n = 3;
+	const real t_end = 1e8;
+	const real dt_params[] = {0.03, 0.1};
+	const real fractions[] = {0.005, 0.01, 0.02, 0.05, 0.1};
+
+	real mass[n], dst[n*(n-1)/2];
+	real pos[n][NDIM], vel[n][NDIM], acc[n][NDIM], jrk[n][NDIM];
+	real old_pos[n][NDIM], old_vel[n][NDIM], old_acc[n][NDIM], old_jrk[n][NDIM];
+
+	for(real dt_param : dt_params){
+		cerr << "wh: Hermite, dt_param = " << dt_param << endl;
+		solia(mass, pos, vel);
+		real einit = energy(mass, pos, vel, dst, n);
+		auto start = chrono::steady_clock::now();
+		real epot, coll_time, t = 0;
+		long steps = 0;
+		get_acc_jrk_pot_coll(mass, pos, vel, acc, jrk, dst, n, epot, coll_time);
+		while(t < t_end){
+			real dt = dt_param * coll_time;
+			evolve_step(mass, pos, vel, acc, jrk, dst,
+						old_pos, old_vel, old_acc, old_jrk,
+						n, dt, epot, coll_time);
+			t += dt;
+			steps++;
+		}
+		double wall = chrono::duration<double>(chrono::steady_clock::now()
+											   - start).count();
+		cout << "bench=wh scheme=hermite dt_param=" << dt_param
+			 << " steps=" << steps << " wall_s=" << wall
+			 << " energy_err=" << (energy(mass, pos, vel, dst, n) - einit) / einit
+			 << endl;
+	}
+
+	for(real fraction : fractions){
+		cerr << "wh: Wisdom-Holman, step = " << fraction << " periods" << endl;
+		solia(mass, pos, vel);
+		real einit = energy(mass, pos, vel, dst, n);
+		auto start = chrono::steady_clock::now();
+		real dt = wh_time_step(mass, pos, vel, n, fraction);
+		to_democratic(mass, pos, vel, n, old_pos, old_vel);
+		long steps = 0;
+		for(real t = 0; t < t_end; t += dt){
+			wh_step(mass, old_pos, old_vel, acc, n, dt);
+			steps++;
+		}
+		from_democratic(mass, old_pos, old_vel, n, pos, vel);
+		double wall = chrono::duration<double>(chrono::steady_clock::now()
+											   - start).count();
+		cout << "bench=wh scheme=wh fraction=" << fraction
+			 << " steps=" << steps << " wall_s=" << wall
+			 << " energy_err=" << (energy(mass, pos, vel, dst, n) - einit) / einit
+			 << endl;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  bench_step  --  the bookkeeping of a Hermite step, copied against swapped.
+ *                  The predictor and corrector read and write the same
+ *                  arrays either way; copying the current values aside reads
+ *                  4 and writes 4 more arrays of n*NDIM values per step.
+ *-----------------------------------------------------------------------------
+ */
+
+static void bench_step(){
+	const int sizes[] = {1000, 3000, 10000, 100000};
+	const real dt = 1;
+
+	for(int n : sizes){
+		cerr << "step: N = " << n << endl;
+		real *mass = new real[n];
+		real (*pos)[NDIM] = new real[n][NDIM];
+		real (*vel)[NDIM] = new real[n][NDIM];
+		real (*acc)[NDIM] = new real[n][NDIM];
+		real (*jrk)[NDIM] = new real[n][NDIM];
+		real (*old_pos)[NDIM] = new real[n][NDIM];
+		real (*old_vel)[NDIM] = new real[n][NDIM];
+		real (*old_acc)[NDIM] = new real[n][NDIM];
+		real (*old_jrk)[NDIM] = new real[n][NDIM];
+		real *dst = new real[n*(n-1)/2];
+		particle_state s;
+		s.reserve(n);
+		plummer(mass, pos, vel, n);
+		for(int i = 0; i < n; i++){
+			for(int k = 0; k < NDIM; k++){
+				acc[i][k] = jrk[i][k] = 0;
+				s.pos[i][k] = pos[i][k];
+				s.vel[i][k] = vel[i][k];
+				s.acc[i][k] = s.jrk[i][k] = 0;
+			}
+		}
+
+		int steps = 0;
+		auto start = chrono::steady_clock::now();
+		double copy_s;
+		do{
+			for(int i = 0; i < n; i++){
+				for(int k = 0; k < NDIM; k++){
+					old_pos[i][k] = pos[i][k];
+					old_vel[i][k] = vel[i][k];
+					old_acc[i][k] = acc[i][k];
+					old_jrk[i][k] = jrk[i][k];
+				}
+			}
+			predict_step(pos, vel, acc, jrk, n, dt);
+			correct_step(pos, vel, acc, jrk, old_pos, old_vel, old_acc,
+						 old_jrk, n, dt);
+			steps++;
+			copy_s = chrono::duration<double>(chrono::steady_clock::now()
+											  - start).count();
+		}while(copy_s < 0.2);
+		copy_s /= steps;
+
+		steps = 0;
+		start = chrono::steady_clock::now();
+		double swap_s;
+		do{
+			s.swap();
+			predict_step(s.old_pos, s.old_vel, s.old_acc, s.old_jrk, n, dt,
+						 s.pos, s.vel);
+			correct_step(s.pos, s.vel, s.acc, s.jrk, s.old_pos, s.old_vel,
+						 s.old_acc, s.old_jrk, n, dt);
+			steps++;
+			swap_s = chrono::duration<double>(chrono::steady_clock::now()
+											  - start).count();
+		}while(swap_s < 0.2);
+		swap_s /= steps;
+
+		double array = (double) n * NDIM * sizeof(real);  // bytes per array
+		double force_s = n <= 10000
+					   ? seconds_per_call(get_acc_jrk_pot_coll_scalar, mass,
+										  pos, vel, acc, jrk, dst, n)
+					   : 0;
+		cout << "bench=step n=" << n << " copy_s=" << copy_s
+			 << " swap_s=" << swap_s << " speedup=" << copy_s / swap_s
+			 << " copy_bytes=" << 22 * array << " swap_bytes=" << 14 * array
+			 << " force_s=" << force_s << endl;
+
+		delete[] mass;
+		delete[] pos;
+		delete[] vel;
+		delete[] acc;
+		delete[] jrk;
+		delete[] old_pos;
+		delete[] old_vel;
+		delete[] old_acc;
+		delete[] old_jrk;
+		delete[] dst;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  bench_io  --  snapshot output and input, text and binary, through the
+ *                same routines nbody and snapconv use.  The files go to the
+ *                current directory and are removed afterwards.
+ *-----------------------------------------------------------------------------
+ */
+
+static void bench_io(){
+	const int n = 1000, nsnap = 10;
+	const char *text_name = "bench-io.txt", *bin_name = "bench-io.snap";
+
+	real *mass = new real[n];
+	real (*pos)[NDIM] = new real[n][NDIM];
+	real (*vel)[NDIM] = new real[n][NDIM];
+	int ndst = n*(n-1)/2;
+	real *dst = new real[ndst];
+	plummer(mass, pos, vel, n);
+	get_dst(mass, pos, dst, n);
+
+	cerr << "io: text" << endl;
+	ofstream text(text_name);
+	output_target to;
+	to.snap = &text;
+	set_output(&to);
+	auto start = chrono::steady_clock::now();
+	for(int s = 0; s < nsnap; s++){
+		put_snapshot(mass, pos, vel, dst, ndst, n, s);
+	}
+	text.flush();
+	double write_s = chrono::duration<double>(chrono::steady_clock::now()
+											  - start).count();
+	double bytes = text.tellp();
+	text.close();
+	set_output(0);
+
+	ifstream text_in(text_name);
+	streambuf *cin_buf = cin.rdbuf(text_in.rdbuf());
+	start = chrono::steady_clock::now();
+	for(int s = 0; s < nsnap; s++){
+		int m;
+		real t;
+		cin >> m >> t;
+		get_snapshot(mass, pos, vel, n);
+		for(int i = 0; i < ndst; i++){ cin >> dst[i]; }
+	}
+	double read_s = chrono::duration<double>(chrono::steady_clock::now()
+											 - start).count();
+	cin.rdbuf(cin_buf);
+	text_in.close();
+	cout << "bench=io format=text n=" << n << " snapshot_bytes="
+		 << bytes / nsnap << " write_mb_s=" << bytes / write_s / 1e6
+		 << " read_mb_s=" << bytes / read_s / 1e6 << endl;
+
+	cerr << "io: binary" << endl;
+	snap_writer out;
+	open_snap_writer(bin_name, n, ndst, out);
+	start = chrono::steady_clock::now();
+	for(int s = 0; s < nsnap; s++){
+		put_snapshot_binary(out, mass, pos, vel, dst, ndst, n, s);
+	}
+	close_snap_writer(out);
+	write_s = chrono::duration<double>(chrono::steady_clock::now()
+									   - start).count();
+
+	snap_reader in;
+	open_snap_reader(bin_name, in);
+	bytes = (double) in.nrec * (1 + n * (1 + 2*NDIM) + ndst) * sizeof(double);
+	start = chrono::steady_clock::now();
+	for(long long r = 0; r < in.nrec; r++){
+		real t;
+		read_snap_record(in, r, t, mass, pos, vel, dst);
+	}
+	read_s = chrono::duration<double>(chrono::steady_clock::now()
+									  - start).count();
+	close_snap_reader(in);
+	cout << "bench=io format=binary n=" << n << " snapshot_bytes="
+		 << bytes / nsnap << " write_mb_s=" << bytes / write_s / 1e6
+		 << " read_mb_s=" << bytes / read_s / 1e6 << endl;
+
+	remove(text_name);
+	remove(bin_name);
+	delete[] mass;
+	delete[] pos;
+	delete[] vel;
+	delete[] dst;
+}
+
+/*-----------------------------------------------------------------------------
+ *  ring  --  sets up a star of one solar mass, a Jupiter-mass planet on a
+ *            circular orbit at 7.8e11 m, and n-2 test particles on circular
+ *            orbits spread evenly in radius and angle between 1e11 and
+ *            3e11 m.
+ *-----------------------------------------------------------------------------
+ */
+
+static void ring(real mass[], real pos[][NDIM], real vel[][NDIM], int n){
+	const real M = 1.989e30;
+	for(int i = 0; i < n; i++){
+		real dist = i == 0 ? 0 : i == 1 ? 7.8e11 : 1e11 + 2e11 * (i-2) / (n-2);
+		real angle = i < 2 ? 0 : 2 * M_PI * 0.618034 * i;
+		real speed = i > 0 ? sqrt(G * M / dist) : 0;
+		mass[i] = i == 0 ? G * M : i == 1 ? G * 1.898e27 : 0;
+		pos[i][0] = cos(angle) * dist;
+		pos[i][1] = sin(angle) * dist;
+		vel[i][0] = -sin(angle) * speed;
+		vel[i][1] = cos(angle) * speed;
+		for(int k = 2; k < NDIM; k++){ pos[i][k] = vel[i][k] = 0; }
+	}
+}
+
+static void solia_system(real mass[], real pos[][NDIM], real vel[][NDIM],
+						 int){
+	solia(mass, pos, vel);
+}
+
+/*-----------------------------------------------------------------------------
+ *  bench_run  --  Hermite integrations of canonical systems, through
+ *                 evolve_step() as evolve() uses it, without output.
+ *-----------------------------------------------------------------------------
+ */
+
+struct scenario {
+	const char *name;
+	void (*setup)(real [], real [][NDIM], real [][NDIM], int);
+	int n;
+	int steps;
+};
+
+static void bench_run(){
+	const real dt_param = 0.03;
+	const scenario scenarios[] = {
+		{"solia", solia_system, 3, 200000},
+		{"plummer", plummer, 1000, 50},
+		{"ring", ring, 1002, 2000},
+	};
+
+	for(const scenario & sc : scenarios){
+		cerr << "run: " << sc.name << endl;
+		int n = sc.n;
+		real *mass = new real[n];
+		particle_state s;
+		s.reserve(n);
+		sc.setup(mass, s.pos, s.vel, n);
+		real *dst = new real[dst_count(mass, n)];
+
+		real einit = energy(mass, s.pos, s.vel, dst, n);
+		auto start = chrono::steady_clock::now();
+		real epot, coll_time, t = 0;
+		get_acc_jrk_pot_coll(mass, s.pos, s.vel, s.acc, s.jrk, dst, n, epot,
+							 coll_time);
+		for(int step = 0; step < sc.steps; step++){
+			real dt = dt_param * coll_time;
+			evolve_step(mass, s, dst, n, dt, epot, coll_time);
+			t += dt;
+		}
+		double wall = chrono::duration<double>(chrono::steady_clock::now()
+											   - start).count();
+		cout << "bench=run system=" << sc.name << " n=" << n
+			 << " steps=" << sc.steps << " wall_s=" << wall
+			 << " steps_per_s=" << sc.steps / wall << " t=" << t
+			 << " energy_err="
+			 << (energy(mass, s.pos, s.vel, dst, n) - einit) / einit << endl;
+
+		delete[] mass;
+		delete[] dst;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  bench_compress  --  writes and reads back the snapshots of a Hermite
+ *                      integration, taken every sc.steps steps, through the
+ *                      same routines nbody -O and -Z use.  The file goes to
+ *                      the current directory and is removed afterwards.
+ *-----------------------------------------------------------------------------
+ */
+
+static void bench_compress(){
+	const real dt_param = 0.03;
+	const int nsnap = 200;
+	const char *name = "bench-compress.snap";
+	const scenario scenarios[] = {
+		{"solia", solia_system, 3, 1000},
+		{"ring", ring, 202, 10},
+	};
+	const double bounds[] = {-1, 0, 1e-12, 1e-8};    // -1: uncompressed
+
+	for(const scenario & sc : scenarios){
+		cerr << "compress: " << sc.name << endl;
+		int n = sc.n;
+		real *mass = new real[n];
+		particle_state s;
+		s.reserve(n);
+		sc.setup(mass, s.pos, s.vel, n);
+		int ndst = dst_count(mass, n);
+		real *dst = new real[ndst];
+
+		vector<real> kg(n);               // snapshots, as nbody writes them
+		for(int i = 0; i < n; i++){ kg[i] = mass[i] / G; }
+		vector<real> ts, pos, vel, dsts;
+		real epot, coll_time, t = 0;
+		get_acc_jrk_pot_coll(mass, s.pos, s.vel, s.acc, s.jrk, dst, n, epot,
+							 coll_time);
+		for(int snap = 0; snap < nsnap; snap++){
+			ts.push_back(t);
+			pos.insert(pos.end(), s.pos[0], s.pos[0] + n * NDIM);
+			vel.insert(vel.end(), s.vel[0], s.vel[0] + n * NDIM);
+			dsts.insert(dsts.end(), dst, dst + ndst);
+			for(int step = 0; step < sc.steps; step++){
+				real dt = dt_param * coll_time;
+				evolve_step(mass, s, dst, n, dt, epot, coll_time);
+				t += dt;
+			}
+		}
+		double bytes = (double) nsnap * (1 + n * (1 + 2*NDIM) + ndst)
+					 * sizeof(double);
+
+		real (*rpos)[NDIM] = new real[n][NDIM];
+		real (*rvel)[NDIM] = new real[n][NDIM];
+		for(double bound : bounds){
+			snap_writer out;
+			open_snap_writer(name, n, ndst, out, bound);
+			auto start = chrono::steady_clock::now();
+			for(int snap = 0; snap < nsnap; snap++){
+				put_snap_record(out, ts[snap], kg.data(),
+								(real (*)[NDIM]) &pos[snap * n * NDIM],
+								(real (*)[NDIM]) &vel[snap * n * NDIM],
+								&dsts[snap * ndst]);
+			}
+			close_snap_writer(out);
+			double write_s = chrono::duration<double>(
+				chrono::steady_clock::now() - start).count();
+			double file_bytes = ifstream(name, ios::binary | ios::ate).tellg();
+
+			snap_reader in;
+			open_snap_reader(name, in);
+			real max_err = 0;             // relative, of pos, vel and dst
+			double read_s = 0;
+			for(long long r = 0; r < in.nrec; r++){
+				real rt;
+				start = chrono::steady_clock::now();
+				read_snap_record(in, r, rt, mass, rpos, rvel, dst);
+				read_s += chrono::duration<double>(
+					chrono::steady_clock::now() - start).count();
+				auto err = [&max_err](real got, real want){
+					if(want != 0){
+						max_err = max(max_err, fabs(got - want) / fabs(want));
+					}
+				};
+				for(int v = 0; v < n * NDIM; v++){
+					err(rpos[0][v], pos[r * n * NDIM + v]);
+					err(rvel[0][v], vel[r * n * NDIM + v]);
+				}
+				for(int p = 0; p < ndst; p++){ err(dst[p], dsts[r * ndst + p]); }
+			}
+			close_snap_reader(in);
+
+			cout << "bench=compress system=" << sc.name << " n=" << n
+				 << " snapshots=" << nsnap << " bound=" << bound
+				 << " file_bytes=" << file_bytes
+				 << " ratio=" << bytes / file_bytes
+				 << " write_mb_s=" << bytes / write_s / 1e6
+				 << " read_mb_s=" << bytes / read_s / 1e6
+				 << " max_rel_err=" << max_err << endl;
+		}
+		remove(name);
+
+		delete[] mass;
+		delete[] dst;
+		delete[] rpos;
+		delete[] rvel;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  small_system  --  sets up one system of a scan: a star of one solar mass
+ *                    and n-1 planets of 0.1 to 300 Earth masses on nearly
+ *                    circular orbits, spaced 0.6 AU apart from 1.1 AU out,
+ *                    at angles and with masses that vary with seed.
+ *-----------------------------------------------------------------------------
+ */
+
+static void small_system(real mass[], real pos[][NDIM], real vel[][NDIM],
+						 int n, int seed){
+	const real M = 1.989e30;
+	srand(1000 + seed);
+	for(int i = 0; i < n; i++){
+		real u = (real) rand() / RAND_MAX;
+		real dist = i == 0 ? 0 : 1.496e11 * (0.5 + 0.6*i + 0.2*u);
+		real angle = 2 * M_PI * rand() / RAND_MAX;
+		real speed = i > 0 ? sqrt(G * M / dist) * (0.975 + 0.05 * u) : 0;
+		mass[i] = i == 0 ? G * M : G * 5.97e24 * (0.1 + 300 * u);
+		pos[i][0] = cos(angle) * dist;
+		pos[i][1] = sin(angle) * dist;
+		vel[i][0] = -sin(angle) * speed;
+		vel[i][1] = cos(angle) * speed;
+		for(int k = 2; k < NDIM; k++){ pos[i][k] = vel[i][k] = 0; }
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  bench_batch  --  small systems integrated one at a time, as nbody -E
+ *                   does, against batch_step() as nbody -E -V does, both
+ *                   without output.
+ *-----------------------------------------------------------------------------
+ */
+
+static void bench_batch(){
+	const real dt_param = 0.03;
+	const int nsys = 256;
+	const int steps = 2000;
+	int W = batch_width();
+
+	for(int n = 3; n <= 5; n++){
+		cerr << "batch: n = " << n << endl;
+		real *mass = new real[n];
+		real (*pos)[NDIM] = new real[n][NDIM];
+		real (*vel)[NDIM] = new real[n][NDIM];
+		real (*acc)[NDIM] = new real[n][NDIM];
+		real (*jrk)[NDIM] = new real[n][NDIM];
+		real *dst = new real[n*(n-1)/2];
+		vector<real> single(nsys * n * NDIM);   // final positions
+
+		auto start = chrono::steady_clock::now();
+		for(int k = 0; k < nsys; k++){
+			particle_state s;
+			s.reserve(n);
+			small_system(mass, s.pos, s.vel, n, k);
+			real epot, coll_time;
+			get_acc_jrk_pot_coll(mass, s.pos, s.vel, s.acc, s.jrk, dst, n,
+								 epot, coll_time);
+			for(int step = 0; step < steps; step++){
+				evolve_step(mass, s, dst, n, dt_param * coll_time, epot,
+							coll_time);
+			}
+			copy(s.pos[0], s.pos[0] + n * NDIM, &single[k * n * NDIM]);
+		}
+		double wall_single = chrono::duration<double>(
+								 chrono::steady_clock::now() - start).count();
+
+		batch_state b;
+		b.reserve(n, W);
+		real max_diff = 0;
+		start = chrono::steady_clock::now();
+		for(int k0 = 0; k0 < nsys; k0 += W){
+			for(int l = 0; l < W; l++){
+				small_system(mass, pos, vel, n, k0 + l);
+				real epot, coll_time;
+				get_acc_jrk_pot_coll(mass, pos, vel, acc, jrk, dst, n, epot,
+									 coll_time);
+				load_lane(b, l, mass, pos, vel, acc, jrk, epot, coll_time);
+			}
+			for(int step = 0; step < steps; step++){
+				for(int l = 0; l < W; l++){
+					b.dt[l] = dt_param * b.coll_time[l];
+				}
+				batch_step(b);
+			}
+			for(int l = 0; l < W; l++){
+				store_lane(b, l, pos, vel, acc, jrk, dst);
+				const real *p = &single[(k0 + l) * n * NDIM];
+				for(int q = 0; q < n * NDIM; q++){
+					real d = fabs(pos[0][q] - p[q]) / (fabs(p[q]) + 1e-300);
+					if(d > max_diff){ max_diff = d; }
+				}
+			}
+		}
+		double wall_batch = chrono::duration<double>(
+								chrono::steady_clock::now() - start).count();
+
+		double work = (double) nsys * steps;
+		cout << "bench=batch n=" << n << " systems=" << nsys
+			 << " steps=" << steps << " lanes=" << W
+			 << " kernel=" << batch_kernel_name()
+			 << " single_system_steps_per_s=" << work / wall_single
+			 << " batch_system_steps_per_s=" << work / wall_batch
+			 << " speedup=" << wall_single / wall_batch
+			 << " max_rel_diff=" << max_diff << endl;
+
+		delete[] mass;
+		delete[] pos;
+		delete[] vel;
+		delete[] acc;
+		delete[] jrk;
+		delete[] dst;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  rel_diff  --  the largest difference between the vectors a[i] and b[i],
+ *                relative to the length of b[i].
+ *-----------------------------------------------------------------------------
+ */
+
+static real rel_diff(const real a[][NDIM], const real b[][NDIM], int n){
+	real worst = 0;
+	for(int i = 0; i < n; i++){
+		real d2 = 0, b2 = 0;
+		for(int k = 0; k < NDIM; k++){
+			d2 += (a[i][k] - b[i][k]) * (a[i][k] - b[i][k]);
+			b2 += b[i][k] * b[i][k];
+		}
+		if(b2 > 0){ worst = max(worst, sqrt(d2 / b2)); }
+	}
+	return worst;
+}
+
+static bool check_failed = false;   // a check went beyond its tolerance
+
+/*-----------------------------------------------------------------------------
+ *  bench_simd  --  get_acc_jrk_pot_coll_simd() against the serial scalar
+ *                  kernel, which sums in a different order, so the two
+ *                  agree to rounding only.
+ *-----------------------------------------------------------------------------
+ */
+
+static void bench_simd(){
+	const real simd_tol = 1e-10;
+	const scenario scenarios[] = {
+		{"solia", solia_system, 3, 0},
+		{"plummer", plummer, 1000, 0},
+		{"ring", ring, 1002, 0},
+	};
+	const int thread_counts[] = {1, 4};
+
+	for(const scenario & sc : scenarios){
+		int n = sc.n;
+		real *mass = new real[n];
+		real (*pos)[NDIM] = new real[n][NDIM];
+		real (*vel)[NDIM] = new real[n][NDIM];
+		real (*acc)[NDIM] = new real[n][NDIM];
+		real (*jrk)[NDIM] = new real[n][NDIM];
+		real (*ref_acc)[NDIM] = new real[n][NDIM];
+		real (*ref_jrk)[NDIM] = new real[n][NDIM];
+		sc.setup(mass, pos, vel, n);
+		bool tests = massive_count(mass, n) < n;
+
+		for(int mode = 0; mode < (tests ? 2 : 1); mode++){
+			set_test_particles(mode == 0, mode == 1);
+			int ndst = dst_count(mass, n);
+			vector<real> dst(ndst), ref_dst(ndst);
+			real epot, coll_time, ref_epot, ref_coll_time;
+			get_acc_jrk_pot_coll_scalar(mass, pos, vel, ref_acc, ref_jrk,
+										ref_dst.data(), n, ref_epot,
+										ref_coll_time);
+			for(int nthreads : thread_counts){
+				cerr << "simd: " << sc.name << ", " << nthreads
+					 << " threads" << endl;
+				set_force_threads(nthreads);
+				get_acc_jrk_pot_coll_simd(mass, pos, vel, acc, jrk,
+										  dst.data(), n, epot, coll_time);
+				real dst_diff = 0;
+				for(int q = 0; q < ndst; q++){
+					dst_diff = max(dst_diff, (real) fabs(dst[q] - ref_dst[q])
+												/ ref_dst[q]);
+				}
+				real diffs[] = {rel_diff(acc, ref_acc, n),
+								rel_diff(jrk, ref_jrk, n),
+								(real) fabs((epot - ref_epot) / ref_epot),
+								(real) fabs((coll_time - ref_coll_time)
+											/ ref_coll_time),
+								dst_diff};
+				bool ok = true;
+				for(real d : diffs){ ok = ok && d <= simd_tol; }
+				check_failed = check_failed || !ok;
+				cout << "bench=simd system=" << sc.name << " n=" << n
+					 << " kernel=" << simd_kernel_name()
+					 << " threads=" << nthreads
+					 << " test_dst=" << (mode == 0)
+					 << " test_coll=" << (mode == 1)
+					 << " acc_diff=" << diffs[0] << " jrk_diff=" << diffs[1]
+					 << " epot_diff=" << diffs[2]
+					 << " coll_time_diff=" << diffs[3]
+					 << " dst_diff=" << diffs[4]
+					 << " ok=" << ok << endl;
+			}
+		}
+		set_test_particles(true, false);
+		set_force_threads(1);
+
+		delete[] mass;
+		delete[] pos;
+		delete[] vel;
+		delete[] acc;
+		delete[] jrk;
+		delete[] ref_acc;
+		delete[] ref_jrk;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  block_run  --  integrates a system with evolve_block() and the options in
+ *                 opt, with its output thrown away, and returns the
+ *                 relative energy error, with the reason for an early stop
+ *                 in why.
+ *-----------------------------------------------------------------------------
+ */
+
+static real block_run(const real mass[], real pos[][NDIM], real vel[][NDIM],
+					  int n, const options & opt, stop_reason & why){
+	vector<real> dst(dst_count(mass, n));
+	real einit = energy(mass, pos, vel, dst.data(), n);
+
+	ostringstream dia;
+	output_target to;
+	to.snap = 0;
+	to.dia = &dia;
+	set_output(&to);
+	why = evolve_block(mass, pos, vel, dst.data(), n, 0, opt);
+	set_output(0);
+	return (energy(mass, pos, vel, dst.data(), n) - einit) / einit;
+}
+
+/*-----------------------------------------------------------------------------
+ *  bench_neighbor  --  the neighbor scheme against block time steps alone.
+ *-----------------------------------------------------------------------------
+ */
+
+static void bench_neighbor(){
+	const real nb_tol = 1e-8;
+	struct {
+		const char *name;
+		int n;
+		real t_end;
+	} systems[] = {{"solia", 3, 3e6}, {"planets", 5, 3e8}};
+
+	for(auto & sys : systems){
+		int n = sys.n;
+		vector<real> mass(n);
+		real (*pos)[NDIM] = new real[n][NDIM];
+		real (*vel)[NDIM] = new real[n][NDIM];
+		real (*ref_pos)[NDIM] = new real[n][NDIM];
+		real (*ref_vel)[NDIM] = new real[n][NDIM];
+
+		for(int nb = 0; nb < n; nb++){
+			cerr << "neighbor: " << sys.name << ", " << nb << " neighbors"
+				 << endl;
+			real (*p)[NDIM] = nb == 0 ? ref_pos : pos;
+			real (*v)[NDIM] = nb == 0 ? ref_vel : vel;
+			if(n == 3){
+				solia(mass.data(), p, v);
+			}else{
+				small_system(mass.data(), p, v, n, 0);
+			}
+			options opt;
+			opt.b_flag = true;
+			opt.nb_count = nb;
+			opt.dt_tot = sys.t_end;
+			opt.dt_out = 2 * sys.t_end;
+			stop_reason why;
+			auto start = chrono::steady_clock::now();
+			real err = block_run(mass.data(), p, v, n, opt, why);
+			double wall = chrono::duration<double>(chrono::steady_clock::now()
+												   - start).count();
+
+			cout << "bench=neighbor system=" << sys.name << " n=" << n
+				 << " neighbors=" << nb << " t=" << sys.t_end
+				 << " wall_s=" << wall << " energy_err=" << err;
+			bool ok = fabs(err) <= nb_tol;
+			if(nb == n - 1){      // everybody is a neighbor
+				real diff = max(rel_diff(pos, ref_pos, n),
+								rel_diff(vel, ref_vel, n));
+				cout << " diff_from_block=" << diff;
+				ok = diff == 0;
+			}
+			if(nb > 0){
+				check_failed = check_failed || !ok;
+				cout << " ok=" << ok;
+			}
+			cout << endl;
+		}
+
+		delete[] pos;
+		delete[] vel;
+		delete[] ref_pos;
+		delete[] ref_vel;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  bench_stop  --  a stop condition that holds from the start, with block
+ *                  time steps, with and without dense output and neighbors.
+ *-----------------------------------------------------------------------------
+ */
+
+static void bench_stop(){
+	const int n = 5;
+	const real dt_out = 60;
+	vector<real> mass(n);
+	real (*pos)[NDIM] = new real[n][NDIM];
+	real (*vel)[NDIM] = new real[n][NDIM];
+
+	for(int nb : {0, 2}){
+		for(bool e_flag : {false, true}){
+			cerr << "stop: " << nb << " neighbors, "
+				 << (e_flag ? "dense output" : "block times") << endl;
+			small_system(mass.data(), pos, vel, n, 0);
+			options opt;
+			opt.b_flag = true;
+			opt.nb_count = nb;
+			opt.e_flag = e_flag;
+			opt.dt_out = dt_out;
+			opt.dt_tot = 1e7;
+			opt.max_derr = 1e-20;
+			stop_reason why;
+			block_run(mass.data(), pos, vel, n, opt, why);
+
+			// the first output time, or the first block time after it
+			bool ok = why.what != 0 && (e_flag ? why.t == dt_out
+											   : why.t < opt.dt_tot);
+			check_failed = check_failed || !ok;
+			cout << "bench=stop neighbors=" << nb << " dense=" << e_flag
+				 << " reason=" << (why.what ? why.what : "none")
+				 << " t=" << why.t << " ok=" << ok << endl;
+		}
+	}
+
+	delete[] pos;
+	delete[] vel;
+}
+
+/*-----------------------------------------------------------------------------
+ *  bench_parareal  --  parareal() against a serial run with propagate(),
+ *                      which also ends exactly at t_end.  The force
+ *                      calculation is serial either way.
+ *-----------------------------------------------------------------------------
+ */
+
+static void bench_parareal(){
+	const int n = 3;
+	const real t_end = 1e8;
+	const real dt_param = 0.03;
+	const real tol = 1e-9;
+	const int slice_counts[] = {4, 8, 16};
+	int nthreads = max(1u, thread::hardware_concurrency());
+	int len = 2 * n * NDIM;
+
+	real mass[n], pos[n][NDIM], vel[n][NDIM];
+	solia(mass, pos, vel);
+	vector<real> start(len);
+	copy(pos[0], pos[0] + n * NDIM, start.begin());
+	copy(vel[0], vel[0] + n * NDIM, start.begin() + n * NDIM);
+
+	cerr << "parareal: serial" << endl;
+	vector<real> serial = start;
+	auto t0 = chrono::steady_clock::now();
+	long long steps = propagate(mass, serial.data(), n, 0, t_end, dt_param);
+	double wall_serial = chrono::duration<double>(chrono::steady_clock::now()
+												  - t0).count();
+	cout << "bench=parareal slices=1 threads=1 steps=" << steps
+		 << " wall_s=" << wall_serial << endl;
+
+	for(int nslices : slice_counts){
+		cerr << "parareal: " << nslices << " slices" << endl;
+		vector<real> u = start;
+		t0 = chrono::steady_clock::now();
+		parareal_result r = parareal(mass, n, 0, t_end, nslices, dt_param,
+									 tol, nthreads, u, [](int, real){});
+		double wall = chrono::duration<double>(chrono::steady_clock::now()
+											   - t0).count();
+		const real *end = &u[(size_t) nslices * len];
+		real diff[2] = {0, 0}, scale[2] = {0, 0};
+		for(int q = 0; q < len; q++){
+			int part = q < n * NDIM ? 0 : 1;       // position or velocity
+			scale[part] = max(scale[part], (real) fabs(serial[q]));
+			diff[part] = max(diff[part], (real) fabs(end[q] - serial[q]));
+		}
+		cout << "bench=parareal slices=" << nslices
+			 << " threads=" << nthreads << " steps=" << r.steps
+			 << " wall_s=" << wall
+			 << " speedup=" << wall_serial / wall
+			 << " iterations=" << r.iterations
+			 << " last_change=" << r.change
+			 << " pos_diff=" << diff[0] / scale[0]
+			 << " vel_diff=" << diff[1] / scale[1] << endl;
+	}
+}
+
+struct benchmark {
+	const char *name;
+	void (*run)();
+};
+
+static const benchmark benchmarks[] = {
+	{"force", bench_force},
+	{"simd", bench_simd},
+	{"tree", bench_tree},
+	{"wh", bench_wh},
+	{"step", bench_step},
+	{"io", bench_io},
+	{"run", bench_run},
+	{"compress", bench_compress},
+	{"batch", bench_batch},
+	{"neighbor", bench_neighbor},
+	{"stop", bench_stop},
+	{"parareal", bench_parareal},
+};
+
+const int NBENCH = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+/*-----------------------------------------------------------------------------
+ *  main  --  runs the benchmarks named on the command line, or all of them,
+ *            and returns 1 if a check failed.
+ *-----------------------------------------------------------------------------
+ */
+
+int main(int argc, char *argv[]){
+	for(int a = 1; a < argc; a++){
+		int b = 0;
+		while(b < NBENCH && strcmp(argv[a], benchmarks[b].name) != 0){ b++; }
+		if(b == NBENCH){
+			cerr << "bench: unknown benchmark " << argv[a] << endl;
+			return 1;
+		}
+	}
+
+	for(int b = 0; b < NBENCH; b++){
+		bool run = argc < 2;
+		for(int a = 1; a < argc; a++){
+			if(strcmp(argv[a], benchmarks[b].name) == 0){ run = true; }
+		}
+		if(run){ benchmarks[b].run(); }
+	}
+	return check_failed ? 1 : 0;
+}
\ No newline at end of file
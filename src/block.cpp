@@ -0,0 +1,338 @@
+#include <iostream>
+#include <cmath>      // to include sqrt(), ldexp(), etc.
+#include "nbody.h"
+#include "nbodyio.h"
+#include "evolve.h"
+#include "block.h"
+#include "neighbor.h"
+#include "writer.h"
+#include "stop.h"
+#include "options.h"
+
+using namespace std;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  block.cpp: individual (block) time steps for the Hermite integrator.
+ *
+ *     Every particle i carries its own time t_i and step size dt_i, where the
+ *     step sizes are powers of two (in seconds) and t_i is always an integer
+ *     multiple of dt_i.  At each block time, the particles whose steps end
+ *     there form the active set; all particles are predicted to that time,
+ *     new forces are computed for the active ones only, and only those are
+ *     corrected.  Step sizes are derived from the same collision time
+ *     estimate as the global scheme, but per particle, so a single tight pair
+ *     only drags its own two members down to small steps.
+ *
+ *     ref.: Makino, J., 1991, Publ. Astron. Soc. Japan 43, 859-876.
+ *
+ *  Times are kept relative to the start of the run, so that block times stay
+ *  exactly representable for the whole integration.
+ *-----------------------------------------------------------------------------
+ */
+
+/*-----------------------------------------------------------------------------
+ *  block_step  --  returns the largest power of two not exceeding either the
+ *                  desired step size or the maximum step size dt_max.
+ *-----------------------------------------------------------------------------
+ */
+
+real block_step(real desired, real dt_max){
+	if(desired >= dt_max){ return dt_max; }
+	return ldexp(1.0, ilogb(desired));
+}
+
+/*-----------------------------------------------------------------------------
+ *  next_block_step  --  chooses the new step size of a particle that has just
+ *                       been corrected at relative time tau.  The step may be
+ *                       halved as often as needed, but only doubled once, and
+ *                       only when tau is commensurate with the doubled step.
+ *-----------------------------------------------------------------------------
+ */
+
+real next_block_step(real dt, real desired, real tau, real dt_max){
+	if(desired < dt){
+		while(dt > desired){ dt /= 2; }
+	}else if(2*dt <= desired && 2*dt <= dt_max && fmod(tau, 2*dt) == 0){
+		dt *= 2;
+	}
+	return dt;
+}
+
+/*-----------------------------------------------------------------------------
+ *  predict_all  --  predicts positions and velocities of all particles at the
+ *                   relative time tau, from their values at their own times.
+ *-----------------------------------------------------------------------------
+ */
+
+static void predict_all(const real pos[][NDIM], const real vel[][NDIM],
+						const real acc[][NDIM], const real jrk[][NDIM],
+						const real time[], real pred_pos[][NDIM],
+						real pred_vel[][NDIM], int n, real tau){
+	for(int i = 0; i < n; i++){
+		real dt = tau - time[i];
+		for(int k = 0; k < NDIM; k++){
+			pred_pos[i][k] = pos[i][k] + vel[i][k]*dt + acc[i][k]*dt*dt/2
+									   + jrk[i][k]*dt*dt*dt/6;
+			pred_vel[i][k] = vel[i][k] + acc[i][k]*dt + jrk[i][k]*dt*dt/2;
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  correct_active  --  Hermite corrector for the active particles, using the
+ *                      old values at the start of each particle's own step
+ *                      and the new accelerations and jerks at its end.  The
+ *                      new values then replace the old ones.
+ *-----------------------------------------------------------------------------
+ */
+
+static void correct_active(real pos[][NDIM], real vel[][NDIM],
+						   real acc[][NDIM], real jrk[][NDIM],
+						   const real new_acc[][NDIM],
+						   const real new_jrk[][NDIM], const real step[],
+						   const int active[], int nact){
+	for(int a = 0; a < nact; a++){
+		int i = active[a];
+		real dt = step[i];
+		for(int k = 0; k < NDIM; k++){
+			real old_vel = vel[i][k];
+			vel[i][k] = old_vel + (acc[i][k] + new_acc[i][k])*dt/2
+								+ (jrk[i][k] - new_jrk[i][k])*dt*dt/12;
+			pos[i][k] += (old_vel + vel[i][k])*dt/2
+					   + (acc[i][k] - new_acc[i][k])*dt*dt/12;
+			acc[i][k] = new_acc[i][k];
+			jrk[i][k] = new_jrk[i][k];
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  evolve_block  --  integrates an N-body system for a total duration dt_tot,
+ *                    using individual block time steps.  Output follows the
+ *                    same rules as evolve(): a snapshot at the first block
+ *                    time at or after each multiple of dt_out, diagnostics at
+ *                    the first block time after each multiple of dt_dia.
+ *
+ *  note: at output times only the active particles have just been corrected;
+ *        the others are written at their predicted positions and velocities,
+ *        which are accurate to the order of the jerk terms.
+ *
+ *  With dense output (e_flag), snapshots come at exactly t + k*dt_out and
+ *  at the end time instead.  Every particle's step spans the time between
+ *  two block times, so all of them are simply predicted to the output time.
+ *
+ *  The maximum step size is the largest power of two not exceeding dt_tot.
+ *  Unless dt_tot is a power of two itself, the block times then miss the
+ *  end time, so the last block is cut short to end there: all particles
+ *  are active in it, each with a step to t_end from its own time.
+ *  Diagnostics report the number of block steps; the total number of
+ *  individual particle steps is written at the end of the run.
+ *
+ *  Stop conditions (see stop.cpp) need the distances and the potential
+ *  energy, which are only computed at output times here, so they are
+ *  checked at every snapshot and diagnostics time; a small dt_dia makes
+ *  the checks more frequent.  With dense output that means the exact
+ *  output times, where the run then stops, with the predicted state as
+ *  its last snapshot.  The reason for an early stop is returned.
+ *
+ *  With nb_count > 0, the forces come from the Ahmad-Cohen neighbor scheme
+ *  of neighbor.cpp, and every diagnostics output is followed by a line
+ *  with the sizes of the neighbor lists and the numbers of regular and
+ *  irregular steps.
+ *-----------------------------------------------------------------------------
+ */
+
+stop_reason evolve_block(const real mass[], real pos[][NDIM],
+						 real vel[][NDIM], real dst[], int n, real t,
+						 const options & opt){
+
+	real dt_param = opt.dt_param;
+	real dt_dia = opt.dt_dia;
+	real dt_out = opt.dt_out;
+	real dt_tot = opt.dt_tot;
+	bool x_flag = opt.x_flag;
+	bool e_flag = opt.e_flag;
+
+	real (* acc)[NDIM] = new real[n][NDIM];       // accelerations and jerks
+	real (* jrk)[NDIM] = new real[n][NDIM];       // at each particle's time
+	real (* new_acc)[NDIM] = new real[n][NDIM];   // at the block time, for
+	real (* new_jrk)[NDIM] = new real[n][NDIM];   // the active particles
+	real (* pred_pos)[NDIM] = new real[n][NDIM];  // predicted positions and
+	real (* pred_vel)[NDIM] = new real[n][NDIM];  // velocities at block time
+
+	real *time = new real[n];       // time of each particle, relative to start
+	real *step = new real[n];       // individual block step sizes
+	real *coll_time = new real[n];  // individual collision time scales
+	int *active = new int[n];       // indices of the active particles
+
+	real t0 = t;                    // start time; block times are relative
+	real dt_max = ldexp(1.0, ilogb(dt_tot));
+
+	for(int i = 0; i < n; i++){
+		active[i] = i;
+		time[i] = 0;
+	}
+	neighbor_state nb;        // the Ahmad-Cohen scheme, if nb_count > 0
+	if(opt.nb_count > 0){
+		start_neighbors(nb, opt.nb_count, dt_param, mass, pos, vel, acc,
+						jrk, coll_time, n);
+	}else{
+		get_acc_jrk_coll_active(mass, pos, vel, acc, jrk, coll_time,
+								active, n, n);
+	}
+	for(int i = 0; i < n; i++){
+		step[i] = block_step(dt_param * coll_time[i], dt_max);
+	}
+	if(nb.target > 0){
+		next_regular_steps(nb, step, active, n, 0, dt_max);
+	}
+
+	real epot;
+	get_pot_dst(mass, pos, dst, n, epot);
+	real einit = total_energy(mass, vel, n, epot);
+	bool checking = stop_checks(opt);
+	stop_reason why;
+
+	queue_diagnostics(mass, pos, vel, acc, jrk,
+					  n, t, epot, 0, x_flag);
+	if(nb.target > 0){
+		flush_writer();       // the diagnostics above come first
+		write_neighbors(nb, *get_output()->dia);
+	}
+
+	queue_snapshot(mass, pos, vel, dst, dst_count(mass, n), n, t);
+
+	real t_dia = t + dt_dia;  // next time for diagnostics output
+	real t_out = t + dt_out;  // next time for snapshot output
+	real t_end = t + dt_tot;  // final time, to finish the integration
+
+	int k_out = 1;            // dense output comes at t0 + k*dt_out, and at
+	if(e_flag && t_out > t_end){ t_out = t_end; }               // t_end
+
+	int nsteps = 0;           // number of block steps completed
+	long long nisteps = 0;    // number of individual particle steps completed
+	while(t < t_end){
+		real tau = time[0] + step[0];
+		for(int i = 1; i < n; i++){
+			if(time[i] + step[i] < tau){ tau = time[i] + step[i]; }
+		}
+
+		bool last = tau > dt_tot;   // the last block, cut short at t_end
+		if(last){
+			tau = dt_tot;
+			for(int i = 0; i < n; i++){ step[i] = tau - time[i]; }
+		}
+
+		bool stop = false;        // with dense output, checked at t_out
+		while(e_flag && t_out <= t0 + tau){
+			predict_all(pos, vel, acc, jrk, time, pred_pos, pred_vel, n,
+						t_out - t0);
+			if(checking){
+				get_pot_dst(mass, pred_pos, dst, n, epot);
+				stop = check_stop(mass, pred_pos, pred_vel, dst, n, t_out,
+								  epot, einit, opt, why);
+			}else{
+				get_dst(mass, pred_pos, dst, n);
+			}
+			queue_snapshot(mass, pred_pos, pred_vel, dst, dst_count(mass, n),
+						   n, t_out);
+			if(stop || t_out == t_end){ break; }
+			t_out = t0 + ++k_out * dt_out;
+			if(t_out > t_end){ t_out = t_end; }
+		}
+		if(stop){
+			t = t_out;
+			break;
+		}
+
+		int nact = 0;
+		for(int i = 0; i < n; i++){
+			if(last || time[i] + step[i] == tau){ active[nact++] = i; }
+		}
+
+		predict_all(pos, vel, acc, jrk, time, pred_pos, pred_vel, n, tau);
+		if(nb.target > 0){
+			get_acc_jrk_coll_neighbors(nb, mass, pred_pos, pred_vel, new_acc,
+									   new_jrk, coll_time, active, nact, n,
+									   tau);
+		}else{
+			get_acc_jrk_coll_active(mass, pred_pos, pred_vel, new_acc,
+									new_jrk, coll_time, active, nact, n);
+		}
+		correct_active(pos, vel, acc, jrk, new_acc, new_jrk, step,
+					   active, nact);
+
+		if(nb.target > 0 && !last){   // irregular steps end at regular ones
+			next_regular_steps(nb, step, active, nact, tau, dt_max);
+		}
+		for(int a = 0; a < nact; a++){
+			int i = active[a];
+			time[i] = tau;
+			if(last){ continue; }
+			step[i] = next_block_step(step[i], dt_param * coll_time[i], tau,
+									  nb.target > 0 ? nb.dt_reg[i] : dt_max);
+		}
+
+		t = t0 + tau;
+		nsteps++;
+		nisteps += nact;
+
+		bool dia_due = dt_dia > 0 && t >= t_dia;
+		bool out_due = !e_flag && t >= t_out;
+		if(dia_due || out_due){
+			predict_all(pos, vel, acc, jrk, time, pred_pos, pred_vel, n, tau);
+			get_pot_dst(mass, pred_pos, dst, n, epot);
+		}
+		stop = (dia_due || out_due) && checking
+			&& check_stop(mass, pred_pos, pred_vel, dst, n, t, epot,
+						  einit, opt, why);
+		if(dia_due){
+			queue_diagnostics(mass, pred_pos, pred_vel, acc, jrk,
+							  n, t, epot, nsteps, x_flag);
+			do{ t_dia += dt_dia; } while(t_dia < t);
+			if(nb.target > 0){
+				flush_writer();
+				write_neighbors(nb, *get_output()->dia);
+			}
+		}
+		if(out_due){
+			queue_snapshot(mass, pred_pos, pred_vel, dst, dst_count(mass, n),
+						   n, t);
+			do{ t_out += dt_out; } while(t_out < t);
+		}
+		if(stop){
+			if(!out_due){
+				queue_snapshot(mass, pred_pos, pred_vel, dst,
+							   dst_count(mass, n), n, t);
+			}
+			break;
+		}
+	}
+
+	if(dt_dia == 0 || t > (t_dia - dt_dia)){
+		predict_all(pos, vel, acc, jrk, time, pred_pos, pred_vel, n, t - t0);
+		get_pot_dst(mass, pred_pos, dst, n, epot);
+		queue_diagnostics(mass, pred_pos, pred_vel, acc, jrk,
+						  n, t, epot, nsteps, x_flag);
+	}
+	flush_writer();           // the diagnostics above come first
+	*get_output()->dia << "  " << nisteps << " individual particle steps in "
+		 << nsteps << " block steps" << endl;
+	if(nb.target > 0){ write_neighbors(nb, *get_output()->dia); }
+
+	delete[] acc;
+	delete[] jrk;
+	delete[] new_acc;
+	delete[] new_jrk;
+	delete[] pred_pos;
+	delete[] pred_vel;
+	delete[] time;
+	delete[] step;
+	delete[] coll_time;
+	delete[] active;
+	return why;
+}
+
+}
\ No newline at end of file
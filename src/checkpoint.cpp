@@ -0,0 +1,287 @@
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>   // for fsync()
+#include "nbody.h"
+#include "checkpoint.h"
+#include "options.h"
+
+using namespace std;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  checkpoint.cpp: checkpoint files, from which a run continues exactly as
+ *                  if it had never been interrupted.
+ *
+ *     A snapshot is not enough for that: restarting from one recenters the
+ *     system, recomputes the forces, starts the energy error and the step
+ *     count from zero and schedules the output anew.  A checkpoint holds
+ *     all of evolve()'s state between two steps instead, in the precision
+ *     of the variant that wrote it:
+ *
+ *        header       struct checkpoint_header, 128 bytes, with the run
+ *                     settings that affect the integration
+ *        scalars      t, t_start, t_end, t_dia, t_out, t_sum, epot,
+ *                     coll_time, einit and dia_einit, as real
+ *        particles    mass[n], pos[n][ndim], vel, acc and jrk, as real
+ *        summary      t0, span, then sum, min, max, closest and t_closest
+ *                     of ndst values each, if the run writes summaries
+ *
+ *     The file is native binary, for the machine that wrote it.  It is
+ *     written to name.tmp and renamed to name once it is complete and on
+ *     disk, so that a run killed while writing leaves the last checkpoint
+ *     intact.
+ *
+ *     The settings in the header replace those given on the command line
+ *     when a run is resumed (see read_checkpoint()), the number of threads
+ *     among them, so the run then takes exactly the steps it would have
+ *     taken, to the last bit.
+ *-----------------------------------------------------------------------------
+ */
+
+struct checkpoint_header {
+	char    magic[8];         // "SOLIACKP"
+	int32_t version;          // CHECKPOINT_VERSION
+	int32_t ndim;             // number of dimensions
+	int32_t real_size;        // sizeof(real) of the variant that wrote it
+	int32_t n;                // number of particles
+	int32_t ndst;             // distances in the summary, 0 without
+	int32_t k_out;
+	int32_t nsteps;
+	int32_t flags;            // CK_E_FLAG, ...
+	int32_t nthreads;
+	int32_t reserved0;
+	double  dt_param, dt_dia, dt_out, dt_sum;
+	double  theta;
+	double  stop_dist, esc_dist, hill_factor, max_derr;
+	char    reserved[8];
+};
+
+static_assert(sizeof(checkpoint_header) == 128,
+			  "checkpoint_header must be 128 bytes");
+
+static const char CK_MAGIC[8] = {'S','O','L','I','A','C','K','P'};
+const int CHECKPOINT_VERSION = 1;
+const int CK_E_FLAG = 1, CK_S_FLAG = 2, CK_D_FLAG = 4, CK_P_FLAG = 8;
+const int CK_NSCALAR = 10;
+
+static bool write_reals(FILE *f, const real x[], size_t count){
+	return fwrite(x, sizeof(real), count, f) == count;
+}
+
+static bool read_reals(FILE *f, real x[], size_t count){
+	return fread(x, sizeof(real), count, f) == count;
+}
+
+/*-----------------------------------------------------------------------------
+ *  write_checkpoint  --  writes ck, with the settings of opt, to the
+ *                        checkpoint file name, replacing it atomically.
+ *-----------------------------------------------------------------------------
+ */
+
+bool write_checkpoint(const char *name, const checkpoint & ck,
+					  const options & opt){
+	checkpoint_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, CK_MAGIC, sizeof(CK_MAGIC));
+	h.version = CHECKPOINT_VERSION;
+	h.ndim = NDIM;
+	h.real_size = sizeof(real);
+	h.n = ck.n;
+	h.ndst = ck.sum.ndst;
+	h.k_out = ck.k_out;
+	h.nsteps = ck.nsteps;
+	h.flags = (opt.e_flag ? CK_E_FLAG : 0) | (opt.s_flag ? CK_S_FLAG : 0)
+			| (opt.D_flag ? CK_D_FLAG : 0) | (opt.P_flag ? CK_P_FLAG : 0);
+	h.nthreads = opt.nthreads;
+	h.dt_param = opt.dt_param;
+	h.dt_dia = opt.dt_dia;
+	h.dt_out = opt.dt_out;
+	h.dt_sum = opt.dt_sum;
+	h.theta = opt.theta;
+	h.stop_dist = opt.stop_dist;
+	h.esc_dist = opt.esc_dist;
+	h.hill_factor = opt.hill_factor;
+	h.max_derr = opt.max_derr;
+
+	string tmp = string(name) + ".tmp";
+	FILE *f = fopen(tmp.c_str(), "wb");
+	if(!f){
+		cerr << "write_checkpoint: cannot create " << tmp << endl;
+		return false;
+	}
+	real scalars[CK_NSCALAR] = {ck.t, ck.t_start, ck.t_end, ck.t_dia,
+								ck.t_out, ck.t_sum, ck.epot, ck.coll_time,
+								ck.einit, ck.dia_einit};
+	size_t nv = ck.n * NDIM;
+	bool ok = fwrite(&h, sizeof(h), 1, f) == 1
+		   && write_reals(f, scalars, CK_NSCALAR)
+		   && write_reals(f, ck.mass.data(), ck.n)
+		   && write_reals(f, ck.pos.data(), nv)
+		   && write_reals(f, ck.vel.data(), nv)
+		   && write_reals(f, ck.acc.data(), nv)
+		   && write_reals(f, ck.jrk.data(), nv);
+	const summary & s = ck.sum;
+	if(ok && s.ndst > 0){
+		real window[2] = {s.t0, s.span};
+		ok = write_reals(f, window, 2)
+		  && write_reals(f, s.sum.data(), s.ndst)
+		  && write_reals(f, s.min.data(), s.ndst)
+		  && write_reals(f, s.max.data(), s.ndst)
+		  && write_reals(f, s.closest.data(), s.ndst)
+		  && write_reals(f, s.t_closest.data(), s.ndst);
+	}
+	ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+	ok = fclose(f) == 0 && ok;
+	if(!ok || rename(tmp.c_str(), name) != 0){
+		cerr << "write_checkpoint: cannot write " << name << endl;
+		remove(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *  checkpoint_ndim  --  returns the number of dimensions of a checkpoint
+ *                       file, and whether it holds long doubles, or 0 if
+ *                       the file is not one.  Like snap_file_ndim(), this
+ *                       accepts files of any variant.
+ *-----------------------------------------------------------------------------
+ */
+
+int checkpoint_ndim(const char *name, bool & long_double){
+	FILE *f = fopen(name, "rb");
+	if(!f){ return 0; }
+	checkpoint_header h;
+	bool yes = fread(&h, sizeof(h), 1, f) == 1
+			&& memcmp(h.magic, CK_MAGIC, sizeof(CK_MAGIC)) == 0
+			&& h.version == CHECKPOINT_VERSION;
+	fclose(f);
+	long_double = yes && h.real_size != sizeof(double);
+	return yes ? h.ndim : 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *  read_checkpoint  --  reads the checkpoint file name into ck, and replaces
+ *                       the settings in opt that the run was started with.
+ *-----------------------------------------------------------------------------
+ */
+
+bool read_checkpoint(const char *name, checkpoint & ck, options & opt){
+	FILE *f = fopen(name, "rb");
+	if(!f){
+		cerr << "read_checkpoint: cannot open " << name << endl;
+		return false;
+	}
+	checkpoint_header h;
+	if(fread(&h, sizeof(h), 1, f) != 1
+	   || memcmp(h.magic, CK_MAGIC, sizeof(CK_MAGIC)) != 0
+	   || h.version != CHECKPOINT_VERSION || h.ndim != NDIM
+	   || h.real_size != sizeof(real) || h.n < 1){
+		cerr << "read_checkpoint: " << name
+			 << " is not a checkpoint file of this variant" << endl;
+		fclose(f);
+		return false;
+	}
+
+	ck.n = h.n;
+	ck.k_out = h.k_out;
+	ck.nsteps = h.nsteps;
+	size_t nv = ck.n * NDIM;
+	ck.mass.resize(ck.n);
+	ck.pos.resize(nv);
+	ck.vel.resize(nv);
+	ck.acc.resize(nv);
+	ck.jrk.resize(nv);
+	real scalars[CK_NSCALAR];
+	bool ok = read_reals(f, scalars, CK_NSCALAR)
+		   && read_reals(f, ck.mass.data(), ck.n)
+		   && read_reals(f, ck.pos.data(), nv)
+		   && read_reals(f, ck.vel.data(), nv)
+		   && read_reals(f, ck.acc.data(), nv)
+		   && read_reals(f, ck.jrk.data(), nv);
+	summary & s = ck.sum;
+	s.ndst = h.ndst;
+	if(ok && s.ndst > 0){
+		s.sum.resize(s.ndst);
+		s.min.resize(s.ndst);
+		s.max.resize(s.ndst);
+		s.closest.resize(s.ndst);
+		s.t_closest.resize(s.ndst);
+		real window[2];
+		ok = read_reals(f, window, 2)
+		  && read_reals(f, s.sum.data(), s.ndst)
+		  && read_reals(f, s.min.data(), s.ndst)
+		  && read_reals(f, s.max.data(), s.ndst)
+		  && read_reals(f, s.closest.data(), s.ndst)
+		  && read_reals(f, s.t_closest.data(), s.ndst);
+		s.t0 = window[0];
+		s.span = window[1];
+	}
+	fclose(f);
+	if(!ok){
+		cerr << "read_checkpoint: " << name << " is truncated" << endl;
+		return false;
+	}
+
+	ck.t = scalars[0];
+	ck.t_start = scalars[1];
+	ck.t_end = scalars[2];
+	ck.t_dia = scalars[3];
+	ck.t_out = scalars[4];
+	ck.t_sum = scalars[5];
+	ck.epot = scalars[6];
+	ck.coll_time = scalars[7];
+	ck.einit = scalars[8];
+	ck.dia_einit = scalars[9];
+
+	opt.e_flag = h.flags & CK_E_FLAG;
+	opt.s_flag = h.flags & CK_S_FLAG;
+	opt.D_flag = h.flags & CK_D_FLAG;
+	opt.P_flag = h.flags & CK_P_FLAG;
+	opt.nthreads = h.nthreads;
+	opt.dt_param = h.dt_param;
+	opt.dt_dia = h.dt_dia;
+	opt.dt_out = h.dt_out;
+	opt.dt_sum = h.dt_sum;
+	opt.theta = h.theta;
+	opt.stop_dist = h.stop_dist;
+	opt.esc_dist = h.esc_dist;
+	opt.hill_factor = h.hill_factor;
+	opt.max_derr = h.max_derr;
+	opt.dt_tot = ck.t_end - ck.t;
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *  catch_stop_signals, stop_signal  --  after catch_stop_signals(), SIGTERM
+ *                                       (as sent by batch systems before
+ *                                       preempting a job) and SIGINT no
+ *                                       longer end the program; instead
+ *                                       stop_signal() returns the signal,
+ *                                       so that evolve() can write a last
+ *                                       checkpoint and stop.  0 if none
+ *                                       has come.
+ *-----------------------------------------------------------------------------
+ */
+
+static volatile sig_atomic_t caught = 0;
+
+static void catch_signal(int sig){
+	caught = sig;
+}
+
+void catch_stop_signals(){
+	signal(SIGTERM, catch_signal);
+	signal(SIGINT, catch_signal);
+}
+
+int stop_signal(){
+	return caught;
+}
+
+}
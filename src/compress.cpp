@@ -0,0 +1,192 @@
+#include <cstring>
+#include <cmath>
+#include <algorithm>  // for copy()
+#include "compress.h"
+
+using namespace std;
+
+/*-----------------------------------------------------------------------------
+ *  compress.cpp: predictive XOR compression of snapshot records.
+ *
+ *     Between two snapshots the positions, velocities and distances change
+ *     smoothly, and the masses not at all.  Each value of a record is
+ *     predicted from the same value a, b, c in the last three records, by
+ *     linear extrapolation, a + (a - b), and by quadratic extrapolation,
+ *     3(a - b) + c; either is exact for a constant.  The prediction
+ *     that comes closer is XORed with the value; the result has as many
+ *     leading zero bits as the prediction has leading bits right, and only
+ *     its nonzero low bytes are stored.  As in FPC (Burtscher &
+ *     Ratanaworabhan, 2009), a 4-bit code gives the predictor and the number
+ *     of zero bytes, and the codes of two values share a byte:
+ *
+ *        code byte   value a in the low 4 bits, value b in the high 4
+ *        residual a  8 - zero bytes, least significant first
+ *        residual b
+ *
+ *     where the low 3 bits of a code give 0, 1, 2, 3, 5, 6, 7 or 8 zero
+ *     bytes (4 is written as 3), and bit 3 is set for the quadratic
+ *     prediction.  Until there are three records, the missing ones are
+ *     taken to equal the oldest one there is.
+ *
+ *     Decoding runs the same predictors on the values already decoded, so
+ *     the values come back bit for bit.  The predictions are computed with
+ *     additions only, in a fixed order, which the compiler cannot contract
+ *     into fused multiply-adds, so that any IEEE reader gets the same (see
+ *     OrbitData.py).
+ *
+ *     For a smaller file, values after the first nexact of each record (the
+ *     time and the masses) can be rounded to keep_bits bits of mantissa, a
+ *     relative error of at most 2^-(keep_bits+1).  The predictions are
+ *     rounded the same way, so the dropped low bits of the XOR are always
+ *     zero and are shifted out before its zero bytes are counted.
+ *
+ *     The first record after start_codec() or reset_codec() is predicted as
+ *     0, so it is stored in full and can be decoded on its own.
+ *-----------------------------------------------------------------------------
+ */
+
+static uint64_t to_bits(double x){
+	uint64_t b;
+	memcpy(&b, &x, sizeof(b));
+	return b;
+}
+
+static double from_bits(uint64_t b){
+	double x;
+	memcpy(&x, &b, sizeof(x));
+	return x;
+}
+
+static uint64_t round_bits(uint64_t b, int drop){
+	if(drop == 0){ return b; }
+	uint64_t half = (uint64_t) 1 << (drop - 1);
+	return (b + half) & ~((half << 1) - 1);  // a carry into the exponent
+}                                            // rounds up correctly
+
+/*-----------------------------------------------------------------------------
+ *  keep_bits_for  --  the number of mantissa bits to keep for a relative
+ *                     error of at most bound; 52, lossless, for a bound of 0.
+ *-----------------------------------------------------------------------------
+ */
+
+int keep_bits_for(double bound){
+	if(bound <= 0){ return 52; }
+	int keep = (int) ceil(-log2(bound)) - 1;
+	return keep < 0 ? 0 : keep > 52 ? 52 : keep;
+}
+
+/*-----------------------------------------------------------------------------
+ *  start_codec  --  sets up c for records of nval values, of which all but
+ *                   the first nexact are rounded to keep_bits bits of
+ *                   mantissa.
+ *-----------------------------------------------------------------------------
+ */
+
+void start_codec(xor_codec & c, int nval, int nexact, int keep_bits){
+	c.nval = nval;
+	c.nexact = nexact;
+	c.drop = 52 - keep_bits;
+	c.prev1.assign(nval, 0);
+	c.prev2.assign(nval, 0);
+	c.prev3.assign(nval, 0);
+	c.count = 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *  reset_codec  --  forgets the history, so that the next record is stored
+ *                   in full.
+ *-----------------------------------------------------------------------------
+ */
+
+void reset_codec(xor_codec & c){
+	c.count = 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *  predict  --  the two predictions for value i of the next record.
+ *-----------------------------------------------------------------------------
+ */
+
+static void predict(const xor_codec & c, int i, int drop, uint64_t p[2]){
+	double a = c.count > 0 ? c.prev1[i] : 0;
+	double b = c.count > 1 ? c.prev2[i] : a;
+	double c3 = c.count > 2 ? c.prev3[i] : b;
+	double d = a - b;
+	p[0] = round_bits(to_bits(a + d), drop);
+	p[1] = round_bits(to_bits(d + d + d + c3), drop);
+}
+
+static void push_history(xor_codec & c, const double rec[]){
+	c.prev3.swap(c.prev2);
+	c.prev2.swap(c.prev1);
+	copy(rec, rec + c.nval, c.prev1.begin());
+	c.count++;
+}
+
+/*-----------------------------------------------------------------------------
+ *  encode_record  --  appends the encoding of rec[] to out.  Values that are
+ *                     rounded are rounded in rec[] too, so that the caller
+ *                     sees what a reader will get.
+ *-----------------------------------------------------------------------------
+ */
+
+void encode_record(xor_codec & c, double rec[], vector<unsigned char> & out){
+	for(int i = 0; i < c.nval; i += 2){
+		size_t code_at = out.size();
+		out.push_back(0);
+		for(int h = 0; h < 2 && i + h < c.nval; h++){
+			int v = i + h;
+			int drop = v < c.nexact ? 0 : c.drop;
+			uint64_t x = round_bits(to_bits(rec[v]), drop);
+			rec[v] = from_bits(x);
+
+			uint64_t p[2];
+			predict(c, v, drop, p);
+			uint64_t r0 = (x ^ p[0]) >> drop, r1 = (x ^ p[1]) >> drop;
+			int sel = r1 < r0;
+			uint64_t r = sel ? r1 : r0;
+
+			int zeros = r == 0 ? 8 : __builtin_clzll(r) / 8;
+			if(zeros == 4){ zeros = 3; }
+			int code = (sel << 3) | (zeros > 4 ? zeros - 1 : zeros);
+			out[code_at] |= code << (4 * h);
+			for(int k = 0; k < 8 - zeros; k++){
+				out.push_back((r >> (8 * k)) & 0xff);
+			}
+		}
+	}
+	push_history(c, rec);
+}
+
+/*-----------------------------------------------------------------------------
+ *  decode_record  --  decodes the size bytes at in into rec[].  Returns
+ *                     false if they do not hold exactly one record.
+ *-----------------------------------------------------------------------------
+ */
+
+bool decode_record(xor_codec & c, const unsigned char *in, size_t size,
+				   double rec[]){
+	const unsigned char *end = in + size;
+	for(int i = 0; i < c.nval; i += 2){
+		if(in == end){ return false; }
+		int codes = *in++;
+		for(int h = 0; h < 2 && i + h < c.nval; h++){
+			int v = i + h;
+			int drop = v < c.nexact ? 0 : c.drop;
+			int code = (codes >> (4 * h)) & 0xf;
+			int zeros = code & 7;
+			if(zeros >= 4){ zeros++; }
+			if(end - in < 8 - zeros){ return false; }
+			uint64_t r = 0;
+			for(int k = 0; k < 8 - zeros; k++){
+				r |= (uint64_t) *in++ << (8 * k);
+			}
+
+			uint64_t p[2];
+			predict(c, v, drop, p);
+			rec[v] = from_bits((r << drop) ^ p[code >> 3]);
+		}
+	}
+	push_history(c, rec);
+	return in == end;
+}
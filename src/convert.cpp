@@ -0,0 +1,125 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "nbody.h"
+#include "snapfile.h"
+
+using namespace std;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  text_to_binary  --  reads text snapshots from in and writes them to the
+ *                      binary snapshot file name, compressed to a relative
+ *                      error of bound if bound >= 0 (see snapfile.cpp).
+ *                      All snapshots must have the same number of particles
+ *                      and distances.
+ *-----------------------------------------------------------------------------
+ */
+
+bool text_to_binary(istream & in, const char *name, double bound){
+	int n, n0 = 0, ndst = -1;        // n0, ndst: those of the first snapshot
+	real t;
+	real *mass = 0;
+	real (*pos)[NDIM] = 0;
+	real (*vel)[NDIM] = 0;
+	long long nrec = 0;
+	bool ok = true;
+	snap_writer out;
+
+	while(ok && in >> n >> t){
+		if(!mass){
+			n0 = n;
+			mass = new real[n];
+			pos = new real[n][NDIM];
+			vel = new real[n][NDIM];
+		}else if(n != n0){
+			cerr << "snapconv: snapshot at t = " << t << " has " << n
+				 << " particles, not " << n0 << endl;
+			ok = false;
+			break;
+		}
+		for(int i = 0; i < n; i++){
+			in >> mass[i];
+			for(int k = 0; k < NDIM; k++){ in >> pos[i][k]; }
+			for(int k = 0; k < NDIM; k++){ in >> vel[i][k]; }
+		}
+
+		string line;
+		getline(in, line);                // rest of the last particle line
+		getline(in, line);                // the distances
+		vector<real> dst;
+		istringstream ds(line);
+		real d;
+		while(ds >> d){ dst.push_back(d); }
+
+		if(ndst < 0){
+			ndst = dst.size();
+			ok = open_snap_writer(name, n, ndst, out, bound);
+		}else if((int) dst.size() != ndst){
+			cerr << "snapconv: snapshot at t = " << t << " has "
+				 << dst.size() << " distances, not " << ndst << endl;
+			ok = false;
+		}
+		if(ok){
+			put_snap_record(out, t, mass, pos, vel, dst.data());
+			nrec++;
+		}
+	}
+	close_snap_writer(out);
+
+	delete[] mass;
+	delete[] pos;
+	delete[] vel;
+	cerr << "snapconv: " << nrec << " snapshots written to " << name << endl;
+	return ok;
+}
+
+/*-----------------------------------------------------------------------------
+ *  binary_to_text  --  writes all records of the binary snapshot file name
+ *                      to out, in the text format of put_snapshot().
+ *-----------------------------------------------------------------------------
+ */
+
+bool binary_to_text(const char *name, ostream & out){
+	snap_reader in;
+	if(!open_snap_reader(name, in)){ return false; }
+
+	int n = in.head.n;
+	int ndst = in.head.ndst;
+	real *mass = new real[n];
+	real (*pos)[NDIM] = new real[n][NDIM];
+	real (*vel)[NDIM] = new real[n][NDIM];
+	real *dst = new real[ndst];
+
+	bool ok = true;
+	out.precision(16);
+	for(long long r = 0; ok && r < in.nrec; r++){
+		real t;
+		ok = read_snap_record(in, r, t, mass, pos, vel, dst);
+		if(!ok){
+			cerr << "snapconv: cannot read record " << r << endl;
+			break;
+		}
+		out << n << ' ' << t << '\n';
+		for(int i = 0; i < n; i++){
+			out << mass[i];
+			for(int k = 0; k < NDIM; k++){ out << ' ' << pos[i][k]; }
+			for(int k = 0; k < NDIM; k++){ out << ' ' << vel[i][k]; }
+			out << '\n';
+		}
+		for(int i = 0; i < ndst; i++){ out << dst[i] << ' '; }
+		out << '\n';
+	}
+	out.flush();
+	close_snap_reader(in);
+
+	delete[] mass;
+	delete[] pos;
+	delete[] vel;
+	delete[] dst;
+	return ok;
+}
+
+}
@@ -0,0 +1,204 @@
+#include <iostream>
+#include <cmath>      // to include sqrt(), etc.
+#include <chrono>
+#include "nbody.h"
+#include "evolve.h"
+#include "state.h"
+#include "wh.h"
+#include "encounter.h"
+
+using namespace std;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  encounter.cpp: regularized close encounters for the global Hermite
+ *                 scheme.
+ *
+ *     With a global time step, a single close pair forces the whole system
+ *     onto the tiny steps its own orbit needs.  When two massive particles
+ *     come closer than r_reg, the pair is instead replaced by a single
+ *     particle at its center of mass, which the Hermite scheme integrates
+ *     with the rest of the system (the reduced system), while the relative
+ *     motion of the pair follows its Kepler orbit, advanced exactly by
+ *     kepler_drift() however eccentric it is, and is kicked by the
+ *     difference of the external accelerations on its two members (the
+ *     tidal perturbation) for half a step before and after.  The step size
+ *     of the reduced system no longer depends on the separation of the
+ *     pair.  The pair is handed back to the normal integration once its
+ *     separation exceeds r_reg by the factor REG_EXIT.
+ *
+ *     The other particles feel the pair as a point mass at its center of
+ *     mass, and the center of mass feels the external forces at that point,
+ *     so the neglected terms are of order (r_pair / distance)^2 relative to
+ *     the external forces; r_reg should be small next to the distance to
+ *     any third body.  Only one pair at a time is regularized.
+ *-----------------------------------------------------------------------------
+ */
+
+const real REG_EXIT = 1.2;        // ends an encounter beyond REG_EXIT*r_reg
+
+/*-----------------------------------------------------------------------------
+ *  start_encounter  --  looks for the closest pair of massive particles
+ *                       within r_reg, using the distances dst[] from the
+ *                       last force calculation, and if there is one, sets
+ *                       up the encounter and its reduced system and
+ *                       returns true.
+ *-----------------------------------------------------------------------------
+ */
+
+bool start_encounter(const real mass[], const real pos[][NDIM],
+					 const real vel[][NDIM], const real dst[], int n,
+					 real r_reg, encounter & e){
+	int nm = massive_count(mass, n);
+	int w = dst_width(nm, n);
+	real closest = r_reg;
+	for(int i = 0; i < nm; i++){
+		int row = dst_row(i, w) - i - 1;
+		for(int j = i+1; j < nm; j++){
+			if(dst[row + j] < closest){
+				closest = dst[row + j];
+				e.i = i;
+				e.j = j;
+			}
+		}
+	}
+	if(e.i < 0){ return false; }
+
+	int i = e.i, j = e.j;
+	e.mi = mass[i];
+	e.mj = mass[j];
+	e.gm = mass[i] + mass[j];
+	e.nr = n - 1;
+	e.mass = new real[e.nr];
+	e.st.reserve(e.nr);
+
+	for(int f = 0, r = 0; f < n; f++){   // the pair's mass stays at i, so
+		if(f == j){ continue; }          // test particles still come last
+		e.mass[r] = mass[f];
+		for(int k = 0; k < NDIM; k++){
+			e.st.pos[r][k] = pos[f][k];
+			e.st.vel[r][k] = vel[f][k];
+		}
+		r++;
+	}
+	e.mass[i] = e.gm;
+	for(int k = 0; k < NDIM; k++){
+		e.st.pos[i][k] = (mass[i] * pos[i][k] + mass[j] * pos[j][k]) / e.gm;
+		e.st.vel[i][k] = (mass[i] * vel[i][k] + mass[j] * vel[j][k]) / e.gm;
+		e.rel_pos[k] = pos[j][k] - pos[i][k];
+		e.rel_vel[k] = vel[j][k] - vel[i][k];
+	}
+	e.dst = new real[dst_count(e.mass, e.nr)];
+
+	get_acc_jrk_pot_coll(e.mass, e.st.pos, e.st.vel, e.st.acc, e.st.jrk,
+						 e.dst, e.nr, e.epot, e.coll_time);
+	e.count++;
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *  tidal_kick  --  changes the relative velocity of the pair by the
+ *                  difference of the accelerations of its members due to
+ *                  the other massive particles, over dt.
+ *-----------------------------------------------------------------------------
+ */
+
+static void tidal_kick(encounter & e, real dt){
+	int c = e.i;                          // the pair in the reduced system
+	int nm = massive_count(e.mass, e.nr);
+	real xi[NDIM], xj[NDIM], ai[NDIM] = {}, aj[NDIM] = {};
+	for(int k = 0; k < NDIM; k++){
+		xi[k] = e.st.pos[c][k] - e.mj / e.gm * e.rel_pos[k];
+		xj[k] = e.st.pos[c][k] + e.mi / e.gm * e.rel_pos[k];
+	}
+	for(int p = 0; p < nm; p++){
+		if(p == c){ continue; }
+		real di[NDIM], dj[NDIM], ri2 = 0, rj2 = 0;
+		for(int k = 0; k < NDIM; k++){
+			di[k] = e.st.pos[p][k] - xi[k];
+			dj[k] = e.st.pos[p][k] - xj[k];
+			ri2 += di[k] * di[k];
+			rj2 += dj[k] * dj[k];
+		}
+		real ri3 = ri2 * sqrt(ri2), rj3 = rj2 * sqrt(rj2);
+		for(int k = 0; k < NDIM; k++){
+			ai[k] += e.mass[p] * di[k] / ri3;
+			aj[k] += e.mass[p] * dj[k] / rj3;
+		}
+	}
+	for(int k = 0; k < NDIM; k++){ e.rel_vel[k] += dt * (aj[k] - ai[k]); }
+}
+
+/*-----------------------------------------------------------------------------
+ *  encounter_step  --  advances the encounter by dt: the reduced system by a
+ *                      Hermite step, and the pair by a Kepler drift between
+ *                      two half tidal kicks.  The full system is then
+ *                      written back to pos[] and vel[].  If the pair has
+ *                      separated far enough, the encounter ends.
+ *
+ *  note: dt should come from e.coll_time, the collision time scale of the
+ *        reduced system; accelerations, jerks, distances and potential
+ *        energy of the full system are left to the caller.
+ *-----------------------------------------------------------------------------
+ */
+
+void encounter_step(encounter & e, real pos[][NDIM], real vel[][NDIM], int n,
+					real dt, real r_reg){
+	auto start = chrono::steady_clock::now();
+	tidal_kick(e, dt/2);
+	kepler_drift(e.gm, e.rel_pos, e.rel_vel, dt);
+	evolve_step(e.mass, e.st, e.dst, e.nr, dt, e.epot, e.coll_time);
+	tidal_kick(e, dt/2);
+
+	int i = e.i, j = e.j;
+	real r2 = 0;
+	for(int f = 0, r = 0; f < n; f++){
+		if(f == j){ continue; }
+		for(int k = 0; k < NDIM; k++){
+			pos[f][k] = e.st.pos[r][k];
+			vel[f][k] = e.st.vel[r][k];
+		}
+		r++;
+	}
+	for(int k = 0; k < NDIM; k++){
+		pos[i][k] = e.st.pos[i][k] - e.mj / e.gm * e.rel_pos[k];
+		vel[i][k] = e.st.vel[i][k] - e.mj / e.gm * e.rel_vel[k];
+		pos[j][k] = e.st.pos[i][k] + e.mi / e.gm * e.rel_pos[k];
+		vel[j][k] = e.st.vel[i][k] + e.mi / e.gm * e.rel_vel[k];
+		r2 += e.rel_pos[k] * e.rel_pos[k];
+	}
+
+	e.steps++;
+	e.time += dt;
+	e.wall += chrono::duration<double>(chrono::steady_clock::now()
+									   - start).count();
+	if(r2 > REG_EXIT * REG_EXIT * r_reg * r_reg){ end_encounter(e); }
+}
+
+/*-----------------------------------------------------------------------------
+ *  end_encounter  --  hands the pair back, freeing the reduced system; the
+ *                     statistics are kept.
+ *-----------------------------------------------------------------------------
+ */
+
+void end_encounter(encounter & e){
+	if(e.i < 0){ return; }
+	delete[] e.mass;
+	delete[] e.dst;
+	e.i = e.j = -1;
+	e.nr = 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *  write_encounters  --  writes the encounter statistics of a run.
+ *-----------------------------------------------------------------------------
+ */
+
+void write_encounters(const encounter & e, ostream & out){
+	out << "  " << e.count << " close encounters regularized, for "
+		<< e.steps << " steps and " << e.time << " s of simulated time ("
+		<< e.wall << " s wall clock time)" << endl;
+}
+
+}
\ No newline at end of file
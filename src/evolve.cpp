@@ -2,12 +2,49 @@
 #include <cfloat>     // for DBL_MAX
 #include "nbody.h"
 #include "evolve.h"
+#include "state.h"
+#include "profile.h"
+#include "simd.h"
+#include "parallel.h"
+#include "tree.h"
 
 using namespace std;
 
+namespace NBODY_VARIANT {
+
+static bool force_simd = false;   // use the vectorized force kernel
+static bool test_dst = true;      // output distances of test particles
+static bool test_coll = false;    // test particles limit the collision time
+
 /*-----------------------------------------------------------------------------
  *  evolve_step  --  takes one integration step for an N-body system, using the
- *                   Hermite algorithm.
+ *                   Hermite algorithm.  The state is swapped first, so that
+ *                   the old values are those at the start of the step, and
+ *                   the new ones are written over the values of the step
+ *                   before; see state.cpp.
+ *-----------------------------------------------------------------------------
+ */
+
+void evolve_step(const real mass[], particle_state & s, real dst[],
+				 int n, real dt, real & epot, real & coll_time){
+	PROFILE_START(t0);
+	s.swap();
+	predict_step(s.old_pos, s.old_vel, s.old_acc, s.old_jrk, n, dt,
+				 s.pos, s.vel);
+	PROFILE_STOP(PROF_PREDICT, t0);
+	PROFILE_START(t1);
+	get_acc_jrk_pot_coll(mass, s.pos, s.vel, s.acc, s.jrk, dst, n, epot,
+						 coll_time);
+	PROFILE_STOP(PROF_FORCE, t1);
+	PROFILE_START(t2);
+	correct_step(s.pos, s.vel, s.acc, s.jrk, s.old_pos, s.old_vel,
+				 s.old_acc, s.old_jrk, n, dt);
+	PROFILE_STOP(PROF_CORRECT, t2);
+}
+
+/*-----------------------------------------------------------------------------
+ *  evolve_step  --  the same, for separate arrays: the values at the start
+ *                   of the step are copied to the old_* arrays first.
  *-----------------------------------------------------------------------------
  */
 
@@ -27,9 +64,15 @@ void evolve_step(const real mass[],
 		}
 	}
 
+	PROFILE_START(t0);
 	predict_step(pos, vel, acc, jrk, n, dt);
+	PROFILE_STOP(PROF_PREDICT, t0);
+	PROFILE_START(t1);
 	get_acc_jrk_pot_coll(mass, pos, vel, acc, jrk, dst, n, epot, coll_time);
+	PROFILE_STOP(PROF_FORCE, t1);
+	PROFILE_START(t2);
 	correct_step(pos, vel, acc, jrk, old_pos, old_vel, old_acc, old_jrk, n, dt);
+	PROFILE_STOP(PROF_CORRECT, t2);
 }
 
 /*-----------------------------------------------------------------------------
@@ -44,9 +87,26 @@ void predict_step(real pos[][NDIM], real vel[][NDIM],
 				  int n, real dt){
 	for(int i = 0; i < n; i++){
 		for(int k = 0; k < NDIM; k++){
-			pos[i][k] += vel[i][k]*dt + acc[i][k]*dt*dt/2
-									  + jrk[i][k]*dt*dt*dt/6;
-			vel[i][k] += acc[i][k]*dt + jrk[i][k]*dt*dt/2;
+			hermite_predict(pos[i][k], vel[i][k], acc[i][k], jrk[i][k], dt,
+							pos[i][k], vel[i][k]);
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  predict_step  --  the same, starting from pos and vel and writing the
+ *                    predicted values to new_pos and new_vel instead.
+ *-----------------------------------------------------------------------------
+ */
+
+void predict_step(const real pos[][NDIM], const real vel[][NDIM],
+				  const real acc[][NDIM], const real jrk[][NDIM],
+				  int n, real dt, real new_pos[][NDIM],
+				  real new_vel[][NDIM]){
+	for(int i = 0; i < n; i++){
+		for(int k = 0; k < NDIM; k++){
+			hermite_predict(pos[i][k], vel[i][k], acc[i][k], jrk[i][k], dt,
+							new_pos[i][k], new_vel[i][k]);
 		}
 	}
 }
@@ -66,10 +126,9 @@ void correct_step(real pos[][NDIM], real vel[][NDIM],
 				  int n, real dt){
 	for(int i = 0; i < n; i++){
 		for(int k = 0; k < NDIM; k++){
-			vel[i][k] = old_vel[i][k] + (old_acc[i][k] + acc[i][k])*dt/2
-									  + (old_jrk[i][k] - jrk[i][k])*dt*dt/12;
-			pos[i][k] = old_pos[i][k] + (old_vel[i][k] + vel[i][k])*dt/2
-									  + (old_acc[i][k] - acc[i][k])*dt*dt/12;
+			hermite_correct(old_pos[i][k], old_vel[i][k], old_acc[i][k],
+							old_jrk[i][k], acc[i][k], jrk[i][k], dt,
+							pos[i][k], vel[i][k]);
 		}
 	}
 }
@@ -96,6 +155,14 @@ void correct_step(real pos[][NDIM], real vel[][NDIM],
  *  the estimate for the collision time is found by determining the minimum
  *  value over all particle pairs and over the two choices of collision time,
  *  position/velocity and sqrt(position/acceleration).
+ *
+ *  Massless test particles (see massive_count()) only feel the massive
+ *  ones.  They are handled separately in test_rows(), which costs one pass
+ *  over the massive particles per test particle instead of a share of the
+ *  full double loop.
+ *
+ *  The work is done by one of the kernels below (or in simd.cpp), as chosen
+ *  with set_force_simd(), set_force_threads() and set_force_tree().
  *-----------------------------------------------------------------------------
  */
 
@@ -103,19 +170,167 @@ void get_acc_jrk_pot_coll(const real mass[], const real pos[][NDIM],
 						  const real vel[][NDIM], real acc[][NDIM],
 						  real jrk[][NDIM], real dst[], int n,
 						  real & epot, real & coll_time){
+	int nm = massive_count(mass, n);
+	if(force_tree()){
+		get_acc_jrk_pot_coll_tree(mass, pos, vel, acc, jrk, dst, n,
+								  epot, coll_time);
+	}else if(force_simd){
+		get_acc_jrk_pot_coll_simd(mass, pos, vel, acc, jrk, dst, n,
+								  epot, coll_time);
+	}else if(pair_task_count(0.5*n*(n-1) - 0.5*(n-nm)*(n-nm-1)) > 1){
+		get_acc_jrk_pot_coll_parallel(mass, pos, vel, acc, jrk, dst, n,
+									  epot, coll_time);
+	}else{
+		get_acc_jrk_pot_coll_scalar(mass, pos, vel, acc, jrk, dst, n,
+									epot, coll_time);
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  massive_count  --  the number of massive particles.  Test particles have
+ *                     zero mass and always follow all massive particles (as
+ *                     enforced by get_snapshot()), so this is the index of
+ *                     the first zero mass, or n if there is none.
+ *-----------------------------------------------------------------------------
+ */
+
+int massive_count(const real mass[], int n){
+	int lo = 0, hi = n;          // mass[lo-1] > 0, mass[hi] == 0
+	while(lo < hi){
+		int mid = (lo + hi) / 2;
+		if(mass[mid] > 0){ lo = mid + 1; }else{ hi = mid; }
+	}
+	return lo;
+}
+
+/*-----------------------------------------------------------------------------
+ *  dst_width  --  the number of particles covered by the pairwise distances
+ *                 in dst[]: all n, or only the nm massive ones if distances
+ *                 of test particles are left out.  Row i of the dst[]
+ *                 triangle starts at dst_row(i, dst_width()).
+ *-----------------------------------------------------------------------------
+ */
+
+int dst_width(int nm, int n){
+	return test_dst ? n : nm;
+}
+
+int dst_row(int i, int w){
+	return i*(2*w - i - 1)/2;
+}
+
+/*-----------------------------------------------------------------------------
+ *  dst_count  --  the number of entries get_acc_jrk_pot_coll() writes to
+ *                 dst[] for a system: one per pair of the particles counted
+ *                 by dst_width(), or only the distances from particle 0 to
+ *                 the others when the tree code is used.
+ *-----------------------------------------------------------------------------
+ */
+
+int dst_count(const real mass[], int n){
+	int w = dst_width(massive_count(mass, n), n);
+	return force_tree() ? w-1 : w*(w-1)/2;
+}
+
+/*-----------------------------------------------------------------------------
+ *  set_test_particles  --  chooses whether distances involving test particles
+ *                          are written (dst, default true), and whether test
+ *                          particles take part in the collision time estimate
+ *                          that sets the global time step (coll, default
+ *                          false).
+ *-----------------------------------------------------------------------------
+ */
+
+void set_test_particles(bool dst, bool coll){
+	test_dst = dst;
+	test_coll = coll;
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_particle_dst, test_particle_coll  --  the current settings.
+ *-----------------------------------------------------------------------------
+ */
+
+bool test_particle_dst(){
+	return test_dst;
+}
+
+bool test_particle_coll(){
+	return test_coll;
+}
+
+/*-----------------------------------------------------------------------------
+ *  set_force_simd  --  selects the vectorized (true) or the scalar (false)
+ *                      kernel for get_acc_jrk_pot_coll().  The scalar kernel
+ *                      is the default.
+ *-----------------------------------------------------------------------------
+ */
+
+void set_force_simd(bool simd){
+	force_simd = simd;
+}
+
+/*-----------------------------------------------------------------------------
+ *  set_force_threads  --  sets the number of threads for the force
+ *                         calculation.  Small systems still run on one
+ *                         thread; see pair_task_count() in parallel.cpp.
+ *-----------------------------------------------------------------------------
+ */
+
+void set_force_threads(int nthreads){
+	set_thread_count(nthreads);
+}
+
+/*-----------------------------------------------------------------------------
+ *  get_acc_jrk_pot_coll_scalar  --  the reference implementation of
+ *                                   get_acc_jrk_pot_coll(), one pair at a
+ *                                   time on the array-of-structs layout.
+ *-----------------------------------------------------------------------------
+ */
+
+void get_acc_jrk_pot_coll_scalar(const real mass[], const real pos[][NDIM],
+								 const real vel[][NDIM], real acc[][NDIM],
+								 real jrk[][NDIM], real dst[], int n,
+								 real & epot, real & coll_time){
 
 	epot = 0;                         // potential energy
 	real coll_time_q = DBL_MAX;       // collision time estimate to 4th power (quartic)
 
-	for(int i = 0; i < n; i++){
+	int nm = massive_count(mass, n);
+	int w = dst_width(nm, n);
+
+	for(int i = 0; i < nm; i++){
 		for(int k = 0; k < NDIM; k++){
 			acc[i][k] = jrk[i][k] = 0;
 		}
 	}
 
-	int p = 0;
-	for(int i = 0; i < n; i++){
-		for(int j = i+1; j < n; j++, p++){
+	pair_rows(mass, pos, vel, acc, jrk, dst, nm, w, 0, nm,
+			  epot, coll_time_q);
+	test_rows(mass, pos, vel, acc, jrk, dst, n, nm, nm, n, coll_time_q);
+										  // from q for quartic back
+	coll_time = sqrt(sqrt(coll_time_q));  // to linear collision time
+}
+
+/*-----------------------------------------------------------------------------
+ *  pair_rows  --  the double {i,j} loop of get_acc_jrk_pot_coll_scalar() over
+ *                 the nm massive particles, restricted to the rows
+ *                 i0 <= i < i1 and all j > i.  The contributions are added
+ *                 to acc, jrk and epot, and coll_time_q is lowered to the
+ *                 smallest quartic estimate found, so that row blocks can be
+ *                 done separately.  Rows of dst[] are w long; see
+ *                 dst_width().
+ *-----------------------------------------------------------------------------
+ */
+
+void pair_rows(const real mass[], const real pos[][NDIM],
+			   const real vel[][NDIM], real acc[][NDIM], real jrk[][NDIM],
+			   real dst[], int nm, int w, int i0, int i1,
+			   real & epot, real & coll_time_q){
+
+	for(int i = i0; i < i1; i++){
+		int p = dst_row(i, w);            // index of pair {i, i+1} in dst
+		for(int j = i+1; j < nm; j++, p++){
 			real rji[NDIM];           // vector from particle i to particle j
 			real vji[NDIM];           // vji = d rji / d t
 
@@ -167,12 +382,368 @@ void get_acc_jrk_pot_coll(const real mass[], const real pos[][NDIM],
 			}
 
 			// second collision time estimate, based on free fall:
-			double mij = mass[i] + mass[j];  // add mass factors to finish calculating pairwise acceleration
+			real mij = mass[i] + mass[j];  // add mass factors to finish calculating pairwise acceleration
 			coll_est_q = G*r2/(da2*mij*mij); // masses already include a factor of G, so we cancel out the extra
 			if(coll_time_q > coll_est_q){
 				coll_time_q = coll_est_q;
 			}
 		}
-	}                                     // from q for quartic back
-	coll_time = sqrt(sqrt(coll_time_q));  // to linear collision time
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_rows  --  the forces on the test particles j0 <= j < j1, due to the
+ *                 nm massive particles.  The test particles have no effect
+ *                 on anything else, so each one is independent of the
+ *                 others.  When test particle distances are kept, this also
+ *                 fills in their entries of dst[], including those between
+ *                 two test particles.  Pairs with a test particle only lower
+ *                 coll_time_q if set_test_particles() asked for it.
+ *-----------------------------------------------------------------------------
+ */
+
+void test_rows(const real mass[], const real pos[][NDIM],
+			   const real vel[][NDIM], real acc[][NDIM], real jrk[][NDIM],
+			   real dst[], int n, int nm, int j0, int j1,
+			   real & coll_time_q){
+
+	for(int j = j0; j < j1; j++){
+		for(int k = 0; k < NDIM; k++){
+			acc[j][k] = jrk[j][k] = 0;
+		}
+
+		for(int i = 0; i < nm; i++){
+			real rji[NDIM], vji[NDIM];
+			real r2 = 0, v2 = 0, rv_r2 = 0;
+
+			for(int k = 0; k < NDIM; k++){
+				rji[k] = pos[j][k] - pos[i][k];
+				vji[k] = vel[j][k] - vel[i][k];
+
+				r2 += rji[k] * rji[k];
+				v2 += vji[k] * vji[k];
+				rv_r2 += rji[k] * vji[k];
+			}
+
+			rv_r2 /= r2;
+			real r = sqrt(r2);
+			real r3 = r * r2;
+
+			if(test_dst){ dst[dst_row(i, n) + j - i - 1] = r; }
+
+			real da2 = 0;
+			for(int k = 0; k < NDIM; k++){
+				real da = rji[k] / r3;
+				real dj = (vji[k] - 3 * rv_r2 * rji[k]) / r3;
+
+				da2 += da*da;
+
+				acc[j][k] -= mass[i] * da;
+				jrk[j][k] -= mass[i] * dj;
+			}
+
+			if(test_coll){
+				real coll_est_q = (r2*r2) / (v2*v2);
+				if(coll_time_q > coll_est_q){ coll_time_q = coll_est_q; }
+
+				coll_est_q = G*r2/(da2*mass[i]*mass[i]);
+				if(coll_time_q > coll_est_q){ coll_time_q = coll_est_q; }
+			}
+		}
+
+		if(test_dst){
+			int p = dst_row(j, n);
+			for(int l = j+1; l < n; l++, p++){
+				real r2 = 0;
+				for(int k = 0; k < NDIM; k++){
+					real d = pos[l][k] - pos[j][k];
+					r2 += d * d;
+				}
+				dst[p] = sqrt(r2);
+			}
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  get_acc_jrk_pot_coll_parallel  --  the scalar kernel spread over the
+ *                                     threads of the pool.
+ *
+ *  The symmetric updates of acc[j] and jrk[j] mean that two threads working
+ *  on different rows may touch the same particle, so every task accumulates
+ *  into private buffers.  Rows are split into blocks of equal pair counts
+ *  with balance_pair_rows(), and the private buffers are summed in task
+ *  order afterwards, again spread over the threads by particle.  For a fixed
+ *  number of threads the result is therefore always the same.
+ *-----------------------------------------------------------------------------
+ */
+
+void get_acc_jrk_pot_coll_parallel(const real mass[], const real pos[][NDIM],
+								   const real vel[][NDIM], real acc[][NDIM],
+								   real jrk[][NDIM], real dst[], int n,
+								   real & epot, real & coll_time){
+
+	static thread_local int cap = 0;                // per-task buffers,
+	static thread_local real (* acc_buf)[NDIM] = 0; // kept between calls
+	static thread_local real (* jrk_buf)[NDIM] = 0;
+
+	int nm = massive_count(mass, n);
+	int w = dst_width(nm, n);
+	int ntasks = pair_task_count(0.5*n*(n-1) - 0.5*(n-nm)*(n-nm-1));
+	if(cap < ntasks * nm){
+		delete[] acc_buf;
+		delete[] jrk_buf;
+		cap = ntasks * nm;
+		acc_buf = new real[cap][NDIM];
+		jrk_buf = new real[cap][NDIM];
+	}
+	real (* task_acc)[NDIM] = acc_buf;  // the tasks run on other threads,
+	real (* task_jrk)[NDIM] = jrk_buf;  // so hand them plain pointers
+
+	int *bounds = new int[ntasks + 1];
+	real *task_epot = new real[ntasks];
+	real *task_coll_q = new real[ntasks];
+	balance_pair_rows(nm, ntasks, bounds);
+
+	parallel_for(ntasks, [&](int t){
+		real (* a)[NDIM] = task_acc + t*nm;
+		real (* j)[NDIM] = task_jrk + t*nm;
+		for(int i = 0; i < nm; i++){
+			for(int k = 0; k < NDIM; k++){
+				a[i][k] = j[i][k] = 0;
+			}
+		}
+		task_epot[t] = 0;
+		task_coll_q[t] = DBL_MAX;
+		pair_rows(mass, pos, vel, a, j, dst, nm, w, bounds[t], bounds[t+1],
+				  task_epot[t], task_coll_q[t]);
+		int j1 = nm + (long long) (n - nm) * (t+1) / ntasks;
+		test_rows(mass, pos, vel, acc, jrk, dst, n, nm,
+				  nm + (long long) (n - nm) * t / ntasks, j1, task_coll_q[t]);
+	});
+
+	parallel_for(ntasks, [&](int t){
+		int i1 = (long long) nm * (t+1) / ntasks;
+		for(int i = (long long) nm * t / ntasks; i < i1; i++){
+			for(int k = 0; k < NDIM; k++){
+				acc[i][k] = jrk[i][k] = 0;
+			}
+			for(int s = 0; s < ntasks; s++){
+				for(int k = 0; k < NDIM; k++){
+					acc[i][k] += task_acc[s*nm + i][k];
+					jrk[i][k] += task_jrk[s*nm + i][k];
+				}
+			}
+		}
+	});
+
+	epot = 0;
+	real coll_time_q = DBL_MAX;
+	for(int t = 0; t < ntasks; t++){
+		epot += task_epot[t];
+		if(coll_time_q > task_coll_q[t]){ coll_time_q = task_coll_q[t]; }
+	}
+	coll_time = sqrt(sqrt(coll_time_q));
+
+	delete[] bounds;
+	delete[] task_epot;
+	delete[] task_coll_q;
+}
+
+/*-----------------------------------------------------------------------------
+ *  get_acc_jrk_coll_active  --  calculates accelerations and jerks for the
+ *                               particles listed in active[] only, due to all
+ *                               n particles, together with an individual
+ *                               collision time scale for each of them.
+ *
+ *  This is the force routine for the block time step scheme, where only the
+ *  particles whose steps end at the current block time need new forces.
+ *  Positions and velocities are the predicted values for all particles at
+ *  that time.  The pairwise collision time estimates are the same as in
+ *  get_acc_jrk_pot_coll(), but the minimum is taken per particle instead of
+ *  over the whole system.  Each active particle only writes its own values,
+ *  so the active list is simply split between the threads.  Only the nm
+ *  massive particles act as partners; test particles get their own time
+ *  scales from the massive ones, and never shorten those of anybody else.
+ *-----------------------------------------------------------------------------
+ */
+
+void get_acc_jrk_coll_active(const real mass[], const real pos[][NDIM],
+							 const real vel[][NDIM], real acc[][NDIM],
+							 real jrk[][NDIM], real coll_time[],
+							 const int active[], int nact, int n){
+
+	int nm = massive_count(mass, n);
+	int ntasks = pair_task_count((double) nact * nm);
+	parallel_for(ntasks, [&](int t){
+		int a1 = (long long) nact * (t+1) / ntasks;
+		for(int a = (long long) nact * t / ntasks; a < a1; a++){
+			int i = active[a];
+			real coll_time_q = DBL_MAX;
+
+			for(int k = 0; k < NDIM; k++){
+				acc[i][k] = jrk[i][k] = 0;
+			}
+
+			for(int j = 0; j < nm; j++){
+				if(j == i){ continue; }
+
+				real rji[NDIM];
+				real vji[NDIM];
+
+				real r2 = 0;
+				real v2 = 0;
+				real rv_r2 = 0;
+
+				for(int k = 0; k < NDIM; k++){
+					rji[k] = pos[j][k] - pos[i][k];
+					vji[k] = vel[j][k] - vel[i][k];
+
+					r2 += rji[k] * rji[k];
+					v2 += vji[k] * vji[k];
+					rv_r2 += rji[k] * vji[k];
+				}
+
+				rv_r2 /= r2;
+				real r = sqrt(r2);
+				real r3 = r * r2;
+
+				real da2 = 0;
+				for(int k = 0; k < NDIM; k++){
+					real da = rji[k] / r3;
+					real dj = (vji[k] - 3 * rv_r2 * rji[k]) / r3;
+
+					da2 += da*da;
+
+					acc[i][k] += mass[j] * da;
+					jrk[i][k] += mass[j] * dj;
+				}
+
+				real coll_est_q = (r2*r2) / (v2*v2);
+				if(coll_time_q > coll_est_q){
+					coll_time_q = coll_est_q;
+				}
+
+				real mij = mass[i] + mass[j];
+				coll_est_q = G*r2/(da2*mij*mij);
+				if(coll_time_q > coll_est_q){
+					coll_time_q = coll_est_q;
+				}
+			}
+
+			coll_time[i] = sqrt(sqrt(coll_time_q));
+		}
+	});
+}
+
+/*-----------------------------------------------------------------------------
+ *  get_pot_dst  --  calculates the potential energy and the pairwise distances
+ *                   for a system, without touching accelerations or jerks.
+ *                   Used wherever a consistent snapshot of the whole system is
+ *                   needed but no force evaluation is due, as at output times
+ *                   in the block time step scheme.  Test particles add
+ *                   nothing to the potential energy.
+ *-----------------------------------------------------------------------------
+ */
+
+void get_pot_dst(const real mass[], const real pos[][NDIM], real dst[],
+				 int n, real & epot){
+
+	epot = 0;
+
+	int nm = massive_count(mass, n);
+	int w = dst_width(nm, n);
+
+	for(int i = 0; i < w; i++){
+		int p = dst_row(i, w);
+		for(int j = i+1; j < w; j++, p++){
+			real r2 = 0;
+			for(int k = 0; k < NDIM; k++){
+				real d = pos[j][k] - pos[i][k];
+				r2 += d * d;
+			}
+			real r = sqrt(r2);
+			dst[p] = r;
+			if(j < nm){ epot -= mass[i] * mass[j] / r; }
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  get_dst  --  calculates the distances get_acc_jrk_pot_coll() writes to
+ *               dst[] (see dst_count()) for a system at arbitrary positions,
+ *               as needed for interpolated snapshots.
+ *-----------------------------------------------------------------------------
+ */
+
+void get_dst(const real mass[], const real pos[][NDIM], real dst[], int n){
+	int w = dst_width(massive_count(mass, n), n);
+
+	if(force_tree()){             // distances from particle 0 only
+		for(int i = 1; i < w; i++){
+			real r2 = 0;
+			for(int k = 0; k < NDIM; k++){
+				real d = pos[i][k] - pos[0][k];
+				r2 += d * d;
+			}
+			dst[i-1] = sqrt(r2);
+		}
+		return;
+	}
+
+	int p = 0;
+	for(int i = 0; i < w; i++){
+		for(int j = i+1; j < w; j++, p++){
+			real r2 = 0;
+			for(int k = 0; k < NDIM; k++){
+				real d = pos[j][k] - pos[i][k];
+				r2 += d * d;
+			}
+			dst[p] = sqrt(r2);
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  interpolate_step  --  positions and velocities at time tau into a Hermite
+ *                        step of size dt (0 <= tau <= dt), from the values
+ *                        at both ends of the step, without any new force
+ *                        evaluation.
+ *
+ *  Both ends give a quantity with its first two derivatives: position,
+ *  velocity and acceleration for the positions, and velocity, acceleration
+ *  and jerk for the velocities.  That fixes a polynomial of degree five,
+ *  which is evaluated in the usual quintic Hermite basis in s = tau/dt.
+ *  The interpolation error is well below the truncation error of the step.
+ *-----------------------------------------------------------------------------
+ */
+
+void interpolate_step(const real old_pos[][NDIM], const real old_vel[][NDIM],
+					  const real old_acc[][NDIM], const real old_jrk[][NDIM],
+					  const real pos[][NDIM], const real vel[][NDIM],
+					  const real acc[][NDIM], const real jrk[][NDIM],
+					  int n, real dt, real tau,
+					  real ipos[][NDIM], real ivel[][NDIM]){
+	real s = tau / dt;
+	real s2 = s*s, s3 = s2*s, s4 = s3*s, s5 = s4*s;
+
+	real h0 = 1 - 10*s3 + 15*s4 - 6*s5;         // value at the start
+	real h1 = (s - 6*s3 + 8*s4 - 3*s5) * dt;    // first derivative
+	real h2 = (s2 - 3*s3 + 3*s4 - s5) * dt*dt/2;  // second derivative
+	real h3 = 10*s3 - 15*s4 + 6*s5;             // value at the end
+	real h4 = (-4*s3 + 7*s4 - 3*s5) * dt;       // first derivative
+	real h5 = (s3 - 2*s4 + s5) * dt*dt/2;       // second derivative
+
+	for(int i = 0; i < n; i++){
+		for(int k = 0; k < NDIM; k++){
+			ipos[i][k] = h0*old_pos[i][k] + h1*old_vel[i][k]
+					   + h2*old_acc[i][k] + h3*pos[i][k]
+					   + h4*vel[i][k] + h5*acc[i][k];
+			ivel[i][k] = h0*old_vel[i][k] + h1*old_acc[i][k]
+					   + h2*old_jrk[i][k] + h3*vel[i][k]
+					   + h4*acc[i][k] + h5*jrk[i][k];
+		}
+	}
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,295 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>  // for copy_n()
+#include <cstring>
+#include "nbody.h"
+#include "nbodyio.h"
+#include "evolve.h"
+#include "state.h"
+#include "stop.h"
+#include "tree.h"
+#include "options.h"
+#include "library.h"
+
+using namespace std;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  library.cpp: the integrator as a library, behind the C API of solia.h
+ *               (see api.cpp), for programs that run it in process instead
+ *               of reading its snapshots back from text.
+ *
+ *     A library_system is the state of evolve() kept between calls: the
+ *     caller steps it to one time after another, looks at the particles in
+ *     between, or changes them.  The arrays handed out are the system's own
+ *     (solia_get_state()), so a caller such as the Python binding Solia.py
+ *     can wrap them without copying.  For that, the positions and
+ *     velocities between calls are always in the same buffers: the current
+ *     ones of particle_state alternate with the old ones from step to step,
+ *     so evolve() moves them back to the first at the end if need be.
+ *
+ *     Only the Hermite scheme with shared time steps is available, with the
+ *     force options of the command line (direct or tree code, vectorized,
+ *     threads, test particles) and the stop conditions.  The force options
+ *     are settings of the whole program, like everywhere else in nbody, and
+ *     each system applies its own when it steps; so several systems can
+ *     only be integrated at once, from different threads, when they use
+ *     the same ones.
+ *-----------------------------------------------------------------------------
+ */
+
+struct library_system {
+	options opt;              // dt_param, the force options, stop conditions
+	int n;
+	real t;
+	vector<real> mass;        // times G, as set_up_snapshot() left them
+	particle_state s;
+	real (*front_pos)[NDIM];  // where s.pos is between calls
+	vector<real> dst;         // distances, dst_count() of them
+	real epot, coll_time;     // from the forces of s.pos, if ready
+	real einit;               // total energy for the energy stop condition
+	bool ready;               // forces, dst and einit hold for s.pos, s.vel
+	long long nsteps;
+	stop_reason why;          // of the last evolve()
+
+	solia_callback callback;
+	void *user;
+	real dt_out;              // callback interval, 0 for none
+	real t_out;               // next callback time
+};
+
+/*-----------------------------------------------------------------------------
+ *  set_forces  --  applies the force options of sys, and makes room for
+ *                  the distances they call for.
+ *-----------------------------------------------------------------------------
+ */
+
+static void set_forces(library_system & sys){
+	const options & opt = sys.opt;
+	set_force_simd(opt.s_flag);
+	set_force_threads(opt.nthreads);
+	set_force_tree(opt.theta);
+	set_test_particles(!opt.D_flag, opt.P_flag);
+	size_t ndst = dst_count(sys.mass.data(), sys.n);
+	if(sys.dst.size() != ndst){
+		sys.dst.assign(ndst, 0);
+		sys.ready = false;    // the distances are not there yet
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  make_ready  --  computes the forces and the distances of the current
+ *                  positions, unless they are known.
+ *-----------------------------------------------------------------------------
+ */
+
+static void make_ready(library_system & sys){
+	set_forces(sys);
+	if(sys.ready){ return; }
+	particle_state & s = sys.s;
+	get_acc_jrk_pot_coll(sys.mass.data(), s.pos, s.vel, s.acc, s.jrk,
+						 sys.dst.data(), sys.n, sys.epot, sys.coll_time);
+	sys.einit = total_energy(sys.mass.data(), s.vel, sys.n, sys.epot);
+	sys.ready = true;
+}
+
+static void fill_state(const library_system & sys, solia_state & st){
+	st.n = sys.n;
+	st.ndim = NDIM;
+	st.real_size = sizeof(real);
+	st.ndst = sys.dst.size();
+	st.t = sys.t;
+	st.steps = sys.nsteps;
+	st.energy = total_energy(sys.mass.data(), sys.s.vel, sys.n, sys.epot) / G;
+	st.gm = sys.mass.data();
+	st.pos = sys.s.pos[0];
+	st.vel = sys.s.vel[0];
+	st.dst = sys.dst.data();
+	st.stop = sys.why.what;
+	st.stop_t = sys.why.t;
+	st.stop_i = sys.why.i;
+	st.stop_j = sys.why.j;
+	st.stop_value = sys.why.value;
+}
+
+/*-----------------------------------------------------------------------------
+ *  create  --  returns a new system of n particles, with masses in kg and
+ *              positions and velocities as in a snapshot, set up by
+ *              set_up_snapshot(); or 0, with the error reported, if they are
+ *              not valid.
+ *-----------------------------------------------------------------------------
+ */
+
+static void *create(int n, const double mass[], const double pos[],
+					const double vel[], double t){
+	if(n < 1){
+		cerr << "solia_create: no particles" << endl;
+		return 0;
+	}
+	library_system *sys = new library_system();
+	sys->n = n;
+	sys->t = t;
+	sys->mass.assign(mass, mass + n);
+	sys->s.reserve(n);
+	sys->front_pos = sys->s.pos;
+	copy_n(pos, n * NDIM, sys->s.pos[0]);
+	copy_n(vel, n * NDIM, sys->s.vel[0]);
+	if(!set_up_snapshot(sys->mass.data(), sys->s.pos, sys->s.vel, n)){
+		delete sys;
+		return 0;
+	}
+	sys->epot = sys->coll_time = sys->einit = 0;
+	sys->ready = false;
+	sys->nsteps = 0;
+	sys->callback = 0;
+	sys->user = 0;
+	sys->dt_out = sys->t_out = 0;
+	return sys;
+}
+
+static void destroy(void *p){
+	delete (library_system *) p;
+}
+
+/*-----------------------------------------------------------------------------
+ *  set_option  --  sets one of the options of the command line, by the
+ *                  name of its field in options.h.  Returns 0, or -1 for an
+ *                  unknown name.
+ *-----------------------------------------------------------------------------
+ */
+
+static int set_option(void *p, const char *name, double value){
+	library_system & sys = *(library_system *) p;
+	options & opt = sys.opt;
+	double *real_fields[] = {&opt.dt_param, &opt.theta, &opt.stop_dist,
+							 &opt.esc_dist, &opt.hill_factor, &opt.max_derr};
+	const char *real_names[] = {"dt_param", "theta", "stop_dist",
+								"esc_dist", "hill_factor", "max_derr"};
+	bool *flag_fields[] = {&opt.s_flag, &opt.D_flag, &opt.P_flag};
+	const char *flag_names[] = {"s_flag", "D_flag", "P_flag"};
+
+	for(int f = 0; f < 6; f++){
+		if(strcmp(name, real_names[f]) == 0){
+			*real_fields[f] = value;
+			return 0;
+		}
+	}
+	for(int f = 0; f < 3; f++){
+		if(strcmp(name, flag_names[f]) == 0){
+			*flag_fields[f] = value != 0;
+			sys.ready = false;    // forces of test particles change
+			return 0;
+		}
+	}
+	if(strcmp(name, "nthreads") == 0){
+		opt.nthreads = (int) value;
+		return 0;
+	}
+	cerr << "solia_set_option: unknown option " << name << endl;
+	return -1;
+}
+
+/*-----------------------------------------------------------------------------
+ *  set_callback  --  calls cb at the first step at or after each dt_out of
+ *                    time from now on, or never if cb is 0.
+ *-----------------------------------------------------------------------------
+ */
+
+static void set_callback(void *p, solia_callback cb, void *user,
+						 double dt_out){
+	library_system & sys = *(library_system *) p;
+	sys.callback = dt_out > 0 ? cb : 0;
+	sys.user = user;
+	sys.dt_out = dt_out;
+	sys.t_out = sys.t + dt_out;
+}
+
+/*-----------------------------------------------------------------------------
+ *  evolve  --  integrates the system up to time t_end, as evolve() in
+ *              nbody.cpp does without output but the callback.  Returns 0
+ *              at t_end, 1 for a stop condition, 2 if the callback asked
+ *              to stop, or -1 for options that do not go together.
+ *-----------------------------------------------------------------------------
+ */
+
+static int evolve(void *p, double t_end){
+	library_system & sys = *(library_system *) p;
+	const options & opt = sys.opt;
+	if(opt.theta > 0 && (opt.stop_dist > 0 || opt.hill_factor > 0)){
+		cerr << "solia_evolve: the stop_dist and hill_factor stop conditions"
+			 << " need all distances, so not the tree code" << endl;
+		return -1;
+	}
+	make_ready(sys);
+	sys.why = stop_reason();
+
+	const real *mass = sys.mass.data();
+	particle_state & s = sys.s;
+	real *dst = sys.dst.data();
+	int n = sys.n;
+	bool checking = stop_checks(opt);
+	int result = 0;
+
+	while(sys.t < t_end){
+		real dt = opt.dt_param * sys.coll_time;
+		evolve_step(mass, s, dst, n, dt, sys.epot, sys.coll_time);
+		sys.t += dt;
+		sys.nsteps++;
+		if(checking && check_stop(mass, s.pos, s.vel, dst, n, sys.t,
+								  sys.epot, sys.einit, opt, sys.why)){
+			result = 1;
+			break;
+		}
+		if(sys.callback && sys.t >= sys.t_out){
+			do{ sys.t_out += sys.dt_out; } while(sys.t_out < sys.t);
+			solia_state st;
+			fill_state(sys, st);
+			if(sys.callback(sys.user, &st) != 0){
+				result = 2;
+				break;
+			}
+		}
+	}
+
+	if(s.pos != sys.front_pos){   // back to the buffers handed out before
+		int nv = n * NDIM;
+		copy_n(s.pos[0], nv, s.old_pos[0]);
+		copy_n(s.vel[0], nv, s.old_vel[0]);
+		copy_n(s.acc[0], nv, s.old_acc[0]);
+		copy_n(s.jrk[0], nv, s.old_jrk[0]);
+		s.swap();
+	}
+	return result;
+}
+
+/*-----------------------------------------------------------------------------
+ *  modified  --  to be called after the caller has changed the positions or
+ *                velocities: the forces are computed anew before the next
+ *                step, and the energy error counts from there.
+ *-----------------------------------------------------------------------------
+ */
+
+static void modified(void *p){
+	((library_system *) p)->ready = false;
+}
+
+static void get_state(void *p, solia_state *st){
+	library_system & sys = *(library_system *) p;
+	make_ready(sys);
+	fill_state(sys, *st);
+}
+
+/*-----------------------------------------------------------------------------
+ *  library_functions  --  returns the functions of this variant for api.cpp.
+ *-----------------------------------------------------------------------------
+ */
+
+const library_api & library_functions(){
+	static const library_api api = {create, destroy, set_option,
+									set_callback, evolve, modified,
+									get_state};
+	return api;
+}
+
+}
@@ -0,0 +1,283 @@
+/*=============================================================================
+ *
+ *  main.cpp: the entry point of nbody, which picks one of the variants of
+ *            the integrator compiled into the program (see nbody.h) and
+ *            hands it the options read from the command line.
+ *
+ *     The number of dimensions is given with -n, or else taken from the
+ *     binary snapshot file given with -I, or else 2.  -L selects the long
+ *     double variants, for very long runs where the rounding errors of
+ *     double would dominate the energy error.  A checkpoint file given
+ *     with -I (see checkpoint.cpp) sets both, as the run that wrote it had
+ *     them.
+ *=============================================================================
+ */
+
+#include <iostream>
+#include <cstdlib>    // for atoi() and atof()
+#include <unistd.h>   // for getopt()
+#include "options.h"
+
+using namespace std;
+
+namespace d2 {
+	int run(const options & opt, const char *prog);
+	int snap_file_ndim(const char *name);
+	int checkpoint_ndim(const char *name, bool & long_double);
+}
+namespace d3 { int run(const options & opt, const char *prog); }
+namespace l2 { int run(const options & opt, const char *prog); }
+namespace l3 { int run(const options & opt, const char *prog); }
+
+bool read_options(int argc, char *argv[], options & opt);
+
+/*-----------------------------------------------------------------------------
+ *  main  --  reads options, and runs the variant of the integrator that
+ *            they call for
+ *-----------------------------------------------------------------------------
+ */
+
+int main(int argc, char *argv[]){
+	options opt;                 // run parameters, see options.h
+
+	if(!read_options(argc, argv, opt)){
+		return 1;                // halt criterion detected by read_options()
+	}
+
+	if(opt.L_flag){
+		return opt.ndim == 3 ? l3::run(opt, argv[0]) : l2::run(opt, argv[0]);
+	}
+	return opt.ndim == 3 ? d3::run(opt, argv[0]) : d2::run(opt, argv[0]);
+}
+
+/*-----------------------------------------------------------------------------
+ *  read_options  --  reads the command line options.
+ *  note: when the help option -h is invoked, or an unknown option encountered,
+ *        the return value is set to false to prevent further execution.
+ *-----------------------------------------------------------------------------
+ */
+
+bool read_options(int argc, char *argv[], options & opt){
+	int c;
+	while((c = getopt(argc, argv, "ha:bB:c:C:d:DeE:H:I:j:K:Lm:n:N:o:O:p:Pq:r:R:sS:t:T:VW:xY:Z:")) != -1){
+		switch(c){
+			case 'a': opt.dt_param = atof(optarg);
+					  break;
+			case 'd': opt.dt_dia = atof(optarg);
+					  break;
+			case 'o': opt.dt_out = atof(optarg);
+					  break;
+			case 't': opt.dt_tot = atof(optarg);
+					  break;
+			case 'x': opt.x_flag = true;
+					  break;
+			case 'b': opt.b_flag = true;
+					  break;
+			case 'N': opt.nb_count = atoi(optarg);
+					  break;
+			case 's': opt.s_flag = true;
+					  break;
+			case 'j': opt.nthreads = atoi(optarg);
+					  break;
+			case 'B': opt.theta = atof(optarg);
+					  break;
+			case 'D': opt.D_flag = true;
+					  break;
+			case 'P': opt.P_flag = true;
+					  break;
+			case 'I': opt.in_file = optarg;
+					  break;
+			case 'O': opt.out_file = optarg;
+					  break;
+			case 'q': opt.queue_depth = atoi(optarg);
+					  break;
+			case 'e': opt.e_flag = true;
+					  break;
+			case 'E': opt.ensemble = optarg;
+					  break;
+			case 'V': opt.V_flag = true;
+					  break;
+			case 'c': opt.stop_dist = atof(optarg);
+					  break;
+			case 'r': opt.esc_dist = atof(optarg);
+					  break;
+			case 'H': opt.hill_factor = atof(optarg);
+					  break;
+			case 'm': opt.max_derr = atof(optarg);
+					  break;
+			case 'W': opt.wh_frac = atof(optarg);
+					  break;
+			case 'R': opt.r_reg = atof(optarg);
+					  break;
+			case 'n': opt.ndim = atoi(optarg);
+					  break;
+			case 'L': opt.L_flag = true;
+					  break;
+			case 'p': opt.profile = optarg;
+					  break;
+			case 'S': opt.dt_sum = atof(optarg);
+					  break;
+			case 'Z': opt.z_bound = atof(optarg);
+					  break;
+			case 'C': opt.checkpoint = optarg;
+					  break;
+			case 'K': opt.ck_interval = atof(optarg);
+					  break;
+			case 'T': opt.slices = atoi(optarg);
+					  break;
+			case 'Y': opt.pr_tol = atof(optarg);
+					  break;
+			case 'h': // fallthrough
+			case '?': cerr << "usage: " << argv[0]
+						   << " [-h (for help)]"
+						   << " [-a step size control parameter]\n"
+						   << "         [-d diagnostics interval]"
+						   << " [-o output interval]\n"
+						   << "         [-t total duration]"
+						   << " [-x (extra debugging diagnostics)]\n"
+						   << "         [-b (individual block time steps)]"
+						   << " [-s (vectorized force kernel)]\n"
+						   << "         [-N neighbors per particle, with -b]\n"
+						   << "         [-j number of threads]"
+						   << " [-B tree code opening angle]\n"
+						   << "         [-D (no test particle distances)]"
+						   << " [-P (test particles limit time step)]\n"
+						   << "         [-I binary snapshot file to restart from]"
+						   << " [-O binary snapshot output file]\n"
+						   << "         [-q output queue depth (0: synchronous)]"
+						   << " [-e (exact output times)]\n"
+						   << "         [-E output prefix for an ensemble of systems]"
+						   << " [-V (batch it in vector lanes)]\n"
+						   << "         [-c stop below this separation]"
+						   << " [-r stop on escape beyond this radius]\n"
+						   << "         [-H stop within this many Hill radii]"
+						   << " [-m stop beyond this energy error]\n"
+						   << "         [-W Wisdom-Holman step, in orbital periods]"
+						   << " [-R close encounter regularization radius]\n"
+						   << "         [-n number of dimensions (2 or 3)]"
+						   << " [-L (long double precision)]\n"
+						   << "         [-p profile output file (- for stderr)]"
+						   << " [-S distance summary interval]\n"
+						   << "         [-Z compress -O output, to this relative"
+						   << " error (0: lossless)]\n"
+						   << "         [-C checkpoint file]"
+						   << " [-K checkpoint interval in s of wall time]\n"
+						   << "         [-T parareal time slices]"
+						   << " [-Y parareal tolerance]"
+						   << endl;
+					  return false; // execution should stop after help or error
+			}
+	}
+
+	if(opt.b_flag && opt.theta > 0){
+		cerr << argv[0] << ": block time steps (-b) cannot be combined"
+			 << " with the tree code (-B)" << endl;
+		return false;
+	}
+	if(opt.nb_count < 0 || (opt.nb_count > 0 && !opt.b_flag)){
+		cerr << argv[0] << ": the neighbor scheme (-N) needs a positive"
+			 << " number of neighbors, and block time steps (-b)" << endl;
+		return false;
+	}
+	if(opt.wh_frac > 0 && (opt.b_flag || opt.theta > 0)){
+		cerr << argv[0] << ": the Wisdom-Holman scheme (-W) cannot be"
+			 << " combined with block time steps (-b) or the tree code (-B)"
+			 << endl;
+		return false;
+	}
+	if(opt.r_reg > 0 && (opt.b_flag || opt.theta > 0 || opt.wh_frac > 0
+						 || opt.e_flag)){
+		cerr << argv[0] << ": close encounter regularization (-R) only works"
+			 << " with the default global time step scheme, without -b, -B,"
+			 << " -W or -e" << endl;
+		return false;
+	}
+	if(opt.theta > 0 && (opt.stop_dist > 0 || opt.hill_factor > 0)){
+		cerr << argv[0] << ": the collision (-c) and Hill radius (-H) stop"
+			 << " conditions need all pairwise distances, which the tree"
+			 << " code (-B) does not compute" << endl;
+		return false;
+	}
+	if(opt.z_bound >= 0 && !opt.out_file){
+		cerr << argv[0] << ": compression (-Z) is for binary snapshot"
+			 << " output (-O)" << endl;
+		return false;
+	}
+	if(opt.dt_sum > 0 && (opt.b_flag || opt.wh_frac > 0)){
+		cerr << argv[0] << ": distance summaries (-S) only work with the"
+			 << " global time step Hermite scheme, without -b or -W" << endl;
+		return false;
+	}
+	if(opt.profile && (opt.b_flag || opt.wh_frac > 0)){
+		cerr << argv[0] << ": profiling (-p) only works with the global"
+			 << " time step Hermite scheme, without -b or -W" << endl;
+		return false;
+	}
+#ifndef NBODY_PROFILE
+	if(opt.profile){
+		cerr << argv[0] << ": built without profiling (-p);"
+			 << " rebuild with make clean; make PROFILE=1" << endl;
+		return false;
+	}
+#endif
+	if(opt.V_flag && (!opt.ensemble || opt.b_flag || opt.theta > 0
+					  || opt.wh_frac > 0 || opt.r_reg > 0 || opt.e_flag
+					  || opt.dt_sum > 0 || opt.profile)){
+		cerr << argv[0] << ": batches (-V) are for ensembles (-E) with the"
+			 << " global time step Hermite scheme, without -b, -B, -W, -R,"
+			 << " -e, -S or -p" << endl;
+		return false;
+	}
+	if(opt.slices < 0 || (opt.slices > 0
+		&& (opt.b_flag || opt.wh_frac > 0 || opt.r_reg > 0 || opt.e_flag
+			|| opt.dt_sum > 0 || opt.profile || opt.ensemble
+			|| opt.checkpoint || opt.stop_dist > 0 || opt.esc_dist > 0
+			|| opt.hill_factor > 0 || opt.max_derr > 0))){
+		cerr << argv[0] << ": parareal (-T) needs a positive number of"
+			 << " slices, and only works with the global time step Hermite"
+			 << " scheme, without -b, -W, -R, -e, -S, -p, -E, -C or stop"
+			 << " conditions" << endl;
+		return false;
+	}
+	if(opt.ensemble && opt.in_file){
+		cerr << argv[0] << ": an ensemble (-E) is read from stdin,"
+			 << " not from a binary file (-I)" << endl;
+		return false;
+	}
+	bool ld;
+	int ck_ndim = opt.in_file ? d2::checkpoint_ndim(opt.in_file, ld) : 0;
+	if((opt.checkpoint || ck_ndim > 0)
+	   && (opt.b_flag || opt.wh_frac > 0 || opt.r_reg > 0 || opt.ensemble
+		   || opt.slices > 0)){
+		cerr << argv[0] << ": checkpoints (-C, or -I from one) only work"
+			 << " with the global time step Hermite scheme, without -b, -W,"
+			 << " -R, -E or -T" << endl;
+		return false;
+	}
+	if(ck_ndim > 0){             // the checkpoint sets the variant
+		if((opt.ndim != 0 && opt.ndim != ck_ndim) || (opt.L_flag && !ld)){
+			cerr << argv[0] << ": " << opt.in_file << " is a checkpoint of"
+				 << " a " << ck_ndim << "-dimensional run in "
+				 << (ld ? "long double" : "double") << " precision" << endl;
+			return false;
+		}
+		opt.ndim = ck_ndim;
+		opt.L_flag = ld;
+	}
+
+	if(opt.ndim == 0){           // from the file to restart from, if any
+		opt.ndim = opt.in_file ? d2::snap_file_ndim(opt.in_file) : 2;
+		if(opt.ndim == 0){
+			cerr << argv[0] << ": " << opt.in_file
+				 << " is not a binary snapshot file" << endl;
+			return false;
+		}
+	}
+	if(opt.ndim != 2 && opt.ndim != 3){
+		cerr << argv[0] << ": " << opt.ndim << " dimensions are not"
+			 << " supported, only 2 or 3 (-n)" << endl;
+		return false;
+	}
+
+	return true; // continue program execution
+}
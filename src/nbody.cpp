@@ -2,6 +2,10 @@
  *
  *  nbody.cpp: an N-body integrator with a variable global time step,
  *             using the Hermite integration scheme.
+ *             Block time steps (block.cpp) and a Wisdom-Holman scheme for
+ *             planetary systems (wh.cpp) are available as alternatives,
+ *             and long runs can be split into time slices integrated in
+ *             parallel (parareal.cpp).
  *
  *           ref.: Hut, P., Makino, J. & McMillan, S., 1995,
  *                  Astrophysical Journal Letters 443, L93-L96.
@@ -27,111 +31,540 @@
  *     pairs of particles, included for convenience, so that graphing software
  *     need not spend time recalculating it.
  *
+ *     With -O, snapshots are written to a binary file instead, which is much
+ *     faster for long runs, and -I restarts from the last snapshot in such a
+ *     file; see snapfile.cpp for the format, and snapconv for conversion
+ *     to and from text.
+ *
+ *     With -E, the input is instead any number of such snapshots one after
+ *     the other, each an independent system; see run_ensemble().
+ *
  *  Internal data format:
  *
  *     The data for an N-body system is stored internally as a 1-dimensional
  *     array for the masses, and 2-dimensional arrays for the positions,
- *     velocities, accelerations and jrks of all particles.
+ *     velocities, accelerations and jrks of all particles.  The Hermite
+ *     scheme keeps those, with their values at the start of the step, in a
+ *     particle_state (see state.cpp).
  */
 
 #include <iostream>
-#include <cstdlib>    // for atoi() and atof()
-#include <unistd.h>   // for getopt()
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstring>    // for strcmp()
 #include "nbody.h"
 #include "nbodyio.h"
 #include "evolve.h"
+#include "state.h"
+#include "profile.h"
+#include "summary.h"
+#include "checkpoint.h"
+#include "batch.h"
+#include "block.h"
+#include "simd.h"
+#include "parallel.h"
+#include "tree.h"
+#include "snapfile.h"
+#include "writer.h"
+#include "stop.h"
+#include "wh.h"
+#include "encounter.h"
+#include "parareal.h"
+#include "options.h"
 
 using namespace std;
 
-void evolve(const real mass[], real pos[][NDIM], real vel[][NDIM], real dst[],
-			int n, real t, real dt_param, real dt_dia, real dt_out, real dt_tot,
-			bool x_flag);
+namespace NBODY_VARIANT {
+
+stop_reason evolve(const real mass[], real pos[][NDIM], real vel[][NDIM],
+				   real dst[], int n, real t, const options & opt,
+				   const checkpoint *from);
 
-bool read_options(int argc, char *argv[], real & dt_param, real & dt_dia,
-				  real & dt_out, real & dt_tot, bool & x_flag);
+bool integrate(const real mass[], real pos[][NDIM], real vel[][NDIM],
+			   real dst[], int n, real t, const options & opt,
+			   stop_reason & why, const checkpoint *from = 0);
+
+bool run_ensemble(const options & opt);
 
 /*-----------------------------------------------------------------------------
- *  main  --  reads options, reads a snapshot, and launches the integrator
+ *  run  --  reads a snapshot and launches the integrator, for the options
+ *           read by main() (see main.cpp), which picked this variant.
+ *           A checkpoint given with -I brings back the state of the run
+ *           that wrote it, and the settings that run was started with.
  *-----------------------------------------------------------------------------
  */
 
-int main(int argc, char *argv[]){
-	real  dt_param = 0.03;     // control parameter to determine time step size
-	real  dt_dia = 0;          // time interval between diagnostics output
-	real  dt_out = 60;         // time interval between output of snapshots
-	real  dt_tot = 3600;       // duration of the integration; default 1 hour
-	bool  x_flag = false;      // if true: extra debugging diagnostics output
+int run(const options & cmd_opt, const char *prog){
+	options opt = cmd_opt;
+	checkpoint ck;               // the run to resume, if any
+	bool ld;
+	bool resume = opt.in_file && checkpoint_ndim(opt.in_file, ld) > 0;
+	if(resume && !read_checkpoint(opt.in_file, ck, opt)){
+		return 1;
+	}
 
-	if(!read_options(argc, argv, dt_param, dt_dia, dt_out, dt_tot, x_flag)){
-		return 1;                // halt criterion detected by read_options()
+	set_force_simd(opt.s_flag);
+	set_force_threads(opt.ensemble || opt.slices > 0 ? 1 : opt.nthreads);
+	set_force_tree(opt.theta);
+	set_test_particles(!opt.D_flag, opt.P_flag);
+
+	if(opt.ensemble){            // -j threads go to whole systems instead
+		return run_ensemble(opt) ? 0 : 1;
 	}
 
 	int n;                       // number of particles in the N-body system
-	cin >> n;
-
 	real t;                      // time
-	cin >> t;
+
+	snap_reader in;              // binary input, if any, see snapfile.cpp
+	if(resume){
+		n = ck.n;
+		t = ck.t;
+	}else if(opt.in_file){
+		if(!open_snap_reader(opt.in_file, in)){ return 1; }
+		if(in.nrec == 0){
+			cerr << prog << ": no snapshots in " << opt.in_file << endl;
+			return 1;
+		}
+		n = in.head.n;
+	}else{
+		cin >> n;
+		cin >> t;
+	}
 
 	real *mass = new real[n];                  // masses for all particles
 	real (*pos)[NDIM] = new real[n][NDIM];     // positions for all particles
 	real (*vel)[NDIM] = new real[n][NDIM];     // velocities for all particles
-	real (*dst) = new real[n*(n-1)/2];         // distances between all particle pairs
 
-	get_snapshot(mass, pos, vel, n);
+	if(resume){                  // as they were, not recentred
+		copy_n(ck.mass.data(), n, mass);
+		copy_n(ck.pos.data(), n * NDIM, pos[0]);
+		copy_n(ck.vel.data(), n * NDIM, vel[0]);
+	}else if(opt.in_file){       // restart from the last binary snapshot
+		bool ok = read_snap_record(in, in.nrec - 1, t, mass, pos, vel, 0);
+		close_snap_reader(in);
+		if(!ok || !set_up_snapshot(mass, pos, vel, n)){
+			return 1;
+		}
+	}else if(!get_snapshot(mass, pos, vel, n)){
+		return 1;                // invalid input, reported by get_snapshot()
+	}
+
+	real (*dst) = new real[dst_count(mass, n)];      // distances between particles, see dst_count()
+
+	snap_writer bin;             // binary output, if any
+	if(opt.out_file){
+		if(!open_snap_writer(opt.out_file, n, dst_count(mass, n), bin,
+							 opt.z_bound)){
+			return 1;
+		}
+		get_output()->bin = &bin;
+	}
+	ofstream prof;               // profile, if any
+	if(opt.profile){
+		if(strcmp(opt.profile, "-") == 0){
+			get_output()->prof = &cerr;
+		}else{
+			prof.open(opt.profile);
+			if(!prof){
+				cerr << prog << ": cannot create " << opt.profile << endl;
+				return 1;
+			}
+			get_output()->prof = &prof;
+		}
+	}
+	if(opt.dt_sum > 0){          // summaries take the place of text
+		get_output()->snap = 0;  // snapshots on stdout
+		get_output()->sum = &cout;
+	}
+	start_writer(opt.queue_depth);
+	if(opt.checkpoint){ catch_stop_signals(); }
 
-	cerr << "Starting a Hermite integration for a " << n
-		 << "-body system,\n  from time t = " << t
-		 << " with time step control parameter dt_param = " << dt_param
-		 << "  until time " << t + dt_tot
+	cerr << (resume ? "Resuming a " : "Starting a ") << (opt.b_flag ? "block time step " : "")
+		 << (opt.wh_frac > 0 ? "Wisdom-Holman" : "Hermite")
+		 << " integration for a " << n
+		 << "-body system,\n  from time t = " << t;
+	if(opt.wh_frac > 0){
+		cerr << " with time steps of " << opt.wh_frac
+			 << " times the shortest orbital period";
+	}else{
+		cerr << " with time step control parameter dt_param = "
+			 << opt.dt_param;
+	}
+	cerr << "  until time " << t + opt.dt_tot
 		 << " ,\n  with diagnostics output interval dt_dia = "
-		 << dt_dia << ",\n  and snapshot output interval dt_out = "
-		 << dt_out << "." << endl;
+		 << opt.dt_dia << ",\n  and snapshot output interval dt_out = "
+		 << opt.dt_out << "." << endl;
+	int nm = massive_count(mass, n);
+	if(nm < n){
+		cerr << "  " << n - nm << " of the particles are massless test particles."
+			 << endl;
+	}
+	if(opt.theta > 0){
+		cerr << "  Using the tree code with opening angle theta = "
+			 << opt.theta << "." << endl;
+	}else if(opt.s_flag){
+		cerr << "  Using the " << simd_kernel_name()
+			 << " force kernel." << endl;
+	}
+	if(opt.slices > 0){
+		cerr << "  Parallel in time, in " << opt.slices << " slices on "
+			 << opt.nthreads << " threads, to a tolerance of "
+			 << opt.pr_tol << "." << endl;
+	}else if(opt.nthreads > 1){
+		cerr << "  Using " << opt.nthreads
+			 << " threads for the force calculation." << endl;
+	}
 
-	evolve(mass, pos, vel, dst, n, t,
-		   dt_param, dt_dia, dt_out, dt_tot, x_flag);
+	stop_reason why;
+	bool ok = integrate(mass, pos, vel, dst, n, t, opt, why,
+						resume ? &ck : 0);
+	stop_writer();
+	close_snap_writer(bin);
+	if(why.what){
+		write_stop(why, cerr);
+	}
 
 	delete[] mass;
 	delete[] pos;
 	delete[] vel;
 	delete[] dst;
+	return ok ? 0 : 1;
+}
+
+/*-----------------------------------------------------------------------------
+ *  integrate  --  integrates a system with the scheme chosen in opt, and
+ *                 returns the reason for an early stop in why.  Returns
+ *                 false if the system does not suit the scheme.
+ *-----------------------------------------------------------------------------
+ */
+
+bool integrate(const real mass[], real pos[][NDIM], real vel[][NDIM],
+			   real dst[], int n, real t, const options & opt,
+			   stop_reason & why, const checkpoint *from){
+	if(opt.wh_frac > 0){
+		real dt = wh_time_step(mass, pos, vel, n, opt.wh_frac);
+		if(dt == 0){ return false; }
+		why = evolve_wh(mass, pos, vel, dst, n, t, dt, opt);
+	}else if(opt.b_flag){
+		why = evolve_block(mass, pos, vel, dst, n, t, opt);
+	}else if(opt.slices > 0){
+		why = evolve_parareal(mass, pos, vel, dst, n, t, opt);
+	}else{
+		why = evolve(mass, pos, vel, dst, n, t, opt, from);
+	}
+	return true;
 }
 
 /*-----------------------------------------------------------------------------
- *  read_options  --  reads the command line options.
- *  note: when the help option -h is invoked, or an unknown option encountered,
- *        the return value is set to false to prevent further execution.
+ *  ensemble_system  --  one system of an ensemble run, with its results.
  *-----------------------------------------------------------------------------
  */
 
-bool read_options(int argc, char *argv[], real & dt_param, real & dt_dia,
-				  real & dt_out, real & dt_tot, bool & x_flag){
-	int c;
-	while((c = getopt(argc, argv, "ha:e:o:t:x")) != -1){
-		switch(c){
-			case 'a': dt_param = atof(optarg);
-					  break;
-			case 'd': dt_dia = atof(optarg);
-					  break;
-			case 'o': dt_out = atof(optarg);
-					  break;
-			case 't': dt_tot = atof(optarg);
-					  break;
-			case 'x': x_flag = true;
-					  break;
-			case 'h': // fallthrough
-			case '?': cerr << "usage: " << argv[0]
-						   << " [-h (for help)]"
-						   << " [-a step size control parameter]\n"
-						   << "         [-d diagnostics interval]"
-						   << " [-o output interval]\n"
-						   << "         [-t total duration]"
-						   << " [-x (extra debugging diagnostics)]"
-						   << endl;
-					  return false; // execution should stop after help or error
+struct ensemble_system {
+	int n;
+	real t;
+	real *mass;
+	real (*pos)[NDIM];
+	real (*vel)[NDIM];
+	bool ok;                  // output files opened, and the system suits
+							  // the integration scheme
+	stop_reason why;          // why the integration stopped early, if it did
+	double wall;              // wall clock time of the integration in s
+	real einit, etot;         // total energy at the start and at the end
+};
+
+/*-----------------------------------------------------------------------------
+ *  is_header  --  returns true if an input line looks like the first line of
+ *                 a snapshot, "n t", rather than a line of distances.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool is_header(const string & line){
+	istringstream in(line);
+	string n, t, rest;
+	if(!(in >> n >> t) || in >> rest){ return false; }
+	return n.find_first_not_of("0123456789") == string::npos;
+}
+
+/*-----------------------------------------------------------------------------
+ *  read_ensemble  --  reads snapshots from cin until the end of the input,
+ *                     skipping the distance line that follows each snapshot
+ *                     written by put_snapshot(), if present.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool read_ensemble(vector<ensemble_system> & systems){
+	string line;
+	bool have_header = false;     // line already holds the next header
+	for(;;){
+		if(!have_header && !getline(cin, line)){ break; }
+		have_header = false;
+		if(line.find_first_not_of(" \t\r") == string::npos){ continue; }
+
+		ensemble_system s;
+		istringstream header(line);
+		if(!(header >> s.n >> s.t) || s.n < 1){
+			cerr << "read_ensemble: bad snapshot header \"" << line
+				 << "\" for system " << systems.size() << endl;
+			return false;
+		}
+		s.mass = new real[s.n];
+		s.pos = new real[s.n][NDIM];
+		s.vel = new real[s.n][NDIM];
+		systems.push_back(s);
+		if(!get_snapshot(s.mass, s.pos, s.vel, s.n)){
+			cerr << "read_ensemble: in system " << systems.size() - 1 << endl;
+			return false;
+		}
+
+		getline(cin, line);       // rest of the last particle line
+		while(getline(cin, line)){
+			if(is_header(line)){
+				have_header = true;
+				break;
 			}
+		}
 	}
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *  system_output  --  the output files of one system of an ensemble.
+ *-----------------------------------------------------------------------------
+ */
+
+struct system_output {
+	ofstream dia, snap, sum, prof;
+	snap_writer bin;
+	output_target to;
+	chrono::steady_clock::time_point start;
+};
 
-	return true; // continue program execution
+/*-----------------------------------------------------------------------------
+ *  open_system  --  opens the output files of system k of an ensemble: its
+ *                   snapshots in prefix-k.txt (or, with -O, in the binary
+ *                   file out-k.snap) and its diagnostics in prefix-k.dia.
+ *                   With -S, the summaries go to prefix-k.sum, and there is
+ *                   no text file.  Sets s.ok, and returns it.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool open_system(ensemble_system & s, int k, const options & opt,
+						system_output & out){
+	string name = string(opt.ensemble) + "-" + to_string(k);
+	output_target & to = out.to;
+	out.dia.open(name + ".dia");
+	to.dia = &out.dia;
+	to.snap = &out.snap;
+	if(opt.profile){
+		out.prof.open(name + ".prof");
+		to.prof = &out.prof;
+	}
+
+	s.ok = bool(out.dia);
+	if(opt.out_file){
+		string bin_name = string(opt.out_file) + "-" + to_string(k) + ".snap";
+		s.ok = s.ok && open_snap_writer(bin_name.c_str(), s.n,
+										dst_count(s.mass, s.n), out.bin,
+										opt.z_bound);
+		to.bin = &out.bin;
+	}
+	if(opt.dt_sum > 0){
+		out.sum.open(name + ".sum");
+		s.ok = s.ok && out.sum;
+		to.snap = 0;
+		to.sum = &out.sum;
+	}else if(!opt.out_file){
+		out.snap.open(name + ".txt");
+		s.ok = s.ok && out.snap;
+	}
+
+	out.start = chrono::steady_clock::now();
+	if(!s.ok){
+		cerr << "run_system: cannot create the output files for system "
+			 << k << endl;
+	}
+	return s.ok;
+}
+
+/*-----------------------------------------------------------------------------
+ *  close_system  --  finishes the output of a system opened with
+ *                    open_system(), and records its results.
+ *-----------------------------------------------------------------------------
+ */
+
+static void close_system(ensemble_system & s, system_output & out){
+	if(s.ok){
+		flush_writer();       // all of this system's output, before closing
+		if(s.why.what){
+			write_stop(s.why, out.dia);
+		}
+	}
+
+	s.wall = chrono::duration<double>(chrono::steady_clock::now()
+									  - out.start).count();
+	s.einit = out.to.einit;
+	s.etot = out.to.etot;
+
+	close_snap_writer(out.bin);
+}
+
+/*-----------------------------------------------------------------------------
+ *  run_system  --  integrates system k of an ensemble on its own.
+ *-----------------------------------------------------------------------------
+ */
+
+static void run_system(ensemble_system & s, int k, const options & opt){
+	system_output out;
+	if(open_system(s, k, opt, out)){
+		real *dst = new real[dst_count(s.mass, s.n)];
+		set_output(&out.to);
+		s.ok = integrate(s.mass, s.pos, s.vel, dst, s.n, s.t, opt, s.why);
+		set_output(0);
+		delete[] dst;
+	}
+	close_system(s, out);
+}
+
+/*-----------------------------------------------------------------------------
+ *  run_batch  --  integrates the systems ks[] of an ensemble, which all have
+ *                 the same number of particles, side by side in the lanes
+ *                 of the vector unit; see batch.cpp.
+ *-----------------------------------------------------------------------------
+ */
+
+static void run_batch(vector<ensemble_system> & systems,
+					  const vector<int> & ks, const options & opt){
+	int nsys = ks.size();
+	int n = systems[ks[0]].n;
+	vector<batch_system> batch(nsys);
+	vector<system_output *> out(nsys);
+	for(int b = 0; b < nsys; b++){
+		ensemble_system & s = systems[ks[b]];
+		batch[b].mass = s.mass;
+		batch[b].pos = s.pos;
+		batch[b].vel = s.vel;
+		batch[b].t = s.t;
+	}
+
+	evolve_batch(batch.data(), nsys, n, opt, [&](int b){
+		ensemble_system & s = systems[ks[b]];
+		out[b] = new system_output;
+		batch[b].to = &out[b]->to;
+		if(open_system(s, ks[b], opt, *out[b])){ return true; }
+		close_system(s, *out[b]);
+		delete out[b];
+		return false;
+	}, [&](int b){
+		ensemble_system & s = systems[ks[b]];
+		s.t = batch[b].t;
+		s.why = batch[b].why;
+		close_system(s, *out[b]);
+		delete out[b];
+	});
+}
+
+/*-----------------------------------------------------------------------------
+ *  run_ensemble  --  integrates many independent systems in one process.
+ *                    The systems are read from cin as concatenated
+ *                    snapshots (restart output can be used directly), and
+ *                    integrated with the same options, nthreads of them at a
+ *                    time, each on a single thread.  Since their run times
+ *                    can differ widely, threads that run out of systems take
+ *                    over the remaining ones of others (see steal_for()).
+ *                    A summary with the wall time, relative energy error and
+ *                    stop condition (if any) of every system is written to
+ *                    cerr at the end.
+ *-----------------------------------------------------------------------------
+ */
+
+bool run_ensemble(const options & opt){
+	vector<ensemble_system> systems;
+	bool ok = read_ensemble(systems);
+	int nsys = systems.size();
+	if(ok && nsys == 0){
+		cerr << "run_ensemble: no systems in the input" << endl;
+		ok = false;
+	}
+
+	vector<vector<int>> tasks;     // the systems of each task: a single
+	vector<bool> batched;          // one, or with -V, a batch of the same n
+	vector<int> suited;
+	for(int k = 0; k < nsys && ok; k++){
+		if(opt.V_flag && batch_suits(systems[k].mass, systems[k].n)){
+			suited.push_back(k);
+		}else{
+			tasks.push_back({k});
+			batched.push_back(false);
+		}
+	}
+	stable_sort(suited.begin(), suited.end(), [&](int a, int b){
+		return systems[a].n < systems[b].n;
+	});
+	size_t size = 4 * batch_width();   // lanes to refill, and batches
+	for(size_t a = 0, b; a < suited.size(); a = b){      // to share out
+		for(b = a + 1; b < suited.size() && b - a < size
+					   && systems[suited[b]].n == systems[suited[a]].n; b++){}
+		tasks.emplace_back(suited.begin() + a, suited.begin() + b);
+		batched.push_back(true);
+	}
+
+	if(ok){
+		cerr << "Starting " << (opt.b_flag ? "block time step " : "")
+			 << (opt.wh_frac > 0 ? "Wisdom-Holman" : "Hermite")
+			 << " integrations of an ensemble of " << nsys
+			 << " systems,\n  each for a duration " << opt.dt_tot
+			 << " with time step control parameter dt_param = "
+			 << opt.dt_param << ",\n  on " << opt.nthreads
+			 << " threads, with output to " << opt.ensemble << "-*." << endl;
+		if(opt.V_flag){
+			cerr << "  Systems of the same size are integrated "
+				 << batch_width() << " at a time with the "
+				 << batch_kernel_name() << " batch kernel." << endl;
+		}
+
+		start_writer(opt.queue_depth);
+		auto start = chrono::steady_clock::now();
+		steal_for(tasks.size(), opt.nthreads, [&](int t){
+			if(batched[t]){
+				run_batch(systems, tasks[t], opt);
+			}else{
+				run_system(systems[tasks[t][0]], tasks[t][0], opt);
+			}
+		});
+		double wall = chrono::duration<double>(chrono::steady_clock::now()
+											   - start).count();
+		stop_writer();
+
+		cerr << "  system      n     wall_s   rel_energy_error   stop" << endl;
+		for(int k = 0; k < nsys; k++){
+			const ensemble_system & s = systems[k];
+			cerr << "  " << k << "  " << s.n << "  " << s.wall << "  ";
+			if(s.ok){
+				cerr << (s.etot - s.einit) / s.einit << "  ";
+				if(s.why.what){
+					cerr << s.why.what << "@" << s.why.t << endl;
+				}else{
+					cerr << "-" << endl;
+				}
+			}else{
+				cerr << "failed" << endl;
+				ok = false;
+			}
+		}
+		cerr << "  total wall time " << wall << " s" << endl;
+	}
+
+	for(int k = 0; k < nsys; k++){
+		delete[] systems[k].mass;
+		delete[] systems[k].pos;
+		delete[] systems[k].vel;
+	}
+	return ok;
 }
 
 /*-----------------------------------------------------------------------------
@@ -148,63 +581,258 @@ bool read_options(int argc, char *argv[], real & dt_param, real & dt_dia,
  *  note: the integration time step is global, but variable. Before each step
  *        we use the collision time estimate multiplied by dt_param (the
  *        accuracy parameter) to obtain the new time step size.
+ *
+ *  With r_reg > 0, a pair of massive particles closer than r_reg is taken
+ *  out of the Hermite integration and regularized (see encounter.cpp), so
+ *  that the step size follows the rest of the system instead of the pair.
+ *  The forces on the full system are then only computed when needed for
+ *  output or stop conditions.  Encounter statistics are written at the end.
+ *
+ *  The stop conditions of stop.cpp are checked after every step, on the
+ *  distances computed with the forces.  When one is met, a last snapshot is
+ *  written at the current time, and the reason is returned.
+ *
+ *  Snapshots normally come at the first step at or after each multiple of
+ *  dt_out.  With dense output (e_flag), they are interpolated to exactly
+ *  t + k*dt_out instead, and to the end time t + dt_tot, from the values at
+ *  both ends of the step containing them; see interpolate_step().
+ *
+ *  With dt_sum > 0, the distances are also reduced after every step, and a
+ *  summary of them is written at the first step at or after each multiple
+ *  of dt_sum, and at the end; see summary.cpp.
+ *
+ *  When built with NBODY_PROFILE and given a profile stream in the output
+ *  target, the time spent in each phase of the steps and other counters
+ *  are written there as JSON lines with each diagnostics output and at the
+ *  end; see profile.cpp.
+ *
+ *  With a checkpoint file in opt, the whole state of the loop is written
+ *  there every ck_interval seconds of wall clock time, and when a stop
+ *  signal comes, after which the integration ends early; see
+ *  checkpoint.cpp.  Given such a checkpoint in from, the integration takes
+ *  up its state instead of starting anew, without the initial force
+ *  calculation and output.
  *-----------------------------------------------------------------------------
  */
 
-void evolve(const real mass[], real pos[][NDIM], real vel[][NDIM], real dst[],
-			int n, real t, real dt_param, real dt_dia, real dt_out, real dt_tot,
-			bool x_flag){
+stop_reason evolve(const real mass[], real pos[][NDIM], real vel[][NDIM],
+				   real dst[], int n, real t, const options & opt,
+				   const checkpoint *from){
+
+	real dt_param = opt.dt_param;
+	real dt_dia = opt.dt_dia;
+	real dt_out = opt.dt_out;
+	real dt_tot = opt.dt_tot;
+	bool x_flag = opt.x_flag;
+	bool e_flag = opt.e_flag;
+	real r_reg = opt.r_reg;
+	real dt_sum = opt.dt_sum;
 
-	real (* acc)[NDIM] = new real[n][NDIM];  // accelerations and jerks
-	real (* jrk)[NDIM] = new real[n][NDIM];  // for all particles
+	particle_state s;         // positions, velocities, accelerations and
+	s.reserve(n);             // jerks, now and at the start of the step
+	copy_n(pos[0], n * NDIM, s.pos[0]);
+	copy_n(vel[0], n * NDIM, s.vel[0]);
 
-	real (* old_pos)[NDIM] = new real[n][NDIM];
-	real (* old_vel)[NDIM] = new real[n][NDIM];
-	real (* old_acc)[NDIM] = new real[n][NDIM];
-	real (* old_jrk)[NDIM] = new real[n][NDIM];
+	real (* out_pos)[NDIM] = e_flag ? new real[n][NDIM] : 0;  // interpolated
+	real (* out_vel)[NDIM] = e_flag ? new real[n][NDIM] : 0;  // for output
 
 	real epot;                // potential energy of the n-body system
 	real coll_time;           // collision (close encounter) time scale
 
-	get_acc_jrk_pot_coll(mass, pos, vel, acc, jrk, dst, n, epot, coll_time);
-
-	write_diagnostics(mass, pos, vel, acc, jrk,
-					  n, t, epot, 0, x_flag);
-
-	put_snapshot(mass, pos, vel, dst, n, t);
+#ifdef NBODY_PROFILE
+	profile prof;             // counters, if asked for; see profile.cpp
+	output_target & to = *get_output();
+	if(to.prof){ start_profile(prof, *to.prof); }
+#endif
 
+	real einit;               // total energy at the start
+	summary sum;              // reductions of the distances, if dt_sum > 0
 	real t_dia = t + dt_dia;  // next time for diagnostics output
 	real t_out = t + dt_out;  // next time for snapshot output
+	real t_sum = t + dt_sum;  // next time for summary output
 	real t_end = t + dt_tot;  // final time, to finish the integration
 
+	real t_start = t;         // dense output comes at t_start + k*dt_out,
+	int k_out = 1;            // and at t_end
+	if(e_flag && t_out > t_end){ t_out = t_end; }
+
 	int nsteps = 0;           // number of integration time steps completed
+
+	if(from){
+		copy_n(from->acc.data(), n * NDIM, s.acc[0]);
+		copy_n(from->jrk.data(), n * NDIM, s.jrk[0]);
+		get_dst(mass, s.pos, dst, n);
+		epot = from->epot;
+		coll_time = from->coll_time;
+		einit = from->einit;
+		get_output()->einit = from->dia_einit;
+		sum = from->sum;
+		t_dia = from->t_dia;
+		t_out = from->t_out;
+		t_sum = from->t_sum;
+		t_end = from->t_end;
+		t_start = from->t_start;
+		k_out = from->k_out;
+		nsteps = from->nsteps;
+	}else{
+		get_acc_jrk_pot_coll(mass, s.pos, s.vel, s.acc, s.jrk, dst, n, epot,
+							 coll_time);
+		einit = total_energy(mass, s.vel, n, epot);
+
+		queue_diagnostics(mass, s.pos, s.vel, s.acc, s.jrk,
+						  n, t, epot, 0, x_flag);
+
+		queue_snapshot(mass, s.pos, s.vel, dst, dst_count(mass, n), n, t);
+
+		if(dt_sum > 0){ start_summary(sum, dst, dst_count(mass, n), t); }
+	}
+	bool checking = stop_checks(opt);
+	stop_reason why;
+	encounter enc;            // a close pair integrated apart, if r_reg > 0
+
+	using ck_clock = chrono::steady_clock;
+	auto ck_interval = chrono::duration<double>(opt.ck_interval);
+	auto t_ck = ck_clock::now() + ck_interval;   // next checkpoint
+	auto write_ck = [&](){
+		output_target & out = *get_output();
+		flush_writer();       // the output up to t goes out before the
+		if(out.snap){ out.snap->flush(); }    // checkpoint that follows it
+		if(out.sum){ out.sum->flush(); }
+		if(out.bin){ fflush(out.bin->file); }
+		checkpoint ck;
+		ck.n = n;
+		ck.t = t;
+		ck.t_start = t_start;
+		ck.t_end = t_end;
+		ck.t_dia = t_dia;
+		ck.t_out = t_out;
+		ck.t_sum = t_sum;
+		ck.k_out = k_out;
+		ck.nsteps = nsteps;
+		ck.epot = epot;
+		ck.coll_time = coll_time;
+		ck.einit = einit;
+		ck.dia_einit = out.einit;
+		ck.mass.assign(mass, mass + n);
+		ck.pos.assign(s.pos[0], s.pos[0] + n * NDIM);
+		ck.vel.assign(s.vel[0], s.vel[0] + n * NDIM);
+		ck.acc.assign(s.acc[0], s.acc[0] + n * NDIM);
+		ck.jrk.assign(s.jrk[0], s.jrk[0] + n * NDIM);
+		if(dt_sum > 0){ ck.sum = sum; }
+		write_checkpoint(opt.checkpoint, ck, opt);
+	};
+
 	while(t < t_end){
-		real dt = dt_param * coll_time;
-		evolve_step(mass, pos, vel, acc, jrk, dst,
-					old_pos, old_vel, old_acc, old_jrk,
-					n, dt, epot, coll_time);
+		real dt;
+		if(r_reg > 0 && enc.i < 0){
+			start_encounter(mass, s.pos, s.vel, dst, n, r_reg, enc);
+		}
+		if(enc.i >= 0){
+			dt = dt_param * enc.coll_time;
+			encounter_step(enc, s.pos, s.vel, n, dt, r_reg);
+			if(enc.i < 0 || checking || t + dt >= t_out || t + dt >= t_end
+			   || (dt_dia > 0 && t + dt >= t_dia)){
+				PROFILE_START(t0);
+				get_acc_jrk_pot_coll(mass, s.pos, s.vel, s.acc, s.jrk, dst, n,
+									 epot, coll_time);
+				PROFILE_STOP(PROF_FORCE, t0);
+			}else if(dt_sum > 0){
+				get_dst(mass, s.pos, dst, n);     // for the summary
+			}
+		}else{
+			dt = dt_param * coll_time;
+			evolve_step(mass, s, dst, n, dt, epot, coll_time);
+		}
 		t += dt;
 		nsteps++;
+		if(dt_sum > 0){ add_summary_step(sum, dst, t, dt); }
+#ifdef NBODY_PROFILE
+		profile_step(mass, s.pos, s.vel, n, dt);
+#endif
+		bool stop = checking && check_stop(mass, s.pos, s.vel, dst, n, t,
+										   epot, einit, opt, why);
+		bool out_now = false;     // a snapshot at t has been written
+		PROFILE_START(t_o);
 		if(dt_dia > 0 && t >= t_dia){
-			write_diagnostics(mass, pos, vel, acc, jrk,
+			queue_diagnostics(mass, s.pos, s.vel, s.acc, s.jrk,
 							  n, t, epot, nsteps, x_flag);
 			do{ t_dia += dt_dia; } while(t_dia < t);
+#ifdef NBODY_PROFILE
+			if(to.prof){
+				if(to.prof == to.dia){ flush_writer(); }  // no mixed lines
+				write_profile(t, to.snap_bytes, false);
+			}
+#endif
 		}
-		if(t >= t_out){
-			put_snapshot(mass, pos, vel, dst, n, t);
+		if(dt_sum > 0 && t >= t_sum){
+			queue_summary(mass, s.pos, s.vel, n, t, sum);
+			next_summary_window(sum, dst, t);
+			do{ t_sum += dt_sum; } while(t_sum < t);
+		}
+		if(e_flag){
+			while(t_out <= t){
+				interpolate_step(s.old_pos, s.old_vel, s.old_acc, s.old_jrk,
+								 s.pos, s.vel, s.acc, s.jrk, n, dt,
+								 t_out - (t - dt), out_pos, out_vel);
+				get_dst(mass, out_pos, dst, n);
+				queue_snapshot(mass, out_pos, out_vel, dst,
+							   dst_count(mass, n), n, t_out);
+				out_now = t_out == t;
+				if(t_out == t_end){ break; }
+				t_out = t_start + ++k_out * dt_out;
+				if(t_out > t_end){ t_out = t_end; }
+			}
+		}else if(t >= t_out){
+			queue_snapshot(mass, s.pos, s.vel, dst, dst_count(mass, n), n, t);
+			out_now = true;
 			do{ t_out += dt_out; } while(t_out < t);
 		}
+		PROFILE_STOP(PROF_OUTPUT, t_o);
+		if(stop){
+			if(!out_now){
+				if(e_flag){ get_dst(mass, s.pos, dst, n); }
+				queue_snapshot(mass, s.pos, s.vel, dst, dst_count(mass, n), n,
+							   t);
+			}
+			break;
+		}
+		if(opt.checkpoint && t < t_end
+		   && (stop_signal() || ck_clock::now() >= t_ck)){
+			write_ck();
+			t_ck = ck_clock::now() + ck_interval;
+			if(stop_signal()){
+				why.what = "signal";
+				why.t = t;
+				break;
+			}
+		}
 	}
 
 	if(dt_dia == 0 || t > (t_dia - dt_dia)){
-		write_diagnostics(mass, pos, vel, acc, jrk,
+		queue_diagnostics(mass, s.pos, s.vel, s.acc, s.jrk,
 						  n, t, epot, nsteps, x_flag);
 	}
+	if(dt_sum > 0 && sum.span > 0 && !stop_signal()){  // after a signal, the
+		queue_summary(mass, s.pos, s.vel, n, t, sum);  // run resumed from the
+	}                                                  // checkpoint writes it
+	if(r_reg > 0){
+		end_encounter(enc);
+		flush_writer();       // the diagnostics above come first
+		write_encounters(enc, *get_output()->dia);
+	}
+#ifdef NBODY_PROFILE
+	if(to.prof){
+		flush_writer();       // all snapshot bytes counted
+		write_profile(t, to.snap_bytes, true);
+		stop_profile();
+	}
+#endif
+
+	copy_n(s.pos[0], n * NDIM, pos[0]);
+	copy_n(s.vel[0], n * NDIM, vel[0]);
+	delete[] out_pos;
+	delete[] out_vel;
+	return why;
+}
 
-	delete[] acc;
-	delete[] jrk;
-	delete[] old_pos;
-	delete[] old_vel;
-	delete[] old_acc;
-	delete[] old_jrk;
 }
\ No newline at end of file
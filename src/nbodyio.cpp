@@ -1,22 +1,52 @@
 #include <iostream>
+#include <limits>
 #include "nbody.h"
 #include "nbodyio.h"
+#include "snapfile.h"
 
 using namespace std;
 
+namespace NBODY_VARIANT {
+
 /*-----------------------------------------------------------------------------
  *  get_snapshot  --  reads a single snapshot from the input stream cin.
  *                    Only the particle data is read in- the main program is
  *                    responsible for reading in particle number and time.
- *                    The system is normalized with the center of mass at the
- *                    origin and zero net momentum.
+ *                    The system is then set up by set_up_snapshot().
  *-----------------------------------------------------------------------------
  */
 
-void get_snapshot(real mass[], real pos[][NDIM], real vel[][NDIM], int n){
+bool get_snapshot(real mass[], real pos[][NDIM], real vel[][NDIM], int n){
+	for(int i = 0; i < n; i++){
+		cin >> mass[i];                 // mass of particle i, still in kg
+		for(int k = 0; k < NDIM; k++){
+			cin >> pos[i][k];           // position of particle i
+		}
+		for(int k = 0; k < NDIM; k++){
+			cin >> vel[i][k];           // velocity of particle i
+		}
+	}
+	return set_up_snapshot(mass, pos, vel, n);
+}
 
-	real (*cmass) = new real[NDIM];      //center of mass
-	real (*moment) = new real[NDIM];     //net momentum
+/*-----------------------------------------------------------------------------
+ *  set_up_snapshot  --  prepares a snapshot just read in, with the masses
+ *                       still in kg, for integration: the masses are
+ *                       multiplied by G, and the system is normalized with
+ *                       the center of mass at the origin and zero net
+ *                       momentum.
+ *
+ *  Particles of zero mass are test particles, which feel the others but do
+ *  not act on anything.  They must come after all massive particles, and
+ *  there must be at least one massive particle; otherwise an error is
+ *  reported and the return value is false.
+ *-----------------------------------------------------------------------------
+ */
+
+bool set_up_snapshot(real mass[], real pos[][NDIM], real vel[][NDIM], int n){
+
+	real cmass[NDIM];                    //center of mass
+	real moment[NDIM];                   //net momentum
 	for(int k = 0; k < NDIM; k++){
 		cmass[k] = 0;
 		moment[k] = 0;
@@ -24,24 +54,28 @@ void get_snapshot(real mass[], real pos[][NDIM], real vel[][NDIM], int n){
 
 	real tmass = 0;
 	for(int i = 0; i < n; i++){
-		real m;
-		cin >> m;
-		mass[i] = G*m;                  // mass of particle i
-		tmass += m;
-		for(int k = 0; k < NDIM; k++){
-			real p;
-			cin >> p;
-			pos[i][k] = p;              // position of particle i
-			cmass[k] += p*m;
+		real m = mass[i];
+		if(m > 0 && i > 0 && mass[i-1] == 0){
+			cerr << "get_snapshot: massive particle " << i
+				 << " follows a test particle" << endl;
+			return false;
 		}
+		tmass += m;
 		for(int k = 0; k < NDIM; k++){
-			real v;
-			cin >> v;
-			vel[i][k] = v;              // velocity of particle i
-			moment[k] += v*m;
+			cmass[k] += pos[i][k]*m;
+			moment[k] += vel[i][k]*m;
 		}
 	}
 
+	if(tmass <= 0){
+		cerr << "get_snapshot: no massive particles" << endl;
+		return false;
+	}
+
+	for(int i = 0; i < n; i++){
+		mass[i] *= G;
+	}
+
 	for(int k = 0; k < NDIM; k++){
 		real offset = cmass[k]/tmass;
 		real velocity = moment[k]/tmass;
@@ -50,34 +84,81 @@ void get_snapshot(real mass[], real pos[][NDIM], real vel[][NDIM], int n){
 			vel[i][k] -= velocity;
 		}
 	}
+	return true;
 }
 
 /*-----------------------------------------------------------------------------
- *  put_snapshot  --  writes a single snapshot on the output stream cout.
+ *  set_output, get_output  --  the output target of the calling thread,
+ *                              where put_snapshot() and write_diagnostics()
+ *                              write: snapshots to cout and diagnostics to
+ *                              cerr unless set otherwise.  Setting a null
+ *                              pointer goes back to that default.
+ *-----------------------------------------------------------------------------
+ */
+
+static output_target default_target;
+static thread_local output_target *current_target = &default_target;
+
+void set_output(output_target *to){
+	current_target = to ? to : &default_target;
+}
+
+output_target *get_output(){
+	return current_target;
+}
+
+/*-----------------------------------------------------------------------------
+ *  put_snapshot  --  writes a single snapshot on the output stream out.
+ *                    The last line holds the ndst entries of dst[], normally
+ *                    all n*(n-1)/2 pairwise distances.  The stream is only
+ *                    flushed at the end of the snapshot.  While a binary
+ *                    snapshot file is open (see snapfile.cpp) the snapshot
+ *                    goes there instead.  Without either, as with
+ *                    summaries only, nothing is written.
  *  note: unlike get_snapshot(), put_snapshot handles particle number and time
  *-----------------------------------------------------------------------------
  */
 
 void put_snapshot(const real mass[], const real pos[][NDIM],
-				  const real vel[][NDIM], const real dst[],
+				  const real vel[][NDIM], const real dst[], int ndst,
 				  int n, real t){
 
-	cout.precision(16);
-	cout << n << ' ' << t << endl;
+	output_target & to = *get_output();
+	if(to.bin){
+#ifdef NBODY_PROFILE
+		int64_t start = to.bin->end;    // compressed records vary in size
+#endif
+		put_snapshot_binary(*to.bin, mass, pos, vel, dst, ndst, n, t);
+#ifdef NBODY_PROFILE
+		to.snap_bytes += to.bin->end - start;
+#endif
+		return;
+	}
+	if(!to.snap){ return; }        // only summaries are written
+
+	ostream & out = *to.snap;
+#ifdef NBODY_PROFILE
+	streampos start = out.tellp();    // -1 if not seekable, e.g. a pipe
+#endif
+	out.precision(numeric_limits<real>::digits10 + 1);
+	out << n << ' ' << t << '\n';
 	for(int i = 0; i < n; i++){
-		cout << (mass[i] / G);
-		for(int k = 0; k < NDIM; k++){ cout << ' ' << pos[i][k]; }
-		for(int k = 0; k < NDIM; k++){ cout << ' ' << vel[i][k]; }
-		cout << endl;
+		out << (mass[i] / G);
+		for(int k = 0; k < NDIM; k++){ out << ' ' << pos[i][k]; }
+		for(int k = 0; k < NDIM; k++){ out << ' ' << vel[i][k]; }
+		out << '\n';
 	}
 
-	int d = n*(n-1)/2;
-	for(int i = 0; i < d; i++){ cout << dst[i] << ' '; }
-	cout << endl;
+	for(int i = 0; i < ndst; i++){ out << dst[i] << ' '; }
+	out << endl;
+#ifdef NBODY_PROFILE
+	if(start >= 0){ to.snap_bytes += out.tellp() - start; }
+#endif
 }
 
 /*-----------------------------------------------------------------------------
- *  write_diagnostics  --  writes diagnostics on the error stream cerr:
+ *  write_diagnostics  --  writes diagnostics on the diagnostics stream of
+ *                         the current output target (normally cerr):
  *                         current time; number of steps so far; KE, PE, and
  *                         total energy; absolute and relative energy errors
  *                         since the start of the run.
@@ -95,7 +176,8 @@ void write_diagnostics(const real mass[], const real pos[][NDIM],
 					   const real jrk[][NDIM], int n, real t, real epot,
 					   int nsteps, bool x_flag){
 
-	static real einit = 0;
+	output_target & to = *get_output();
+	ostream & dia = *to.dia;
 
 	real ekin = 0;                       // kinetic energy of the n-body system
 	for(int i = 0; i < n; i++){
@@ -106,39 +188,43 @@ void write_diagnostics(const real mass[], const real pos[][NDIM],
 
 	real etot = (ekin + epot)/G;         // total energy of the n-body system
 
-	if(einit == 0){                      // at first pass, record the initial energy
-		einit = etot;
+	if(to.einit == 0){                   // at first pass, record the initial energy
+		to.einit = etot;
 	}
+	real einit = to.einit;
+	to.etot = etot;
 
-	cerr << "at time t = " << t << " , after " << nsteps
+	dia << "at time t = " << t << " , after " << nsteps
 		 << " steps :\n  E_kin = " << ekin
 		 << " , E_pot = " << epot
 		 << " , E_tot = " << etot << endl;
-	cerr << "                "
+	dia << "                "
 		 << "absolute energy error: E_tot - E_init = "
 		 << etot - einit << endl;
-	cerr << "                "
+	dia << "                "
 		 << "relative energy error: (E_tot - E_init) / E_init = "
 		 << (etot - einit) / einit << endl;
 
 	if(!x_flag){ return; }
-	cerr << "  Internal data: \n";
+	dia << "  Internal data: \n";
 	for(int i = 0; i < n; i++){
-		cerr << "    Data for particle " << i+1 << " : " << endl;
-		cerr << "      Mass: ";
-		cerr << mass[i];
-		cerr << "\n      Pos:  ";
+		dia << "    Data for particle " << i+1 << " : " << endl;
+		dia << "      Mass: ";
+		dia << mass[i];
+		dia << "\n      Pos:  ";
 		for(int k = 0; k < NDIM; k++)
-			cerr << ' ' << pos[i][k];
-		cerr << "\n      Vel:  ";
+			dia << ' ' << pos[i][k];
+		dia << "\n      Vel:  ";
 		for(int k = 0; k < NDIM; k++)
-			cerr << ' ' << vel[i][k];
-		cerr << "\n      Acc:  ";
+			dia << ' ' << vel[i][k];
+		dia << "\n      Acc:  ";
 		for(int k = 0; k < NDIM; k++)
-			cerr << ' ' << acc[i][k];
-		cerr << "\n      jrk: ";
+			dia << ' ' << acc[i][k];
+		dia << "\n      jrk: ";
 		for(int k = 0; k < NDIM; k++)
-			cerr << ' ' << jrk[i][k];
-		cerr << endl;
+			dia << ' ' << jrk[i][k];
+		dia << endl;
 	}
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,377 @@
+#include <iostream>
+#include <algorithm>  // for nth_element(), min() and max()
+#include <cmath>      // to include sqrt(), fmod(), etc.
+#include <cfloat>     // for DBL_MAX
+#include "nbody.h"
+#include "evolve.h"
+#include "block.h"
+#include "neighbor.h"
+#include "parallel.h"
+
+using namespace std;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  neighbor.cpp: the Ahmad-Cohen neighbor scheme for block time steps.
+ *
+ *     With block time steps alone, every active particle still sums the
+ *     force of all nm massive particles.  In a clustered system most of that
+ *     force comes from far away and changes slowly, while the part from the
+ *     few nearby particles sets the time step.  So the force on particle i
+ *     is split in two:
+ *
+ *        irregular  from the target massive particles nearest to it, its
+ *                   neighbors, recomputed at every step of i
+ *        regular    from all others, recomputed only every dt_reg[i] (a
+ *                   power of two, and a multiple of the irregular step),
+ *                   and extrapolated with its jerk and second derivative
+ *                   in between
+ *
+ *     At a regular step the whole sum is done, which also rebuilds the
+ *     neighbor list from the predicted positions, as the target nearest
+ *     massive particles, so the lists keep their size as the system
+ *     spreads or contracts.  The corrector of
+ *     block.cpp sees the total force either way, irregular plus
+ *     extrapolated regular, so the scheme changes only where the force
+ *     comes from.  An irregular step costs the size of the list instead of
+ *     nm pair interactions.
+ *
+ *     The second and third derivatives of the regular force come from the
+ *     Hermite interpolation between two regular steps, and give the next
+ *     regular step by Aarseth's criterion, as dt_param times the time scale
+ *
+ *        sqrt((|a| |a''| + |a'|^2) / (|a'| |a'''| + |a''|^2))
+ *
+ *     of the regular force, like the irregular steps are dt_param times a
+ *     collision time.  That criterion only sees how smoothly the regular
+ *     force has changed so far, so the regular step is also held to
+ *     dt_param times the shortest collision time of the pairs in the
+ *     regular force: a massive body that is not a neighbor (the star, for
+ *     a planet whose neighbor is another planet) is extrapolated over no
+ *     more than the step it would set on its own.  The first regular step
+ *     is as long as the irregular one.  So that the derivatives are not
+ *     thrown off by particles moving in and out of the list, the new
+ *     regular force is also summed over the particles outside the old
+ *     list for them.
+ *
+ *     Particles are ranked by their distance, less the distance they close
+ *     in over the next regular step if they are approaching, so that no
+ *     close approach goes by in the extrapolated regular force.
+ *
+ *     With target at least nm - 1, every massive particle is a neighbor of
+ *     every other, the regular force is zero and the regular steps are as
+ *     long as any step; the integration is then that of block.cpp alone.
+ *
+ *     ref.: Ahmad, A. & Cohen, L., 1973, J. Comput. Phys. 12, 389-402;
+ *           Makino, J. & Aarseth, S. J., 1992, Publ. Astron. Soc. Japan
+ *           44, 141-151, for the Hermite version.
+ *-----------------------------------------------------------------------------
+ */
+
+/*-----------------------------------------------------------------------------
+ *  add_pair  --  adds the acceleration and jerk of particle j on particle i,
+ *                and takes the collision time estimates of the pair into
+ *                coll_time_q, as get_acc_jrk_coll_active() does.  Returns
+ *                the squared distance, and the radial velocity times the
+ *                distance in rv.
+ *-----------------------------------------------------------------------------
+ */
+
+static inline real add_pair(const real mass[], const real pos[][NDIM],
+							const real vel[][NDIM], int i, int j,
+							real acc[NDIM], real jrk[NDIM],
+							real & coll_time_q, real & rv){
+	real rji[NDIM];
+	real vji[NDIM];
+
+	real r2 = 0;
+	real v2 = 0;
+	real rv_r2 = 0;
+
+	for(int k = 0; k < NDIM; k++){
+		rji[k] = pos[j][k] - pos[i][k];
+		vji[k] = vel[j][k] - vel[i][k];
+
+		r2 += rji[k] * rji[k];
+		v2 += vji[k] * vji[k];
+		rv_r2 += rji[k] * vji[k];
+	}
+
+	rv = rv_r2;
+	rv_r2 /= r2;
+	real r = sqrt(r2);
+	real r3 = r * r2;
+
+	real da2 = 0;
+	for(int k = 0; k < NDIM; k++){
+		real da = rji[k] / r3;
+		real dj = (vji[k] - 3 * rv_r2 * rji[k]) / r3;
+
+		da2 += da*da;
+
+		acc[k] += mass[j] * da;
+		jrk[k] += mass[j] * dj;
+	}
+
+	real coll_est_q = (r2*r2) / (v2*v2);
+	if(coll_time_q > coll_est_q){
+		coll_time_q = coll_est_q;
+	}
+
+	real mij = mass[i] + mass[j];
+	coll_est_q = G*r2/(da2*mij*mij);
+	if(coll_time_q > coll_est_q){
+		coll_time_q = coll_est_q;
+	}
+	return r2;
+}
+
+/*-----------------------------------------------------------------------------
+ *  start_neighbors  --  sets up the neighbor scheme for n particles, with
+ *                       about target neighbors each and eta (dt_param) for
+ *                       the regular steps, and computes the first
+ *                       (regular) forces and collision times of all of
+ *                       them.
+ *
+ *  The start counts as a regular step of every particle, which picks the
+ *  first lists.
+ *-----------------------------------------------------------------------------
+ */
+
+void start_neighbors(neighbor_state & nb, int target, real eta,
+					 const real mass[], const real pos[][NDIM],
+					 const real vel[][NDIM], real acc[][NDIM],
+					 real jrk[][NDIM], real coll_time[], int n){
+	int nm = massive_count(mass, n);
+	nb.target = target;
+	nb.all = target >= nm - 1;
+	nb.eta = eta;
+	nb.list.assign(n, vector<int>());
+	nb.radius.assign(n, 0);
+	nb.reg_acc.assign(n * NDIM, 0);
+	nb.reg_jrk.assign(n * NDIM, 0);
+	nb.reg_snp.assign(n * NDIM, 0);
+	nb.t_reg.assign(n, 0);    // so that the first step of everybody is
+	nb.dt_reg.assign(n, 0);   // regular
+	nb.reg_want.assign(n, 0);
+	nb.regular.assign(n, 0);
+
+	int *all = new int[n];
+	for(int i = 0; i < n; i++){ all[i] = i; }
+	get_acc_jrk_coll_neighbors(nb, mass, pos, vel, acc, jrk, coll_time,
+							   all, n, n, 0);
+	delete[] all;
+	nb.nreg = nb.nirr = 0;    // the start is no step
+}
+
+/*-----------------------------------------------------------------------------
+ *  get_acc_jrk_coll_neighbors  --  the force routine of the neighbor scheme,
+ *                                  in place of get_acc_jrk_coll_active():
+ *                                  accelerations, jerks and collision time
+ *                                  scales of the active particles at the
+ *                                  relative time tau, with all positions and
+ *                                  velocities predicted to it.
+ *
+ *  Particles whose regular step ends at tau get the whole sum over all
+ *  massive particles, split into their new neighbor list and the regular
+ *  force; the others only sum over their lists and add the regular force
+ *  extrapolated to tau.  Their collision times then come from their
+ *  neighbors only, which are the ones that limit the step.
+ *-----------------------------------------------------------------------------
+ */
+
+void get_acc_jrk_coll_neighbors(neighbor_state & nb, const real mass[],
+								const real pos[][NDIM],
+								const real vel[][NDIM], real acc[][NDIM],
+								real jrk[][NDIM], real coll_time[],
+								const int active[], int nact, int n,
+								real tau){
+	int nm = massive_count(mass, n);
+	double work = 0;          // pair interactions, to share out
+	for(int a = 0; a < nact; a++){
+		int i = active[a];
+		nb.regular[i] = tau == nb.t_reg[i] + nb.dt_reg[i];
+		work += nb.regular[i] ? nm : nb.list[i].size();
+	}
+
+	int ntasks = pair_task_count(work);
+	parallel_for(ntasks, [&](int t){
+		vector<char> old(nm, 0);  // marks the old list of a particle
+		vector<real> rank(nm);    // distance, less the approach, of each
+		vector<real> order(nm);   // the same, to find the target-th
+		int a1 = (long long) nact * (t+1) / ntasks;
+		for(int a = (long long) nact * t / ntasks; a < a1; a++){
+			int i = active[a];
+			real coll_time_q = DBL_MAX;
+			real irr_acc[NDIM], irr_jrk[NDIM];
+			real *reg_acc = &nb.reg_acc[i*NDIM];
+			real *reg_jrk = &nb.reg_jrk[i*NDIM];
+			real *reg_snp = &nb.reg_snp[i*NDIM];
+			for(int k = 0; k < NDIM; k++){
+				irr_acc[k] = irr_jrk[k] = 0;
+			}
+
+			if(nb.regular[i]){
+				vector<int> & list = nb.list[i];
+				real acc0[NDIM], jrk0[NDIM];  // regular force, at t_reg
+				real acc1[NDIM], jrk1[NDIM];  // and now, with the old list
+				for(int k = 0; k < NDIM; k++){
+					acc0[k] = reg_acc[k];
+					jrk0[k] = reg_jrk[k];
+					reg_acc[k] = reg_jrk[k] = acc1[k] = jrk1[k] = 0;
+				}
+				for(int j : list){ old[j] = 1; }
+				list.clear();
+				real ahead = 2 * nb.dt_reg[i];    // the next regular step
+				int m = 0;                        // is at most this long
+				for(int j = 0; j < nm; j++){
+					if(j == i){ continue; }
+					real r2 = 0, rv = 0;
+					for(int k = 0; k < NDIM; k++){
+						real d = pos[j][k] - pos[i][k];
+						r2 += d * d;
+						rv += d * (vel[j][k] - vel[i][k]);
+					}
+					real r = sqrt(r2);
+					rank[j] = rv < 0 ? r + rv / r * ahead : r;
+					order[m++] = rank[j];
+				}
+				real rs = DBL_MAX;                // rank of the last neighbor
+				if(!nb.all && m > nb.target){
+					nth_element(order.begin(), order.begin() + nb.target - 1,
+								order.begin() + m);
+					rs = order[nb.target - 1];
+				}
+				nb.radius[i] = rs;
+
+				real reg_coll_q = DBL_MAX;        // of the regular pairs
+				for(int j = 0; j < nm; j++){
+					if(j == i){ continue; }
+					real ra[NDIM] = {}, rj[NDIM] = {};
+					real rv, pair_q = DBL_MAX;
+					add_pair(mass, pos, vel, i, j, ra, rj, pair_q, rv);
+					bool near = rank[j] <= rs;
+					if(near){
+						list.push_back(j);
+					}else if(reg_coll_q > pair_q){
+						reg_coll_q = pair_q;
+					}
+					if(coll_time_q > pair_q){ coll_time_q = pair_q; }
+					for(int k = 0; k < NDIM; k++){
+						(near ? irr_acc : reg_acc)[k] += ra[k];
+						(near ? irr_jrk : reg_jrk)[k] += rj[k];
+						if(!old[j]){
+							acc1[k] += ra[k];
+							jrk1[k] += rj[k];
+						}
+					}
+					old[j] = 0;
+				}
+
+				real dt = tau - nb.t_reg[i];
+				if(dt > 0){               // Hermite interpolation
+					real a2 = 0, j2 = 0, s2 = 0, c2 = 0;   // squared norms
+					for(int k = 0; k < NDIM; k++){
+						real snp0 = (-6*(acc0[k] - acc1[k])
+									 - dt*(4*jrk0[k] + 2*jrk1[k])) / (dt*dt);
+						real crk = (12*(acc0[k] - acc1[k])
+									+ 6*dt*(jrk0[k] + jrk1[k])) / (dt*dt*dt);
+						reg_snp[k] = snp0 + crk*dt;
+						a2 += acc1[k]*acc1[k];
+						j2 += jrk1[k]*jrk1[k];
+						s2 += reg_snp[k]*reg_snp[k];
+						c2 += crk*crk;
+					}
+					real num = sqrt(a2*s2) + j2;
+					real den = sqrt(j2*c2) + s2;
+					nb.reg_want[i] = den > 0 ? nb.eta * sqrt(num / den) : DBL_MAX;
+					if(reg_coll_q < DBL_MAX){
+						nb.reg_want[i] = min(nb.reg_want[i],
+											 nb.eta * sqrt(sqrt(reg_coll_q)));
+					}
+				}else{
+					for(int k = 0; k < NDIM; k++){ reg_snp[k] = 0; }
+					nb.reg_want[i] = 0;
+				}
+				for(int k = 0; k < NDIM; k++){
+					acc[i][k] = irr_acc[k] + reg_acc[k];
+					jrk[i][k] = irr_jrk[k] + reg_jrk[k];
+				}
+			}else{
+				for(int j : nb.list[i]){
+					real rv;
+					add_pair(mass, pos, vel, i, j, irr_acc, irr_jrk,
+							 coll_time_q, rv);
+				}
+				real dt = tau - nb.t_reg[i];
+				for(int k = 0; k < NDIM; k++){
+					acc[i][k] = irr_acc[k] + reg_acc[k] + reg_jrk[k]*dt
+							  + reg_snp[k]*dt*dt/2;
+					jrk[i][k] = irr_jrk[k] + reg_jrk[k] + reg_snp[k]*dt;
+				}
+			}
+
+			coll_time[i] = sqrt(sqrt(coll_time_q));
+		}
+	});
+
+	for(int a = 0; a < nact; a++){
+		if(nb.regular[active[a]]){ nb.nreg++; }else{ nb.nirr++; }
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  next_regular_steps  --  chooses the next regular step of the active
+ *                          particles that have just had a regular one, at
+ *                          relative time tau, from the step wanted by
+ *                          get_acc_jrk_coll_neighbors() as next_block_step()
+ *                          chooses irregular ones; the first is the
+ *                          irregular step in step[].  The irregular steps
+ *                          are then cut down to the regular ones if need
+ *                          be, so that they end exactly at the next regular
+ *                          step.
+ *-----------------------------------------------------------------------------
+ */
+
+void next_regular_steps(neighbor_state & nb, real step[], const int active[],
+						int nact, real tau, real dt_max){
+	for(int a = 0; a < nact; a++){
+		int i = active[a];
+		if(!nb.regular[i]){ continue; }
+		real dt = nb.all ? dt_max         // there is no regular force
+				: nb.reg_want[i] > 0
+			? next_block_step(nb.dt_reg[i], nb.reg_want[i], tau, dt_max)
+			: step[i];
+		nb.t_reg[i] = tau;
+		nb.dt_reg[i] = dt;
+		while(step[i] > dt){ step[i] /= 2; }
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  write_neighbors  --  writes the sizes of the neighbor lists, and the
+ *                       regular and irregular steps taken so far, as a line
+ *                       of the diagnostics.
+ *-----------------------------------------------------------------------------
+ */
+
+void write_neighbors(const neighbor_state & nb, ostream & out){
+	size_t n = nb.list.size();
+	size_t lo = n > 0 ? nb.list[0].size() : 0, hi = lo, sum = 0;
+	for(size_t i = 0; i < n; i++){
+		size_t s = nb.list[i].size();
+		lo = min(lo, s);
+		hi = max(hi, s);
+		sum += s;
+	}
+	out << "  neighbors per particle: mean " << (double) sum / max(n, (size_t) 1)
+		<< ", min " << lo << ", max " << hi << "; " << nb.nreg
+		<< " regular and " << nb.nirr << " irregular steps";
+	if(nb.nreg > 0){
+		out << ", " << (double) nb.nirr / nb.nreg << " irregular per regular";
+	}
+	out << endl;
+}
+
+}
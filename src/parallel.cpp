@@ -0,0 +1,225 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <deque>
+#include <cstdlib>    // for atexit()
+#include "parallel.h"
+
+using namespace std;
+
+/*-----------------------------------------------------------------------------
+ *  parallel.cpp: a small pool of persistent worker threads for the force
+ *                calculation.  The threads are started once by
+ *                set_thread_count() and then woken for each parallel_for(),
+ *                which is much cheaper than starting new threads every step.
+ *
+ *  Task t of a parallel_for() always runs on thread t mod (number of
+ *  threads), and the caller's own thread takes part as thread 0.  Callers
+ *  give each task its own output buffers and combine them in task order,
+ *  so results depend on the number of threads but not on scheduling.
+ *-----------------------------------------------------------------------------
+ */
+
+static vector<thread> workers;
+static mutex pool_mutex;              // guards everything below
+static mutex call_mutex;              // one parallel_for() at a time
+static condition_variable start_cv;
+static condition_variable done_cv;
+
+static const function<void(int)> *job = 0;
+static int job_tasks = 0;
+static long generation = 0;           // bumped for every new job
+static int pending = 0;               // workers still busy with the job
+static bool stopping = false;
+static int pool_threads = 1;          // workers plus the calling thread
+
+const int MIN_PAIRS_PER_TASK = 2048;
+
+static void run_tasks(int id, int nthreads){
+	for(int t = id; t < job_tasks; t += nthreads){ (*job)(t); }
+}
+
+static void worker(int id, long seen){
+	for(;;){
+		unique_lock<mutex> lock(pool_mutex);
+		start_cv.wait(lock, [&]{ return stopping || generation != seen; });
+		if(stopping){ return; }
+		seen = generation;
+		lock.unlock();
+
+		run_tasks(id, pool_threads);
+
+		lock.lock();
+		if(--pending == 0){ done_cv.notify_one(); }
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  set_thread_count  --  sets the number of threads used by parallel_for(),
+ *                        including the calling thread.  Starts or restarts
+ *                        the worker pool as needed.
+ *-----------------------------------------------------------------------------
+ */
+
+static void stop_pool(){
+	set_thread_count(1);
+}
+
+void set_thread_count(int nthreads){
+	static bool registered = false;
+	if(nthreads < 1){ nthreads = 1; }
+	if(nthreads == get_thread_count()){ return; }
+	if(!registered){
+		atexit(stop_pool);    // workers must be joined before exit
+		registered = true;
+	}
+
+	{
+		lock_guard<mutex> lock(pool_mutex);
+		stopping = true;
+	}
+	start_cv.notify_all();
+	for(size_t w = 0; w < workers.size(); w++){ workers[w].join(); }
+	workers.clear();
+
+	stopping = false;
+	pool_threads = nthreads;
+	for(int w = 1; w < nthreads; w++){
+		workers.push_back(thread(worker, w, generation));
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  get_thread_count  --  returns the number of threads, including the caller.
+ *-----------------------------------------------------------------------------
+ */
+
+int get_thread_count(){
+	return pool_threads;
+}
+
+/*-----------------------------------------------------------------------------
+ *  parallel_for  --  runs task(t) for 0 <= t < ntasks on the pool and returns
+ *                    when all of them have finished.
+ *-----------------------------------------------------------------------------
+ */
+
+void parallel_for(int ntasks, const function<void(int)> & task){
+	if(workers.empty() || ntasks <= 1){
+		for(int t = 0; t < ntasks; t++){ task(t); }
+		return;
+	}
+
+	lock_guard<mutex> call_lock(call_mutex);
+	{
+		lock_guard<mutex> lock(pool_mutex);
+		job = &task;
+		job_tasks = ntasks;
+		pending = workers.size();
+		generation++;
+	}
+	start_cv.notify_all();
+
+	run_tasks(0, pool_threads);
+
+	unique_lock<mutex> lock(pool_mutex);
+	done_cv.wait(lock, []{ return pending == 0; });
+	job = 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *  pair_task_count  --  the number of tasks worth using for a force
+ *                       calculation with npairs pair interactions: one per
+ *                       thread, but never so many that a task would get
+ *                       fewer than MIN_PAIRS_PER_TASK pairs, since waking the
+ *                       pool costs about as much as a few thousand pairs.
+ *-----------------------------------------------------------------------------
+ */
+
+int pair_task_count(double npairs){
+	int ntasks = npairs / MIN_PAIRS_PER_TASK;
+	if(ntasks > pool_threads){ ntasks = pool_threads; }
+	return ntasks < 1 ? 1 : ntasks;
+}
+
+/*-----------------------------------------------------------------------------
+ *  balance_pair_rows  --  splits the rows 0 <= i < n of the triangular pair
+ *                         loop {i, j > i} into nparts contiguous blocks with
+ *                         close to equal numbers of pairs.  Block t covers
+ *                         rows bounds[t] <= i < bounds[t+1].
+ *-----------------------------------------------------------------------------
+ */
+
+void balance_pair_rows(int n, int nparts, int bounds[]){
+	double npairs = 0.5 * n * (n - 1);
+	int i = 0;
+	double done = 0;          // pairs in rows before i
+	bounds[0] = 0;
+	for(int t = 1; t < nparts; t++){
+		double target = npairs * t / nparts;
+		while(i < n && done + 0.5*(n - 1 - i) <= target){
+			done += n - 1 - i;
+			i++;
+		}
+		bounds[t] = i;
+	}
+	bounds[nparts] = n;
+}
+
+/*-----------------------------------------------------------------------------
+ *  steal_for  --  runs task(t) for 0 <= t < ntasks on nthreads threads of its
+ *                 own (the caller included), for tasks of very different
+ *                 and unknown lengths, such as whole integrations.
+ *
+ *  Every thread starts with a contiguous share of the tasks in a deque of
+ *  its own, takes tasks from the front, and when it runs out steals from the
+ *  back of another thread's deque, so threads that finish early take over
+ *  the remaining work of the others.  Unlike parallel_for(), which task runs
+ *  where depends on timing, and the threads are started for this call only;
+ *  tasks may use parallel_for() themselves only if the pool has a single
+ *  thread.
+ *-----------------------------------------------------------------------------
+ */
+
+void steal_for(int ntasks, int nthreads, const function<void(int)> & task){
+	if(nthreads > ntasks){ nthreads = ntasks; }
+	if(nthreads <= 1){
+		for(int t = 0; t < ntasks; t++){ task(t); }
+		return;
+	}
+
+	vector<deque<int>> queues(nthreads);
+	vector<mutex> locks(nthreads);
+	for(int t = 0; t < ntasks; t++){
+		queues[(long long) t * nthreads / ntasks].push_back(t);
+	}
+
+	auto run = [&](int id){
+		for(;;){
+			int t = -1;
+			{
+				lock_guard<mutex> lock(locks[id]);
+				if(!queues[id].empty()){
+					t = queues[id].front();
+					queues[id].pop_front();
+				}
+			}
+			for(int v = 1; t < 0 && v < nthreads; v++){
+				int victim = (id + v) % nthreads;
+				lock_guard<mutex> lock(locks[victim]);
+				if(!queues[victim].empty()){
+					t = queues[victim].back();
+					queues[victim].pop_back();
+				}
+			}
+			if(t < 0){ return; }     // nothing left anywhere
+			task(t);
+		}
+	};
+
+	vector<thread> threads;
+	for(int id = 1; id < nthreads; id++){ threads.push_back(thread(run, id)); }
+	run(0);
+	for(size_t i = 0; i < threads.size(); i++){ threads[i].join(); }
+}
\ No newline at end of file
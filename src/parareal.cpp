@@ -0,0 +1,292 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>      // to include fabs(), etc.
+#include <algorithm>  // for copy() and max()
+#include "nbody.h"
+#include "nbodyio.h"
+#include "evolve.h"
+#include "state.h"
+#include "parareal.h"
+#include "parallel.h"
+#include "writer.h"
+#include "stop.h"
+#include "options.h"
+
+using namespace std;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  parareal.cpp: parallel in time integration of a single system.
+ *
+ *     The threads of -j speed up the force calculation of a single system
+ *     only as long as there are enough pairs to go round; a few bodies
+ *     integrated for a very long time get nothing from them.  Parareal
+ *     splits the time instead: the run is cut into nslices slices of equal
+ *     length, ending at T_1 ... T_N, with states U_k at their ends, and
+ *     two propagators carry a state across one slice,
+ *
+ *        F  the fine one, the Hermite scheme of evolve() with dt_param
+ *        G  a coarse one, the same with coarse_factor times dt_param,
+ *           which takes that many times fewer steps
+ *
+ *     G first sweeps through all slices to give a guess at every U_k.
+ *     Each iteration then runs F over all slices at once, each from the
+ *     current guess at its start, one slice per thread, and corrects the
+ *     guesses in a sweep of G through the slices,
+ *
+ *        U_k+1  =  G(U_k, new)  +  F(U_k, old)  -  G(U_k, old)
+ *
+ *     so that G supplies only the change due to the corrected start of a
+ *     slice, and F the rest.  After iteration j the first j slices are
+ *     exact, so the iterations stop at nslices at the latest, but usually
+ *     long before, once the largest change of a position or velocity,
+ *     relative to the largest one of the state, falls to the tolerance.
+ *     The result is then the serial run to within that tolerance, except
+ *     that the steps are cut short at the slice ends.  That alone moves
+ *     the result by about the error of F, so a tolerance below it is not
+ *     reached before the last iteration.
+ *
+ *     Only the fine sweeps run in parallel, so K iterations on nslices
+ *     threads take roughly the time of K / nslices serial runs, plus that
+ *     of K + 1 coarse runs.  That pays off for few iterations, which needs
+ *     slices that are not much longer than the time over which the system
+ *     forgets its start: the more chaotic the system, the shorter.
+ *
+ *     ref.: Lions, J.-L., Maday, Y. & Turinici, G., 2001, C. R. Acad.
+ *           Sci. Paris, Serie I, 332, 661-668.
+ *
+ *  A state is a flat array of n*NDIM positions followed by n*NDIM
+ *  velocities, and u holds the states at the start and the end of all
+ *  slices one after the other.
+ *-----------------------------------------------------------------------------
+ */
+
+static const real coarse_factor = 16;  // coarse dt_param over the fine one
+
+/*-----------------------------------------------------------------------------
+ *  propagate  --  integrates the state x from time t0 to exactly t1 with the
+ *                 Hermite scheme, shortening the last step to end at t1,
+ *                 and returns the number of steps taken.
+ *-----------------------------------------------------------------------------
+ */
+
+long long propagate(const real mass[], real x[], int n, real t0, real t1,
+					real dt_param){
+	int nv = n * NDIM;
+	particle_state s;
+	s.reserve(n);
+	copy(x, x + nv, &s.pos[0][0]);
+	copy(x + nv, x + 2*nv, &s.vel[0][0]);
+	vector<real> dst(dst_count(mass, n));
+
+	real epot, coll_time;
+	get_acc_jrk_pot_coll(mass, s.pos, s.vel, s.acc, s.jrk, dst.data(), n,
+						 epot, coll_time);
+
+	long long nsteps = 0;
+	real t = t0;
+	while(t < t1){
+		real dt = dt_param * coll_time;
+		bool last = t + dt >= t1;
+		if(last){ dt = t1 - t; }
+		evolve_step(mass, s, dst.data(), n, dt, epot, coll_time);
+		t = last ? t1 : t + dt;
+		nsteps++;
+	}
+
+	copy(&s.pos[0][0], &s.pos[0][0] + nv, x);
+	copy(&s.vel[0][0], &s.vel[0][0] + nv, x + nv);
+	return nsteps;
+}
+
+/*-----------------------------------------------------------------------------
+ *  state_change  --  the largest difference between the states a and b of
+ *                    a position, relative to the largest position in b,
+ *                    or of a velocity, relative to the largest velocity.
+ *-----------------------------------------------------------------------------
+ */
+
+static real state_change(const real a[], const real b[], int n){
+	int nv = n * NDIM;
+	real change = 0;
+	for(int part = 0; part < 2; part++){
+		const real *pa = a + part * nv;
+		const real *pb = b + part * nv;
+		real scale = 0, diff = 0;
+		for(int i = 0; i < nv; i++){
+			scale = max(scale, (real) fabs(pb[i]));
+			diff = max(diff, (real) fabs(pa[i] - pb[i]));
+		}
+		if(scale > 0){ change = max(change, diff / scale); }
+	}
+	return change;
+}
+
+/*-----------------------------------------------------------------------------
+ *  parareal  --  integrates from t0 to t1 in nslices slices, as above, on
+ *                nthreads threads, until the largest change of an
+ *                iteration falls to tol.  u holds the state at t0 on entry,
+ *                and the states at the ends of all slices on return.
+ *                progress(j, change) is called after iteration j.
+ *
+ *  note: the force calculation must be serial (see set_force_threads());
+ *        the threads here run whole slices.
+ *-----------------------------------------------------------------------------
+ */
+
+parareal_result parareal(const real mass[], int n, real t0, real t1,
+						 int nslices, real dt_param, real tol, int nthreads,
+						 vector<real> & u,
+						 const function<void(int, real)> & progress){
+	int len = 2 * n * NDIM;                 // values per state
+	u.resize((size_t) (nslices + 1) * len);
+	vector<real> coarse((size_t) nslices * len);   // G from each start
+	vector<real> fine((size_t) nslices * len);     // F from each start
+	vector<real> next(len);
+	vector<long long> steps(nslices);
+	vector<double> wall(nslices);
+
+	auto slice_time = [&](int k){
+		return k == nslices ? t1 : t0 + (t1 - t0) * k / nslices;
+	};
+	auto state = [&](vector<real> & v, int k){
+		return v.data() + (size_t) k * len;
+	};
+
+	real dt_coarse = dt_param * coarse_factor;
+	for(int k = 0; k < nslices; k++){       // the first guess
+		copy(state(u, k), state(u, k) + len, state(coarse, k));
+		propagate(mass, state(coarse, k), n, slice_time(k),
+				  slice_time(k+1), dt_coarse);
+		copy(state(coarse, k), state(coarse, k) + len, state(u, k+1));
+	}
+
+	parareal_result r;
+	for(int j = 1; j <= nslices; j++){
+		int first = j - 1;                  // slices before it are exact
+		steal_for(nslices - first, nthreads, [&](int task){
+			int k = first + task;
+			auto start = chrono::steady_clock::now();
+			copy(state(u, k), state(u, k) + len, state(fine, k));
+			steps[k] = propagate(mass, state(fine, k), n, slice_time(k),
+								 slice_time(k+1), dt_param);
+			wall[k] = chrono::duration<double>(chrono::steady_clock::now()
+											   - start).count();
+		});
+
+		real change = 0;
+		for(int k = first; k < nslices; k++){
+			if(k == first){                 // its start has not changed
+				copy(state(coarse, k), state(coarse, k) + len, next.begin());
+			}else{
+				copy(state(u, k), state(u, k) + len, next.begin());
+				propagate(mass, next.data(), n, slice_time(k),
+						  slice_time(k+1), dt_coarse);
+			}
+			real *g = state(coarse, k), *f = state(fine, k);
+			real *end = state(u, k+1);
+			for(int i = 0; i < len; i++){
+				real g_new = next[i];
+				next[i] = g_new + (f[i] - g[i]);
+				g[i] = g_new;
+			}
+			change = max(change, state_change(next.data(), end, n));
+			copy(next.begin(), next.end(), end);
+		}
+
+		r.iterations = j;
+		r.change = change;
+		progress(j, change);
+		if(change <= tol){
+			r.converged = true;
+			break;
+		}
+	}
+
+	for(int k = 0; k < nslices; k++){
+		r.steps += steps[k];
+		r.serial_s += wall[k];
+	}
+	return r;
+}
+
+/*-----------------------------------------------------------------------------
+ *  evolve_parareal  --  integrates an N-body system for a total duration
+ *                       dt_tot with parareal() in opt.slices time slices
+ *                       on opt.nthreads threads.
+ *
+ *  Diagnostics are written at the start and the end, with a line after
+ *  every iteration with its largest change and the wall time so far, and a
+ *  summary of the iterations at the end.  The summary estimates the
+ *  speedup from the wall time the fine steps of the last iteration took
+ *  all together, which is about what a serial run would take.  Snapshots
+ *  come at the start and at the end of every slice instead of every
+ *  dt_out, since the states in between are not kept.
+ *-----------------------------------------------------------------------------
+ */
+
+stop_reason evolve_parareal(const real mass[], real pos[][NDIM],
+							real vel[][NDIM], real dst[], int n, real t,
+							const options & opt){
+	int nv = n * NDIM;
+	real (* acc)[NDIM] = new real[n][NDIM];
+	real (* jrk)[NDIM] = new real[n][NDIM];
+
+	real epot, coll_time;
+	get_acc_jrk_pot_coll(mass, pos, vel, acc, jrk, dst, n, epot, coll_time);
+	queue_diagnostics(mass, pos, vel, acc, jrk, n, t, epot, 0, opt.x_flag);
+	queue_snapshot(mass, pos, vel, dst, dst_count(mass, n), n, t);
+	flush_writer();           // the diagnostics above come first
+
+	vector<real> u(2 * nv);
+	copy(&pos[0][0], &pos[0][0] + nv, u.begin());
+	copy(&vel[0][0], &vel[0][0] + nv, u.begin() + nv);
+
+	ostream & dia = *get_output()->dia;
+	auto start = chrono::steady_clock::now();
+	auto elapsed = [&](){
+		return chrono::duration<double>(chrono::steady_clock::now()
+										- start).count();
+	};
+	real t_end = t + opt.dt_tot;
+	parareal_result r = parareal(mass, n, t, t_end, opt.slices, opt.dt_param,
+								 opt.pr_tol, opt.nthreads, u,
+								 [&](int j, real change){
+		dia << "  parareal iteration " << j << ": largest change "
+			<< change << " after " << elapsed() << " s" << endl;
+	});
+	double wall_s = elapsed();
+
+	for(int k = 1; k <= opt.slices; k++){
+		const real *x = u.data() + (size_t) k * 2 * nv;
+		copy(x, x + nv, &pos[0][0]);
+		copy(x + nv, x + 2*nv, &vel[0][0]);
+		real tk = k == opt.slices ? t_end
+				: t + opt.dt_tot * k / opt.slices;
+		get_acc_jrk_pot_coll(mass, pos, vel, acc, jrk, dst, n, epot,
+							 coll_time);
+		queue_snapshot(mass, pos, vel, dst, dst_count(mass, n), n, tk);
+	}
+	queue_diagnostics(mass, pos, vel, acc, jrk, n, t_end, epot,
+					  (int) r.steps, opt.x_flag);
+	flush_writer();           // the diagnostics above come first
+	dia << "  parareal: " << r.iterations << " iterations over "
+		<< opt.slices << " slices, ";
+	if(r.converged){
+		dia << "converged to " << opt.pr_tol;
+	}else{
+		dia << "not converged to " << opt.pr_tol
+			<< ", which leaves every slice exact";
+	}
+	dia << ", in " << wall_s << " s;"
+		<< " the fine steps took " << r.serial_s << " s in all,"
+		<< " a speedup of about " << r.serial_s / wall_s << endl;
+
+	delete[] acc;
+	delete[] jrk;
+	return stop_reason();
+}
+
+}
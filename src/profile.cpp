@@ -0,0 +1,195 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cmath>      // for ilogb()
+#include <cfloat>     // for DBL_MAX
+#include "nbody.h"
+#include "evolve.h"
+#include "profile.h"
+
+using namespace std;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  profile.cpp: counters for the global time step Hermite scheme.
+ *
+ *     With NBODY_PROFILE defined (make PROFILE=1), evolve() and
+ *     evolve_step() measure the wall time of each phase of a step through
+ *     the PROFILE_START() and PROFILE_STOP() macros, and count the steps by
+ *     the binary exponent of their size.  Without it the macros are empty,
+ *     and nothing is measured.  The counters go to the profile of the
+ *     calling thread, set by start_profile(), so concurrent integrations
+ *     are profiled separately; with none set, nothing is counted.
+ *
+ *     The pair of particles whose collision time estimate sets the step is
+ *     not tracked by the force kernels, which would slow down all of them.
+ *     Instead it is found again, from positions and velocities alone, every
+ *     PROFILE_SAMPLE steps: about 1/PROFILE_SAMPLE of the cost of a force
+ *     calculation on average.
+ *
+ *     write_profile() writes all counters as one line of JSON, e.g.
+ *
+ *        {"t":3600,"steps":1200,"wall_s":0.51,"steps_per_s":2353,
+ *         "phase_s":{"predict":0.01,"force":0.45,"correct":0.01,
+ *         "output":0.02,"other":0.02},"dt_log2":{"-3":1000,"-2":200},
+ *         "limit_pair":[1,2],"limit_pairs":{"1-2":18,"0-1":1},
+ *         "snapshot_bytes":44100,"final":false}
+ *
+ *     all on one line, where dt_log2 counts the steps with
+ *     2^k <= dt < 2^(k+1) for each k, and limit_pairs counts how often each
+ *     pair was found to limit the step.
+ *-----------------------------------------------------------------------------
+ */
+
+const int PROFILE_SAMPLE = 64;    // steps between samples of the limiting pair
+
+static const char *phase_names[PROF_NPHASE] = {"predict", "force", "correct",
+											   "output"};
+
+static thread_local profile *current = 0;
+
+static double now(){
+	return chrono::duration<double>(chrono::steady_clock::now()
+									.time_since_epoch()).count();
+}
+
+/*-----------------------------------------------------------------------------
+ *  start_profile  --  clears p and makes it the profile of the calling
+ *                     thread, with its JSON lines going to out.
+ *-----------------------------------------------------------------------------
+ */
+
+void start_profile(profile & p, ostream & out){
+	p.out = &out;
+	p.start = now();
+	for(int ph = 0; ph < PROF_NPHASE; ph++){ p.phase[ph] = 0; }
+	p.steps = 0;
+	p.dt_hist.clear();
+	p.limit_i = p.limit_j = -1;
+	p.limits.clear();
+	current = &p;
+}
+
+profile *get_profile(){
+	return current;
+}
+
+/*-----------------------------------------------------------------------------
+ *  profile_clock, profile_add  --  the start of a phase, and the time since
+ *                                  then added to the phase.  Both do
+ *                                  nothing without a profile.
+ *-----------------------------------------------------------------------------
+ */
+
+double profile_clock(){
+	return current ? now() : 0;
+}
+
+void profile_add(profile_phase phase, double since){
+	if(current){ current->phase[phase] += now() - since; }
+}
+
+/*-----------------------------------------------------------------------------
+ *  limit_pair  --  finds the pair with the smallest collision time estimate,
+ *                  as computed by the force kernels: the massive pairs, and
+ *                  with test particles if they take part (see
+ *                  set_test_particles()).
+ *-----------------------------------------------------------------------------
+ */
+
+static void limit_pair(const real mass[], const real pos[][NDIM],
+					   const real vel[][NDIM], int n, int & li, int & lj){
+	int nm = massive_count(mass, n);
+	int jmax = test_particle_coll() ? n : nm;
+	real coll_time_q = DBL_MAX;
+	for(int i = 0; i < nm; i++){
+		for(int j = i+1; j < jmax; j++){
+			real r2 = 0, v2 = 0;
+			for(int k = 0; k < NDIM; k++){
+				real dr = pos[j][k] - pos[i][k];
+				real dv = vel[j][k] - vel[i][k];
+				r2 += dr * dr;
+				v2 += dv * dv;
+			}
+			real mij = mass[i] + mass[j];
+			real est_q = (r2*r2) / (v2*v2);              // linear motion
+			real fall_q = G * r2*r2*r2 / (mij*mij);      // free fall
+			if(fall_q < est_q){ est_q = fall_q; }
+			if(est_q < coll_time_q){
+				coll_time_q = est_q;
+				li = i;
+				lj = j;
+			}
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  profile_step  --  counts a step of size dt, which ended with the given
+ *                    positions and velocities.
+ *-----------------------------------------------------------------------------
+ */
+
+void profile_step(const real mass[], const real pos[][NDIM],
+				  const real vel[][NDIM], int n, real dt){
+	profile *p = current;
+	if(!p){ return; }
+	p->dt_hist[ilogb(dt)]++;
+	if(p->steps++ % PROFILE_SAMPLE == 0){
+		limit_pair(mass, pos, vel, n, p->limit_i, p->limit_j);
+		p->limits[make_pair(p->limit_i, p->limit_j)]++;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  write_profile  --  writes the counters at time t as a line of JSON, with
+ *                     the snapshot bytes written so far; final marks the
+ *                     last line of a run.
+ *-----------------------------------------------------------------------------
+ */
+
+void write_profile(real t, long long bytes, bool final){
+	profile *p = current;
+	if(!p){ return; }
+	double wall = now() - p->start;
+	double other = wall;
+
+	ostringstream line;
+	line << "{\"t\":" << t << ",\"steps\":" << p->steps
+		 << ",\"wall_s\":" << wall
+		 << ",\"steps_per_s\":" << (wall > 0 ? p->steps / wall : 0)
+		 << ",\"phase_s\":{";
+	for(int ph = 0; ph < PROF_NPHASE; ph++){
+		line << '"' << phase_names[ph] << "\":" << p->phase[ph] << ',';
+		other -= p->phase[ph];
+	}
+	line << "\"other\":" << other << "},\"dt_log2\":{";
+	const char *sep = "";
+	for(auto & h : p->dt_hist){
+		line << sep << '"' << h.first << "\":" << h.second;
+		sep = ",";
+	}
+	line << "},\"limit_pair\":[" << p->limit_i << ',' << p->limit_j
+		 << "],\"limit_pairs\":{";
+	sep = "";
+	for(auto & l : p->limits){
+		line << sep << '"' << l.first.first << '-' << l.first.second
+			 << "\":" << l.second;
+		sep = ",";
+	}
+	line << "},\"snapshot_bytes\":" << bytes
+		 << ",\"final\":" << (final ? "true" : "false") << "}\n";
+	*p->out << line.str() << flush;
+}
+
+/*-----------------------------------------------------------------------------
+ *  stop_profile  --  leaves the calling thread without a profile.
+ *-----------------------------------------------------------------------------
+ */
+
+void stop_profile(){
+	current = 0;
+}
+
+}
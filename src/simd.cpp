@@ -0,0 +1,699 @@
+#include <cmath>      // to include sqrt(), etc.
+#include <cfloat>     // for DBL_MAX
+#include <cstdlib>    // for aligned_alloc() and free()
+#include "nbody.h"
+#include "evolve.h"
+#include "simd.h"
+#include "batch.h"
+#include "parallel.h"
+
+// There are no vector instructions for long double, so the long double
+// variants (see nbody.h) always fall back to the scalar kernel.
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(NBODY_LONG_DOUBLE)
+#include <immintrin.h>
+#define SIMD_X86
+#endif
+
+// The generic kernel below passes vectors by value, but it is only ever
+// inlined into the ISA-specific entry points, so no call crosses an ABI
+// boundary with vector arguments.
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+using namespace std;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  simd.cpp: a vectorized version of get_acc_jrk_pot_coll().
+ *
+ *     The particle data is copied into a structure-of-arrays layout, one
+ *     contiguous array per coordinate, so that W consecutive partners j of a
+ *     particle i can be loaded, processed and stored as a single vector.  The
+ *     arithmetic is the same as in the scalar kernel, but the per-row sums
+ *     are accumulated lane by lane and only added together at the end of the
+ *     row, so results agree with the scalar kernel to rounding, not bit for
+ *     bit.  The kernel width is picked at run time from what the processor
+ *     supports: AVX-512 (8 doubles), AVX2 (4 doubles), or otherwise the
+ *     scalar kernel itself.
+ *
+ *     With more than one thread the rows are split as in
+ *     get_acc_jrk_pot_coll_parallel(): each task accumulates into its own
+ *     arrays, which are summed in task order at the end.
+ *
+ *     Test particles (see test_rows() in evolve.cpp) are vectorized the
+ *     other way round: W test particles at a time against one massive
+ *     particle, since there are no reactions to store.
+ *
+ *     For systems of a handful of particles, where a row has no W partners
+ *     to fill a vector, batch_step() vectorizes across systems instead: the
+ *     lanes of each vector hold the same particle in W independent systems
+ *     (see batch_state in batch.cpp), each advanced by its own time step.
+ *-----------------------------------------------------------------------------
+ */
+
+/*-----------------------------------------------------------------------------
+ *  soa_buffer  --  scratch storage for the structure-of-arrays copy of the
+ *                  particle data, plus acceleration and jerk arrays for each
+ *                  task, grown as needed and kept between calls.  One per
+ *                  calling thread, so concurrent integrations do not share.
+ *-----------------------------------------------------------------------------
+ */
+
+struct soa_buffer {
+	int cap, tasks;
+	real *block;
+	real *m;
+	real *x[NDIM], *v[NDIM];   // positions and velocities
+	real *aj;                  // accelerations and jerks, per task
+
+	soa_buffer() : cap(0), tasks(0), block(0) {}
+	~soa_buffer(){ free(block); }
+
+	void reserve(int n, int ntasks){
+		if(n <= cap && ntasks <= tasks){ return; }
+		free(block);
+		cap = (n + 7) & ~7;    // whole 64-byte lines per array
+		tasks = ntasks;
+		block = (real *) aligned_alloc(64, (2*NDIM*(tasks + 1) + 1)
+										   * cap * sizeof(real));
+		real *p = block;
+		m = p; p += cap;
+		for(int k = 0; k < NDIM; k++){
+			x[k] = p; p += cap;
+			v[k] = p; p += cap;
+		}
+		aj = p;
+	}
+
+	real *acc(int t, int k) const { return aj + (2*t*NDIM + k) * cap; }
+	real *jrk(int t, int k) const { return aj + ((2*t + 1)*NDIM + k) * cap; }
+};
+
+static thread_local soa_buffer scratch;
+
+template<class V>
+static inline V vload(const real *p){
+	V v;
+	__builtin_memcpy(&v, p, sizeof(V));
+	return v;
+}
+
+template<class V>
+static inline void vstore(real *p, V v){
+	__builtin_memcpy(p, &v, sizeof(V));
+}
+
+static inline real vsqrt(real x){
+	return sqrt(x);
+}
+
+#ifdef SIMD_X86
+
+typedef real v256 __attribute__((vector_size(32)));
+typedef real v512 __attribute__((vector_size(64)));
+
+__attribute__((target("avx2,fma")))
+static inline v256 vsqrt(v256 x){
+	return (v256) _mm256_sqrt_pd((__m256d) x);
+}
+
+__attribute__((target("avx512f")))
+static inline v512 vsqrt(v512 x){
+	return (v512) _mm512_mask_sqrt_pd((__m512d) x, (__mmask8) -1, (__m512d) x);
+}
+
+template<class V>
+static inline real hsum(V v){
+	real s = 0;
+	for(unsigned l = 0; l < sizeof(V)/sizeof(real); l++){ s += v[l]; }
+	return s;
+}
+
+template<class V>
+static inline real hmin(V v){
+	real s = v[0];
+	for(unsigned l = 1; l < sizeof(V)/sizeof(real); l++){
+		if(s > v[l]){ s = v[l]; }
+	}
+	return s;
+}
+
+/*-----------------------------------------------------------------------------
+ *  soa_kernel  --  the pairwise double loop over the nm massive particles in
+ *                  the structure-of-arrays data, for rows i0 <= i < i1, W
+ *                  partners j at a time, accumulating into the arrays of
+ *                  task t.  The partners left over at the end of each row
+ *                  are done one by one exactly as in the scalar kernel.
+ *                  Rows of dst[] are w long, as in pair_rows().
+ *-----------------------------------------------------------------------------
+ */
+
+template<class V>
+static inline __attribute__((always_inline))
+void soa_kernel(const soa_buffer & soa, int t, real dst[], int nm, int w,
+				int i0, int i1, real & epot, real & coll_time_q){
+	const int W = sizeof(V)/sizeof(real);
+
+	real *acc[NDIM], *jrk[NDIM];   // this task's output arrays
+	for(int k = 0; k < NDIM; k++){
+		acc[k] = soa.acc(t, k);
+		jrk[k] = soa.jrk(t, k);
+	}
+
+	V ep = {};                // potential energy, per lane
+	V cq = {};                // collision time estimate (quartic), per lane
+	cq += DBL_MAX;
+
+	for(int i = i0; i < i1; i++){
+		int p = dst_row(i, w);         // index of pair {i, i+1} in dst
+		real mi = soa.m[i];
+
+		V xi[NDIM], vi[NDIM], ai[NDIM], ji[NDIM];
+		for(int k = 0; k < NDIM; k++){
+			xi[k] = V{} + soa.x[k][i];
+			vi[k] = V{} + soa.v[k][i];
+			ai[k] = ji[k] = V{};
+		}
+
+		int j = i+1;
+		for(; j + W <= nm; j += W, p += W){
+			V rji[NDIM], vji[NDIM];
+			V r2 = {}, v2 = {}, rv_r2 = {};
+
+			for(int k = 0; k < NDIM; k++){
+				rji[k] = vload<V>(soa.x[k] + j) - xi[k];
+				vji[k] = vload<V>(soa.v[k] + j) - vi[k];
+
+				r2 += rji[k] * rji[k];
+				v2 += vji[k] * vji[k];
+				rv_r2 += rji[k] * vji[k];
+			}
+
+			rv_r2 /= r2;
+			V r = vsqrt(r2);
+			V r3 = r * r2;
+
+			vstore(dst + p, r);
+
+			V mj = vload<V>(soa.m + j);
+			V da2 = {};
+			for(int k = 0; k < NDIM; k++){
+				V da = rji[k] / r3;
+				V dj = (vji[k] - 3 * rv_r2 * rji[k]) / r3;
+
+				da2 += da*da;
+
+				ai[k] += mj * da;
+				ji[k] += mj * dj;
+				vstore(acc[k] + j, vload<V>(acc[k] + j) - mi * da);
+				vstore(jrk[k] + j, vload<V>(jrk[k] + j) - mi * dj);
+			}
+
+			ep -= mi * mj / r;
+
+			V coll_est_q = (r2*r2) / (v2*v2);
+			cq = coll_est_q < cq ? coll_est_q : cq;
+
+			V mij = mi + mj;
+			coll_est_q = G*r2/(da2*mij*mij);
+			cq = coll_est_q < cq ? coll_est_q : cq;
+		}
+
+		for(int k = 0; k < NDIM; k++){
+			acc[k][i] += hsum(ai[k]);
+			jrk[k][i] += hsum(ji[k]);
+		}
+
+		for(; j < nm; j++, p++){
+			real rji[NDIM], vji[NDIM];
+			real r2 = 0, v2 = 0, rv_r2 = 0;
+
+			for(int k = 0; k < NDIM; k++){
+				rji[k] = soa.x[k][j] - soa.x[k][i];
+				vji[k] = soa.v[k][j] - soa.v[k][i];
+
+				r2 += rji[k] * rji[k];
+				v2 += vji[k] * vji[k];
+				rv_r2 += rji[k] * vji[k];
+			}
+
+			rv_r2 /= r2;
+			real r = sqrt(r2);
+			real r3 = r * r2;
+
+			dst[p] = r;
+
+			real mj = soa.m[j];
+			real da2 = 0;
+			for(int k = 0; k < NDIM; k++){
+				real da = rji[k] / r3;
+				real dj = (vji[k] - 3 * rv_r2 * rji[k]) / r3;
+
+				da2 += da*da;
+
+				acc[k][i] += mj * da;
+				acc[k][j] -= mi * da;
+				jrk[k][i] += mj * dj;
+				jrk[k][j] -= mi * dj;
+			}
+
+			epot -= mi * mj / r;
+
+			real coll_est_q = (r2*r2) / (v2*v2);
+			if(coll_time_q > coll_est_q){ coll_time_q = coll_est_q; }
+
+			real mij = mi + mj;
+			coll_est_q = G*r2/(da2*mij*mij);
+			if(coll_time_q > coll_est_q){ coll_time_q = coll_est_q; }
+		}
+	}
+
+	epot += hsum(ep);
+	real c = hmin(cq);
+	if(coll_time_q > c){ coll_time_q = c; }
+}
+
+/*-----------------------------------------------------------------------------
+ *  soa_test_kernel  --  the forces on the test particles j0 <= j < j1 due to
+ *                       the nm massive ones, W test particles at a time,
+ *                       written straight to acc and jrk.  Also fills in
+ *                       their distances if with_dst, and lowers coll_time_q
+ *                       if with_coll, as test_rows() does.  Returns the
+ *                       first test particle not done; the caller finishes
+ *                       the rest with test_rows().
+ *-----------------------------------------------------------------------------
+ */
+
+template<class V>
+static inline __attribute__((always_inline))
+int soa_test_kernel(const soa_buffer & soa, real acc[][NDIM],
+					real jrk[][NDIM], real dst[], int n, int nm, int j0,
+					int j1, bool with_dst, bool with_coll,
+					real & coll_time_q){
+	const int W = sizeof(V)/sizeof(real);
+
+	V cq = {};
+	cq += DBL_MAX;
+
+	int j = j0;
+	for(; j + W <= j1; j += W){
+		V xj[NDIM], vj[NDIM], aj[NDIM], jj[NDIM];
+		for(int k = 0; k < NDIM; k++){
+			xj[k] = vload<V>(soa.x[k] + j);
+			vj[k] = vload<V>(soa.v[k] + j);
+			aj[k] = jj[k] = V{};
+		}
+
+		for(int i = 0; i < nm; i++){
+			V rji[NDIM], vji[NDIM];
+			V r2 = {}, v2 = {}, rv_r2 = {};
+
+			for(int k = 0; k < NDIM; k++){
+				rji[k] = xj[k] - soa.x[k][i];
+				vji[k] = vj[k] - soa.v[k][i];
+
+				r2 += rji[k] * rji[k];
+				v2 += vji[k] * vji[k];
+				rv_r2 += rji[k] * vji[k];
+			}
+
+			rv_r2 /= r2;
+			V r = vsqrt(r2);
+			V r3 = r * r2;
+
+			if(with_dst){ vstore(dst + dst_row(i, n) + j - i - 1, r); }
+
+			real mi = soa.m[i];
+			V da2 = {};
+			for(int k = 0; k < NDIM; k++){
+				V da = rji[k] / r3;
+				V dj = (vji[k] - 3 * rv_r2 * rji[k]) / r3;
+
+				da2 += da*da;
+
+				aj[k] -= mi * da;
+				jj[k] -= mi * dj;
+			}
+
+			if(with_coll){
+				V coll_est_q = (r2*r2) / (v2*v2);
+				cq = coll_est_q < cq ? coll_est_q : cq;
+
+				coll_est_q = G*r2/(da2*mi*mi);
+				cq = coll_est_q < cq ? coll_est_q : cq;
+			}
+		}
+
+		for(int l = 0; l < W; l++){
+			for(int k = 0; k < NDIM; k++){
+				acc[j+l][k] = aj[k][l];
+				jrk[j+l][k] = jj[k][l];
+			}
+		}
+
+		if(!with_dst){ continue; }
+		for(int l = j; l < j + W; l++){       // distances to later test
+			int p = dst_row(l, n);            // particles, W at a time
+			int m = l+1;
+			for(; m + W <= n; m += W, p += W){
+				V r2 = {};
+				for(int k = 0; k < NDIM; k++){
+					V d = vload<V>(soa.x[k] + m) - soa.x[k][l];
+					r2 += d * d;
+				}
+				vstore(dst + p, vsqrt(r2));
+			}
+			for(; m < n; m++, p++){
+				real r2 = 0;
+				for(int k = 0; k < NDIM; k++){
+					real d = soa.x[k][m] - soa.x[k][l];
+					r2 += d * d;
+				}
+				dst[p] = sqrt(r2);
+			}
+		}
+	}
+
+	real c = hmin(cq);
+	if(coll_time_q > c){ coll_time_q = c; }
+	return j;
+}
+
+__attribute__((target("avx2,fma")))
+static void soa_kernel_avx2(const soa_buffer & soa, int t, real dst[], int nm,
+							int w, int i0, int i1,
+							real & epot, real & coll_time_q){
+	soa_kernel<v256>(soa, t, dst, nm, w, i0, i1, epot, coll_time_q);
+}
+
+__attribute__((target("avx2,fma")))
+static int soa_test_kernel_avx2(const soa_buffer & soa, real acc[][NDIM],
+								real jrk[][NDIM], real dst[], int n, int nm,
+								int j0, int j1, bool with_dst, bool with_coll,
+								real & coll_time_q){
+	return soa_test_kernel<v256>(soa, acc, jrk, dst, n, nm, j0, j1,
+								 with_dst, with_coll, coll_time_q);
+}
+
+__attribute__((target("avx512f")))
+static void soa_kernel_avx512(const soa_buffer & soa, int t, real dst[],
+							  int nm, int w, int i0, int i1,
+							  real & epot, real & coll_time_q){
+	soa_kernel<v512>(soa, t, dst, nm, w, i0, i1, epot, coll_time_q);
+}
+
+__attribute__((target("avx512f")))
+static int soa_test_kernel_avx512(const soa_buffer & soa, real acc[][NDIM],
+								  real jrk[][NDIM], real dst[], int n, int nm,
+								  int j0, int j1, bool with_dst,
+								  bool with_coll, real & coll_time_q){
+	return soa_test_kernel<v512>(soa, acc, jrk, dst, n, nm, j0, j1,
+								 with_dst, with_coll, coll_time_q);
+}
+
+#endif
+
+typedef void (*soa_kernel_fn)(const soa_buffer &, int, real [], int, int,
+							  int, int, real &, real &);
+typedef int (*soa_test_kernel_fn)(const soa_buffer &, real [][NDIM],
+								  real [][NDIM], real [], int, int, int, int,
+								  bool, bool, real &);
+
+/*-----------------------------------------------------------------------------
+ *  pick_kernel  --  chooses the widest kernel the processor supports, once,
+ *                   together with the matching test particle kernel.
+ *                   Returns a null pointer when there is none, in which case
+ *                   the scalar kernel is used instead.
+ *-----------------------------------------------------------------------------
+ */
+
+static soa_kernel_fn pick_kernel(const char * & name,
+								 soa_test_kernel_fn & test){
+#ifdef SIMD_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f")){
+		name = "AVX-512";
+		test = soa_test_kernel_avx512;
+		return soa_kernel_avx512;
+	}
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+		name = "AVX2";
+		test = soa_test_kernel_avx2;
+		return soa_kernel_avx2;
+	}
+#endif
+	name = "scalar";
+	test = 0;
+	return 0;
+}
+
+static const char *kernel_name = 0;
+static soa_test_kernel_fn test_kernel = 0;
+static soa_kernel_fn kernel = pick_kernel(kernel_name, test_kernel);
+
+/*-----------------------------------------------------------------------------
+ *  simd_kernel_name  --  names the kernel picked for this processor.
+ *-----------------------------------------------------------------------------
+ */
+
+const char *simd_kernel_name(){
+	return kernel_name;
+}
+
+/*-----------------------------------------------------------------------------
+ *  get_acc_jrk_pot_coll_simd  --  same interface and results as
+ *                                 get_acc_jrk_pot_coll(), computed with the
+ *                                 vectorized kernel.
+ *-----------------------------------------------------------------------------
+ */
+
+void get_acc_jrk_pot_coll_simd(const real mass[], const real pos[][NDIM],
+							   const real vel[][NDIM], real acc[][NDIM],
+							   real jrk[][NDIM], real dst[], int n,
+							   real & epot, real & coll_time){
+	int nm = massive_count(mass, n);
+	int w = dst_width(nm, n);
+	bool with_dst = test_particle_dst();
+	bool with_coll = test_particle_coll();
+	int ntasks = pair_task_count(0.5*n*(n-1) - 0.5*(n-nm)*(n-nm-1));
+	if(!kernel){
+		if(ntasks > 1){
+			get_acc_jrk_pot_coll_parallel(mass, pos, vel, acc, jrk, dst, n,
+										  epot, coll_time);
+		}else{
+			get_acc_jrk_pot_coll_scalar(mass, pos, vel, acc, jrk, dst, n,
+										epot, coll_time);
+		}
+		return;
+	}
+
+	scratch.reserve(n, ntasks);
+	for(int i = 0; i < n; i++){
+		scratch.m[i] = mass[i];
+		for(int k = 0; k < NDIM; k++){
+			scratch.x[k][i] = pos[i][k];
+			scratch.v[k][i] = vel[i][k];
+		}
+	}
+
+	int *bounds = new int[ntasks + 1];
+	real *task_epot = new real[ntasks];
+	real *task_coll_q = new real[ntasks];
+	balance_pair_rows(nm, ntasks, bounds);
+
+	const soa_buffer & buf = scratch;
+	parallel_for(ntasks, [&](int t){
+		for(int k = 0; k < NDIM; k++){
+			real *a = buf.acc(t, k), *j = buf.jrk(t, k);
+			for(int i = 0; i < nm; i++){ a[i] = j[i] = 0; }
+		}
+		task_epot[t] = 0;
+		task_coll_q[t] = DBL_MAX;
+		kernel(buf, t, dst, nm, w, bounds[t], bounds[t+1],
+			   task_epot[t], task_coll_q[t]);
+
+		int j0 = nm + (long long) (n - nm) * t / ntasks;
+		int j1 = nm + (long long) (n - nm) * (t+1) / ntasks;
+		j0 = test_kernel(buf, acc, jrk, dst, n, nm, j0, j1,
+						 with_dst, with_coll, task_coll_q[t]);
+		test_rows(mass, pos, vel, acc, jrk, dst, n, nm, j0, j1,
+				  task_coll_q[t]);
+	});
+
+	parallel_for(ntasks, [&](int t){
+		int i1 = (long long) nm * (t+1) / ntasks;
+		for(int i = (long long) nm * t / ntasks; i < i1; i++){
+			for(int k = 0; k < NDIM; k++){
+				real a = 0, j = 0;
+				for(int s = 0; s < ntasks; s++){
+					a += buf.acc(s, k)[i];
+					j += buf.jrk(s, k)[i];
+				}
+				acc[i][k] = a;
+				jrk[i][k] = j;
+			}
+		}
+	});
+
+	epot = 0;
+	real coll_time_q = DBL_MAX;
+	for(int t = 0; t < ntasks; t++){
+		epot += task_epot[t];
+		if(coll_time_q > task_coll_q[t]){ coll_time_q = task_coll_q[t]; }
+	}
+	coll_time = sqrt(sqrt(coll_time_q));
+
+	delete[] bounds;
+	delete[] task_epot;
+	delete[] task_coll_q;
+}
+
+/*-----------------------------------------------------------------------------
+ *  batch_kernel  --  one Hermite step of all W systems of a batch_state,
+ *                    each by its own time step, W = the lanes of V: the
+ *                    predictor and corrector of evolve.h and the pairwise
+ *                    loop of pair_rows(), on vectors of one value of every
+ *                    system.  With V = real, W = 1, it is the scalar loop.
+ *                    Lanes with a time step of 0 stay where they are.
+ *-----------------------------------------------------------------------------
+ */
+
+template<class V>
+static inline __attribute__((always_inline))
+void batch_kernel(batch_state & b){
+	const int W = sizeof(V)/sizeof(real);
+	int n = b.n;
+
+	b.swap();
+	V dt = vload<V>(b.dt);
+	for(int q = 0; q < n*NDIM*W; q += W){
+		V pos, vel;
+		hermite_predict(vload<V>(b.old_pos + q), vload<V>(b.old_vel + q),
+						vload<V>(b.old_acc + q), vload<V>(b.old_jrk + q), dt,
+						pos, vel);
+		vstore(b.pos + q, pos);
+		vstore(b.vel + q, vel);
+		vstore(b.acc + q, V{});
+		vstore(b.jrk + q, V{});
+	}
+
+	V ep = {};                // potential energy
+	V cq = {};                // collision time estimate (quartic)
+	cq += DBL_MAX;
+	int p = 0;                // index of pair {i, j} in dst
+	for(int i = 0; i < n; i++){
+		V mi = vload<V>(b.mass + i*W);
+		for(int j = i+1; j < n; j++, p++){
+			V rji[NDIM], vji[NDIM];
+			V r2 = {}, v2 = {}, rv_r2 = {};
+
+			for(int k = 0; k < NDIM; k++){
+				rji[k] = vload<V>(b.pos + (j*NDIM + k)*W)
+					   - vload<V>(b.pos + (i*NDIM + k)*W);
+				vji[k] = vload<V>(b.vel + (j*NDIM + k)*W)
+					   - vload<V>(b.vel + (i*NDIM + k)*W);
+
+				r2 += rji[k] * rji[k];
+				v2 += vji[k] * vji[k];
+				rv_r2 += rji[k] * vji[k];
+			}
+
+			rv_r2 /= r2;
+			V r = vsqrt(r2);
+			V r3 = r * r2;
+
+			vstore(b.dst + p*W, r);
+
+			V mj = vload<V>(b.mass + j*W);
+			V da2 = {};
+			for(int k = 0; k < NDIM; k++){
+				V da = rji[k] / r3;
+				V dj = (vji[k] - 3 * rv_r2 * rji[k]) / r3;
+
+				da2 += da*da;
+
+				real *ai = b.acc + (i*NDIM + k)*W, *aj = b.acc + (j*NDIM + k)*W;
+				real *ji = b.jrk + (i*NDIM + k)*W, *jj = b.jrk + (j*NDIM + k)*W;
+				vstore(ai, vload<V>(ai) + mj * da);
+				vstore(aj, vload<V>(aj) - mi * da);
+				vstore(ji, vload<V>(ji) + mj * dj);
+				vstore(jj, vload<V>(jj) - mi * dj);
+			}
+
+			ep -= mi * mj / r;
+
+			V coll_est_q = (r2*r2) / (v2*v2);
+			cq = coll_est_q < cq ? coll_est_q : cq;
+
+			V mij = mi + mj;
+			coll_est_q = G*r2/(da2*mij*mij);
+			cq = coll_est_q < cq ? coll_est_q : cq;
+		}
+	}
+	vstore(b.epot, ep);
+	vstore(b.coll_time, vsqrt(vsqrt(cq)));
+
+	for(int q = 0; q < n*NDIM*W; q += W){
+		V pos, vel;
+		hermite_correct(vload<V>(b.old_pos + q), vload<V>(b.old_vel + q),
+						vload<V>(b.old_acc + q), vload<V>(b.old_jrk + q),
+						vload<V>(b.acc + q), vload<V>(b.jrk + q), dt,
+						pos, vel);
+		vstore(b.pos + q, pos);
+		vstore(b.vel + q, vel);
+	}
+}
+
+static void batch_kernel_scalar(batch_state & b){
+	batch_kernel<real>(b);
+}
+
+#ifdef SIMD_X86
+
+__attribute__((target("avx2,fma")))
+static void batch_kernel_avx2(batch_state & b){
+	batch_kernel<v256>(b);
+}
+
+__attribute__((target("avx512f")))
+static void batch_kernel_avx512(batch_state & b){
+	batch_kernel<v512>(b);
+}
+
+#endif
+
+/*-----------------------------------------------------------------------------
+ *  batch_width  --  the number of lanes of the batch kernel picked for this
+ *                   processor, the width of the vectors of the force
+ *                   kernel; 1 if there is none.
+ *-----------------------------------------------------------------------------
+ */
+
+int batch_width(){
+#ifdef SIMD_X86
+	if(kernel == soa_kernel_avx512){ return 8; }
+	if(kernel == soa_kernel_avx2){ return 4; }
+#endif
+	return 1;
+}
+
+const char *batch_kernel_name(){
+	return kernel_name;
+}
+
+/*-----------------------------------------------------------------------------
+ *  batch_step  --  takes one Hermite step of every lane of b, by the time
+ *                  steps in b.dt, which must hold batch_width() lanes.  The
+ *                  state is swapped first, as in evolve_step().
+ *-----------------------------------------------------------------------------
+ */
+
+void batch_step(batch_state & b){
+#ifdef SIMD_X86
+	if(b.lanes == 8){ batch_kernel_avx512(b); return; }
+	if(b.lanes == 4){ batch_kernel_avx2(b); return; }
+#endif
+	batch_kernel_scalar(b);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+/*=============================================================================
+ *
+ *  snapconv.cpp: converts snapshot files between the text format written by
+ *                nbody by default and the binary format written with -O.
+ *
+ *     usage: snapconv [-n dims] [-Z bound] input output
+ *
+ *     If input is a binary snapshot file, all of its records are written to
+ *     output as text; otherwise input is read as text, and written to output
+ *     as a binary snapshot file.  A text input or output of "-" stands for
+ *     the standard input or output stream; binary output must go to a file.
+ *     With -Z, the binary output is compressed, to a relative error of at
+ *     most bound in positions, velocities and distances, or losslessly for a
+ *     bound of 0; compressed input is recognized by itself.
+ *
+ *     Values are copied exactly both ways, so the text written from a
+ *     binary file run is the same as the text the run would have written.
+ *
+ *     The conversions themselves are in convert.cpp, which is compiled for
+ *     2 and 3 dimensions as nbody is (see nbody.h).  A binary file gives its
+ *     own number of dimensions; text input is read with -n dimensions, 2 by
+ *     default.
+ *=============================================================================
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>    // for atoi() and atof()
+#include <unistd.h>   // for getopt()
+
+using namespace std;
+
+namespace d2 {
+	bool text_to_binary(istream & in, const char *name, double bound);
+	bool binary_to_text(const char *name, ostream & out);
+	int snap_file_ndim(const char *name);
+}
+namespace d3 {
+	bool text_to_binary(istream & in, const char *name, double bound);
+	bool binary_to_text(const char *name, ostream & out);
+}
+
+/*-----------------------------------------------------------------------------
+ *  main  --  converts in whichever direction the input calls for, with the
+ *            variant for its number of dimensions.
+ *-----------------------------------------------------------------------------
+ */
+
+int main(int argc, char *argv[]){
+	int ndim = 2;
+	double bound = -1;           // no compression
+	bool usage = false;
+	int c;
+	while((c = getopt(argc, argv, "n:Z:")) != -1){
+		if(c == 'n'){
+			ndim = atoi(optarg);
+		}else if(c == 'Z'){
+			bound = atof(optarg);
+		}else{
+			usage = true;
+		}
+	}
+	if(usage || argc - optind != 2){
+		cerr << "usage: " << argv[0] << " [-n dims] [-Z bound] input output"
+			 << endl;
+		return 1;
+	}
+	const char *input = argv[optind], *output = argv[optind + 1];
+
+	int file_ndim = strcmp(input, "-") != 0 ? d2::snap_file_ndim(input) : 0;
+	if(file_ndim > 0){ ndim = file_ndim; }
+	if(ndim != 2 && ndim != 3){
+		cerr << argv[0] << ": " << ndim << " dimensions are not supported,"
+			 << " only 2 or 3" << endl;
+		return 1;
+	}
+	auto to_binary = ndim == 3 ? d3::text_to_binary : d2::text_to_binary;
+	auto to_text = ndim == 3 ? d3::binary_to_text : d2::binary_to_text;
+
+	if(file_ndim > 0){
+		if(strcmp(output, "-") == 0){
+			return to_text(input, cout) ? 0 : 1;
+		}
+		ofstream out(output);
+		return to_text(input, out) ? 0 : 1;
+	}
+
+	if(strcmp(output, "-") == 0){
+		cerr << argv[0] << ": binary output must go to a file" << endl;
+		return 1;
+	}
+	if(strcmp(input, "-") == 0){
+		return to_binary(cin, output, bound) ? 0 : 1;
+	}
+	ifstream in(input);
+	if(!in){
+		cerr << argv[0] << ": cannot open " << input << endl;
+		return 1;
+	}
+	return to_binary(in, output, bound) ? 0 : 1;
+}
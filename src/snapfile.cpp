@@ -0,0 +1,391 @@
+#include <iostream>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include "nbody.h"
+#include "snapfile.h"
+
+using namespace std;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  snapfile.cpp: binary snapshot files.
+ *
+ *     A binary alternative to the text snapshot format, much faster to write
+ *     and read, and laid out so that analysis tools can map the file into
+ *     memory and use the records in place (see OrbitData.SnapshotFile):
+ *
+ *        header    struct snap_header, 128 bytes
+ *        record 0  t, mass[n], pos[n][ndim], vel[n][ndim], dst[ndst]
+ *        record 1  ...
+ *        index     t of every record
+ *
+ *     All values are native (little-endian on every machine we run on)
+ *     doubles, the ints in the header are fixed width.  Variants of the
+ *     program that compute in long double (see nbody.h) round to double on
+ *     writing, so that every file can be read by every tool.  Masses are in
+ *     kg as in the text format, and dst[] holds the same distances as the
+ *     last line of a text snapshot.  Since n and ndst are fixed for a
+ *     file, every record has the same size and record r starts at a known
+ *     offset.
+ *
+ *     The time index and the record count in the header are only written
+ *     when the file is closed.  A file left unfinished by a crashed run is
+ *     still usable: readers then count the complete records from the file
+ *     size and take the times from the records themselves.
+ *
+ *     Compressed files (codec SNAP_XOR, written with -Z) have version
+ *     SNAP_VERSION_XOR, which older readers refuse.  Each record is stored
+ *     as a 32-bit byte count followed by the record encoded as described in
+ *     compress.cpp, every key_interval-th of them in full, so that reading
+ *     record r decodes at most key_interval records.  The index holds the
+ *     file offset of every record after the times.  Unfinished compressed
+ *     files are read by following the byte counts.
+ *-----------------------------------------------------------------------------
+ */
+
+static const char SNAP_MAGIC[8] = {'S','O','L','I','A','S','N','P'};
+const int SNAP_VERSION = 1;
+const int SNAP_VERSION_XOR = 2;
+const int SNAP_RAW = 0, SNAP_XOR = 1;          // codecs
+const int SNAP_KEY_INTERVAL = 256;
+
+static bool known_version(const snap_header & h){
+	return memcmp(h.magic, SNAP_MAGIC, sizeof(SNAP_MAGIC)) == 0
+		&& (h.version == SNAP_VERSION
+			|| (h.version == SNAP_VERSION_XOR && h.codec == SNAP_XOR));
+}
+
+static long long record_size(const snap_header & h){
+	return (1 + h.n * (1 + 2*NDIM) + h.ndst) * (long long) sizeof(double);
+}
+
+/*-----------------------------------------------------------------------------
+ *  open_snap_writer  --  creates the binary snapshot file name for records
+ *                        of n particles and ndst distances, to be written
+ *                        through out.  With bound >= 0 the records are
+ *                        compressed, with positions, velocities and
+ *                        distances rounded to a relative error of at most
+ *                        bound, or not at all for a bound of 0.
+ *-----------------------------------------------------------------------------
+ */
+
+bool open_snap_writer(const char *name, int n, int ndst, snap_writer & out,
+					  double bound){
+	out.file = fopen(name, "wb");
+	if(!out.file){
+		cerr << "open_snap_writer: cannot create " << name << endl;
+		return false;
+	}
+
+	snap_header & h = out.head;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, SNAP_MAGIC, sizeof(SNAP_MAGIC));
+	h.version = SNAP_VERSION;
+	h.ndim = NDIM;
+	h.n = n;
+	h.ndst = ndst;
+	h.unit_mass = 1;              // kg
+	h.unit_length = 1;            // m
+	h.unit_time = 1;              // s
+	h.G = G;
+	if(bound >= 0){
+		h.version = SNAP_VERSION_XOR;
+		h.codec = SNAP_XOR;
+		h.keep_bits = keep_bits_for(bound);
+		h.key_interval = SNAP_KEY_INTERVAL;
+	}
+	fwrite(&h, sizeof(h), 1, out.file);
+
+	out.times.clear();
+	out.offsets.clear();
+	out.end = sizeof(h);
+	out.record.resize(record_size(h) / sizeof(double));
+	if(h.codec == SNAP_XOR){
+		start_codec(out.codec, out.record.size(), 1 + n, h.keep_bits);
+	}
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *  put_snap_record  --  appends one record to a snapshot file, with the
+ *                       masses in kg, compressed if the file is.
+ *-----------------------------------------------------------------------------
+ */
+
+void put_snap_record(snap_writer & out, real t, const real mass[],
+					 const real pos[][NDIM], const real vel[][NDIM],
+					 const real dst[]){
+	int n = out.head.n;
+	double *p = out.record.data();
+	*p++ = t;
+	for(int i = 0; i < n; i++){ *p++ = mass[i]; }
+	copy_n(pos[0], n * NDIM, p);
+	p += n * NDIM;
+	copy_n(vel[0], n * NDIM, p);
+	p += n * NDIM;
+	copy_n(dst, out.head.ndst, p);
+	out.times.push_back(t);
+
+	if(out.head.codec != SNAP_XOR){
+		fwrite(out.record.data(), sizeof(double), out.record.size(), out.file);
+		out.end += out.record.size() * sizeof(double);
+		return;
+	}
+	if((out.times.size() - 1) % out.head.key_interval == 0){
+		reset_codec(out.codec);
+	}
+	out.packed.clear();
+	encode_record(out.codec, out.record.data(), out.packed);
+	uint32_t size = out.packed.size();
+	fwrite(&size, sizeof(size), 1, out.file);
+	fwrite(out.packed.data(), 1, size, out.file);
+	out.offsets.push_back(out.end);
+	out.end += sizeof(size) + size;
+}
+
+/*-----------------------------------------------------------------------------
+ *  put_snapshot_binary  --  put_snapshot() for a binary snapshot file: the
+ *                           same arguments, with the masses including G.
+ *-----------------------------------------------------------------------------
+ */
+
+void put_snapshot_binary(snap_writer & out, const real mass[],
+						 const real pos[][NDIM], const real vel[][NDIM],
+						 const real dst[], int ndst, int n, real t){
+	if(n != out.head.n || ndst != out.head.ndst){
+		cerr << "put_snapshot_binary: record does not match the file"
+			 << endl;
+		return;
+	}
+	vector<real> & m = out.mass;
+	m.resize(n);
+	for(int i = 0; i < n; i++){ m[i] = mass[i] / G; }
+	put_snap_record(out, t, m.data(), pos, vel, dst);
+}
+
+/*-----------------------------------------------------------------------------
+ *  close_snap_writer  --  writes the time index (and for a compressed file
+ *                         the record offsets) after the last record, fills
+ *                         in the record count and index offset in the
+ *                         header, and closes the file.
+ *-----------------------------------------------------------------------------
+ */
+
+void close_snap_writer(snap_writer & out){
+	if(!out.file){ return; }
+	snap_header & h = out.head;
+	h.nrec = out.times.size();
+	h.index_offset = out.end;
+	fwrite(out.times.data(), sizeof(double), out.times.size(), out.file);
+	fwrite(out.offsets.data(), sizeof(int64_t), out.offsets.size(), out.file);
+	fseek(out.file, 0, SEEK_SET);
+	fwrite(&h, sizeof(h), 1, out.file);
+	fclose(out.file);
+	out.file = 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *  snap_file_ndim  --  returns the number of dimensions of a binary snapshot
+ *                      file, or 0 if the file is not one.  Unlike
+ *                      open_snap_reader() this accepts files of any variant,
+ *                      so that main() can pick the variant to read them with.
+ *-----------------------------------------------------------------------------
+ */
+
+int snap_file_ndim(const char *name){
+	FILE *f = fopen(name, "rb");
+	if(!f){ return 0; }
+	snap_header h;
+	bool yes = fread(&h, sizeof(h), 1, f) == 1 && known_version(h);
+	fclose(f);
+	return yes ? h.ndim : 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *  decode_packed  --  reads and decodes record r of a compressed file into
+ *                     in.record, after record r-1 or, for a key record,
+ *                     after any other.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool decode_packed(snap_reader & in, long long r){
+	uint32_t size;
+	if(fseek(in.file, in.offsets[r], SEEK_SET)
+	   || fread(&size, sizeof(size), 1, in.file) != 1){
+		return false;
+	}
+	in.packed.resize(size);
+	if(fread(in.packed.data(), 1, size, in.file) != size){ return false; }
+	if(r % in.head.key_interval == 0){ reset_codec(in.codec); }
+	return decode_record(in.codec, in.packed.data(), size, in.record.data());
+}
+
+/*-----------------------------------------------------------------------------
+ *  open_xor_index  --  reads the times and record offsets of a compressed
+ *                      file, from its index or, in an unfinished file, by
+ *                      following the byte counts and decoding the records.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool open_xor_index(snap_reader & in){
+	snap_header & h = in.head;
+	in.record.resize(record_size(h) / sizeof(double));
+	start_codec(in.codec, in.record.size(), 1 + h.n, h.keep_bits);
+	in.times.clear();
+	in.offsets.clear();
+
+	if(h.index_offset > 0){
+		in.nrec = h.nrec;
+		in.times.resize(in.nrec);
+		in.offsets.resize(in.nrec);
+		fseek(in.file, h.index_offset, SEEK_SET);
+		bool ok = fread(in.times.data(), sizeof(double), in.nrec, in.file)
+				  == (size_t) in.nrec
+			   && fread(in.offsets.data(), sizeof(int64_t), in.nrec, in.file)
+				  == (size_t) in.nrec;
+		if(!ok){
+			cerr << "open_snap_reader: cannot read the index" << endl;
+			fclose(in.file);
+			return false;
+		}
+	}else{                        // unfinished, decode complete records
+		int64_t offset = sizeof(h);
+		for(;;){
+			in.offsets.push_back(offset);
+			if(!decode_packed(in, in.offsets.size() - 1)){
+				in.offsets.pop_back();
+				break;
+			}
+			in.times.push_back(in.record[0]);
+			offset += sizeof(uint32_t) + in.packed.size();
+		}
+		in.nrec = in.times.size();
+	}
+	in.next = in.nrec;            // nothing decoded yet
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *  open_snap_reader  --  opens the binary snapshot file name for reading and
+ *                        checks that it matches this build.
+ *-----------------------------------------------------------------------------
+ */
+
+bool open_snap_reader(const char *name, snap_reader & in){
+	in.file = fopen(name, "rb");
+	if(!in.file){
+		cerr << "open_snap_reader: cannot open " << name << endl;
+		return false;
+	}
+
+	snap_header & h = in.head;
+	if(fread(&h, sizeof(h), 1, in.file) != 1 || !known_version(h)){
+		cerr << "open_snap_reader: " << name
+			 << " is not a binary snapshot file" << endl;
+		fclose(in.file);
+		return false;
+	}
+	if(h.ndim != NDIM){
+		cerr << "open_snap_reader: " << name << " has " << h.ndim
+			 << " dimensions, not " << NDIM << endl;
+		fclose(in.file);
+		return false;
+	}
+
+	if(h.codec == SNAP_XOR){
+		return open_xor_index(in);
+	}
+	if(h.index_offset > 0){
+		in.nrec = h.nrec;
+	}else{                        // unfinished, count complete records
+		fseek(in.file, 0, SEEK_END);
+		in.nrec = (ftell(in.file) - (long) sizeof(h)) / record_size(h);
+	}
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *  read_snap_record  --  reads record r, with the masses in kg.  Any of the
+ *                        arrays may be null if not needed.  In a compressed
+ *                        file, reading the records in order decodes each
+ *                        once; any other record is decoded from the key
+ *                        record before it.
+ *-----------------------------------------------------------------------------
+ */
+
+bool read_snap_record(snap_reader & in, long long r, real & t, real mass[],
+					  real pos[][NDIM], real vel[][NDIM], real dst[]){
+	if(r < 0 || r >= in.nrec){ return false; }
+	long long n = in.head.n;
+	vector<double> & rec = in.record;
+	if(in.head.codec == SNAP_XOR){
+		long long key = r - r % in.head.key_interval;
+		if(r < in.next || key > in.next){ in.next = key; }
+		for(; in.next <= r; in.next++){
+			if(!decode_packed(in, in.next)){
+				in.next = in.nrec;
+				return false;
+			}
+		}
+	}else{
+		rec.resize(record_size(in.head) / sizeof(double));
+		if(fseek(in.file, sizeof(in.head) + r * record_size(in.head),
+				 SEEK_SET)
+		   || fread(rec.data(), sizeof(double), rec.size(), in.file)
+			  != rec.size()){
+			return false;
+		}
+	}
+
+	const double *p = rec.data();
+	t = *p++;
+	if(mass){ copy_n(p, n, mass); }
+	p += n;
+	if(pos){ copy_n(p, n * NDIM, pos[0]); }
+	p += n * NDIM;
+	if(vel){ copy_n(p, n * NDIM, vel[0]); }
+	p += n * NDIM;
+	if(dst){ copy_n(p, in.head.ndst, dst); }
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *  find_snap_record  --  returns the first record at or after time t, or
+ *                        nrec if there is none, by bisection on the time
+ *                        index (or on the record times, without index).
+ *-----------------------------------------------------------------------------
+ */
+
+static double record_time(snap_reader & in, long long r){
+	if(in.head.codec == SNAP_XOR){ return in.times[r]; }
+	long long offset = in.head.index_offset > 0
+					 ? in.head.index_offset + r * (long long) sizeof(double)
+					 : sizeof(in.head) + r * record_size(in.head);
+	double t = 0;
+	fseek(in.file, offset, SEEK_SET);
+	if(fread(&t, sizeof(double), 1, in.file) != 1){ return 0; }
+	return t;
+}
+
+long long find_snap_record(snap_reader & in, real t){
+	long long lo = 0, hi = in.nrec;
+	while(lo < hi){
+		long long mid = (lo + hi) / 2;
+		if(record_time(in, mid) < t){ lo = mid + 1; }else{ hi = mid; }
+	}
+	return lo;
+}
+
+/*-----------------------------------------------------------------------------
+ *  close_snap_reader  --  closes a file opened by open_snap_reader().
+ *-----------------------------------------------------------------------------
+ */
+
+void close_snap_reader(snap_reader & in){
+	fclose(in.file);
+	in.file = 0;
+}
+
+}
\ No newline at end of file
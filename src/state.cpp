@@ -0,0 +1,63 @@
+#include <cstdlib>    // for aligned_alloc() and free()
+#include <utility>    // for swap()
+#include "nbody.h"
+#include "state.h"
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  state.cpp: the particle state of the Hermite scheme.
+ *
+ *     A Hermite step needs the positions, velocities, accelerations and
+ *     jerks at both ends of the step.  Rather than copying the current
+ *     values aside before each step, the state keeps two sets of arrays and
+ *     swap() exchanges their pointers, so that the values of the last step
+ *     become the old ones and the step writes the new ones over the values
+ *     of the step before (see evolve_step()).  That saves reading and
+ *     writing 4 * n * NDIM values per step.
+ *
+ *     All eight arrays live in one block, each starting on a 64-byte cache
+ *     line, the current ones first, so that a sweep over the particles
+ *     streams through a few contiguous arrays.
+ *-----------------------------------------------------------------------------
+ */
+
+particle_state::~particle_state(){
+	free(block);
+}
+
+/*-----------------------------------------------------------------------------
+ *  reserve  --  makes room for n particles.  The values are lost if the
+ *               block has to grow.
+ *-----------------------------------------------------------------------------
+ */
+
+void particle_state::reserve(int n){
+	if(n <= cap){ return; }
+	free(block);
+	int line = 64 / sizeof(real);
+	int len = (n * NDIM + line - 1) / line * line;   // values per array
+	cap = n;
+	block = (real *) aligned_alloc(64, 8 * len * sizeof(real));
+
+	real (**arrays[8])[NDIM] = {&pos, &vel, &acc, &jrk,
+								&old_pos, &old_vel, &old_acc, &old_jrk};
+	for(int a = 0; a < 8; a++){
+		*arrays[a] = (real (*)[NDIM]) (block + a * len);
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  swap  --  makes the current values the old ones.  The current arrays
+ *            then hold the values of the step before, to be overwritten.
+ *-----------------------------------------------------------------------------
+ */
+
+void particle_state::swap(){
+	std::swap(pos, old_pos);
+	std::swap(vel, old_vel);
+	std::swap(acc, old_acc);
+	std::swap(jrk, old_jrk);
+}
+
+}
@@ -0,0 +1,175 @@
+#include <iostream>
+#include <cmath>
+#include "nbody.h"
+#include "evolve.h"
+#include "stop.h"
+#include "options.h"
+
+using namespace std;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  stop.cpp: early termination of runs that have become unstable.
+ *
+ *     In parameter scans most systems that go unstable do so long before the
+ *     end of the run, and whatever they do afterwards is of no interest.
+ *     The conditions below are checked as the integration proceeds, and the
+ *     first one met ends it:
+ *
+ *        collision  two massive particles closer than stop_dist (-c)
+ *        escape     a massive particle farther than esc_dist from the
+ *                   center of mass (-r), and unbound from the others
+ *        hill       two massive particles other than the most massive one
+ *                   (the star) closer than hill_factor times their mutual
+ *                   Hill radius (-H)
+ *        energy     relative energy error beyond max_derr (-m)
+ *
+ *     The pairwise distances are those in dst[], as computed with the forces,
+ *     so the checks cost little next to a force calculation.  Test particles
+ *     never trigger a stop.
+ *-----------------------------------------------------------------------------
+ */
+
+/*-----------------------------------------------------------------------------
+ *  stop_checks  --  returns true if any stop condition has been set.
+ *-----------------------------------------------------------------------------
+ */
+
+bool stop_checks(const options & opt){
+	return opt.stop_dist > 0 || opt.esc_dist > 0 || opt.hill_factor > 0
+		|| opt.max_derr > 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *  total_energy  --  kinetic plus potential energy, in the same units as
+ *                    epot (that is, including G).
+ *-----------------------------------------------------------------------------
+ */
+
+real total_energy(const real mass[], const real vel[][NDIM], int n,
+				  real epot){
+	real ekin = 0;
+	for(int i = 0; i < n; i++){
+		for(int k = 0; k < NDIM; k++){
+			ekin += 0.5 * mass[i] * vel[i][k] * vel[i][k];
+		}
+	}
+	return ekin + epot;
+}
+
+/*-----------------------------------------------------------------------------
+ *  check_stop  --  checks the stop conditions set in opt for the system at
+ *                  time t, with dst[] and epot as computed for these
+ *                  positions by get_acc_jrk_pot_coll() or get_pot_dst(), and
+ *                  einit from total_energy() at the start.  Returns true,
+ *                  with the reason in why, if the run should stop.
+ *
+ *  note: dst[] must hold all pairwise distances, so the collision and Hill
+ *        checks are not available with the tree code.
+ *-----------------------------------------------------------------------------
+ */
+
+bool check_stop(const real mass[], const real pos[][NDIM],
+				const real vel[][NDIM], const real dst[], int n, real t,
+				real epot, real einit, const options & opt,
+				stop_reason & why){
+	int nm = massive_count(mass, n);
+	int w = dst_width(nm, n);
+	auto pair_dst = [&](int i, int j){     // i < j
+		return dst[dst_row(i, w) + j - i - 1];
+	};
+	why.t = t;
+
+	if(opt.stop_dist > 0){
+		for(int i = 0; i < nm; i++){
+			for(int j = i+1; j < nm; j++){
+				if(pair_dst(i, j) < opt.stop_dist){
+					why.what = "collision";
+					why.i = i;
+					why.j = j;
+					why.value = pair_dst(i, j);
+					return true;
+				}
+			}
+		}
+	}
+
+	if(opt.esc_dist > 0){
+		for(int i = 0; i < nm; i++){
+			real r2 = 0, v2 = 0;
+			for(int k = 0; k < NDIM; k++){
+				r2 += pos[i][k] * pos[i][k];
+				v2 += vel[i][k] * vel[i][k];
+			}
+			if(r2 <= opt.esc_dist * opt.esc_dist){ continue; }
+			real energy = 0.5 * v2;      // per unit mass, against the others
+			for(int j = 0; j < nm; j++){ // rare, so from the positions, which
+				if(j == i){ continue; }  // also works with the tree code
+				real d2 = 0;
+				for(int k = 0; k < NDIM; k++){
+					d2 += (pos[j][k] - pos[i][k]) * (pos[j][k] - pos[i][k]);
+				}
+				energy -= mass[j] / sqrt(d2);
+			}
+			if(energy > 0){
+				why.what = "escape";
+				why.i = i;
+				why.value = sqrt(r2);
+				return true;
+			}
+		}
+	}
+
+	if(opt.hill_factor > 0 && nm > 2){
+		int star = 0;
+		for(int i = 1; i < nm; i++){
+			if(mass[i] > mass[star]){ star = i; }
+		}
+		auto star_dst = [&](int i){
+			return i < star ? pair_dst(i, star) : pair_dst(star, i);
+		};
+		for(int i = 0; i < nm; i++){
+			if(i == star){ continue; }
+			for(int j = i+1; j < nm; j++){
+				if(j == star){ continue; }
+				real r_hill = cbrt((mass[i] + mass[j]) / (3 * mass[star]))
+							* (star_dst(i) + star_dst(j)) / 2;
+				if(pair_dst(i, j) < opt.hill_factor * r_hill){
+					why.what = "hill";
+					why.i = i;
+					why.j = j;
+					why.value = pair_dst(i, j);
+					return true;
+				}
+			}
+		}
+	}
+
+	if(opt.max_derr > 0){
+		real derr = (total_energy(mass, vel, n, epot) - einit) / einit;
+		if(fabs(derr) > opt.max_derr){
+			why.what = "energy";
+			why.value = derr;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*-----------------------------------------------------------------------------
+ *  write_stop  --  writes the reason for an early stop as a single line of
+ *                  "key=value" fields, for scripts that collect the results
+ *                  of a scan.
+ *-----------------------------------------------------------------------------
+ */
+
+void write_stop(const stop_reason & why, ostream & out){
+	streamsize precision = out.precision(16);
+	out << "stop reason=" << why.what << " t=" << why.t
+		<< " i=" << why.i << " j=" << why.j << " value=" << why.value
+		<< endl;
+	out.precision(precision);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include <iostream>
+#include <limits>
+#include <cmath>
+#include <algorithm>  // for fill()
+#include "nbody.h"
+#include "nbodyio.h"
+#include "summary.h"
+
+using namespace std;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  summary.cpp: reduced output of the pairwise distances.
+ *
+ *     A long run with frequent snapshots writes mostly distances, and the
+ *     graphs made from them mostly show averages over a time window.  With
+ *     -S, the integrator instead reduces the distances of dst[] after every
+ *     step, and writes only the reductions, once per summary interval:
+ *
+ *                      n t t0
+ *                      mean distance of each pair over [t0, t]
+ *                      minimum of each pair over [t0, t]
+ *                      maximum of each pair over [t0, t]
+ *                      closest approach of each pair since the start
+ *                      time of each closest approach
+ *                      semi-major axis of particles 1 to n-1
+ *                      eccentricity of particles 1 to n-1
+ *
+ *     one line each, with the pairs in the order of the distance line of a
+ *     snapshot.  The mean weighs the distance at the end of each step by
+ *     the step size.  The orbital elements are the osculating ones at t,
+ *     of each particle relative to particle 0 (normally the star); an
+ *     unbound orbit has a negative semi-major axis.
+ *
+ *     The reductions are cheap next to the force calculation, which has
+ *     already found the distances, and the output is a few lines of about
+ *     n*n values per interval, however short the steps.
+ *-----------------------------------------------------------------------------
+ */
+
+/*-----------------------------------------------------------------------------
+ *  start_summary  --  starts the reductions at time t, with the distances
+ *                     dst[] at that time.
+ *-----------------------------------------------------------------------------
+ */
+
+void start_summary(summary & s, const real dst[], int ndst, real t){
+	s.ndst = ndst;
+	s.sum.resize(ndst);
+	s.min.resize(ndst);
+	s.max.resize(ndst);
+	s.closest.assign(dst, dst + ndst);
+	s.t_closest.assign(ndst, t);
+	next_summary_window(s, dst, t);
+}
+
+/*-----------------------------------------------------------------------------
+ *  add_summary_step  --  adds a step of size dt, ending at time t with the
+ *                        distances dst[].
+ *-----------------------------------------------------------------------------
+ */
+
+void add_summary_step(summary & s, const real dst[], real t, real dt){
+	for(int p = 0; p < s.ndst; p++){
+		real d = dst[p];
+		s.sum[p] += d * dt;
+		if(d < s.min[p]){ s.min[p] = d; }
+		if(d > s.max[p]){ s.max[p] = d; }
+		if(d < s.closest[p]){
+			s.closest[p] = d;
+			s.t_closest[p] = t;
+		}
+	}
+	s.span += dt;
+}
+
+/*-----------------------------------------------------------------------------
+ *  next_summary_window  --  starts a new window at time t, with the
+ *                           distances dst[] at that time.
+ *-----------------------------------------------------------------------------
+ */
+
+void next_summary_window(summary & s, const real dst[], real t){
+	s.t0 = t;
+	s.span = 0;
+	fill(s.sum.begin(), s.sum.end(), 0);
+	s.min.assign(dst, dst + s.ndst);
+	s.max.assign(dst, dst + s.ndst);
+}
+
+/*-----------------------------------------------------------------------------
+ *  put_summary  --  writes the reductions of s at time t on the summary
+ *                   stream of the current output target, with the orbital
+ *                   elements of the system at that time.
+ *-----------------------------------------------------------------------------
+ */
+
+void put_summary(const real mass[], const real pos[][NDIM],
+				 const real vel[][NDIM], int n, real t, const summary & s){
+
+	ostream & out = *get_output()->sum;
+	out.precision(numeric_limits<real>::digits10 + 1);
+	out << n << ' ' << t << ' ' << s.t0 << '\n';
+
+	for(int p = 0; p < s.ndst; p++){        // an empty window has the
+		out << (s.span > 0 ? s.sum[p] / s.span : s.min[p]) << ' ';
+	}                                       // values at t0
+	out << '\n';
+	for(int p = 0; p < s.ndst; p++){ out << s.min[p] << ' '; }
+	out << '\n';
+	for(int p = 0; p < s.ndst; p++){ out << s.max[p] << ' '; }
+	out << '\n';
+	for(int p = 0; p < s.ndst; p++){ out << s.closest[p] << ' '; }
+	out << '\n';
+	for(int p = 0; p < s.ndst; p++){ out << s.t_closest[p] << ' '; }
+	out << '\n';
+
+	vector<real> ecc(n);
+	for(int i = 1; i < n; i++){
+		real gm = mass[0] + mass[i];         // the masses include G
+		real r[NDIM], v[NDIM];
+		real r2 = 0, v2 = 0, rv = 0;
+		for(int k = 0; k < NDIM; k++){
+			r[k] = pos[i][k] - pos[0][k];
+			v[k] = vel[i][k] - vel[0][k];
+			r2 += r[k] * r[k];
+			v2 += v[k] * v[k];
+			rv += r[k] * v[k];
+		}
+		real rabs = sqrt(r2);
+		out << 1 / (2 / rabs - v2 / gm) << ' ';
+
+		real e2 = 0;                         // |e| from the Laplace-Runge-
+		for(int k = 0; k < NDIM; k++){       // Lenz vector
+			real e = ((v2 - gm / rabs) * r[k] - rv * v[k]) / gm;
+			e2 += e * e;
+		}
+		ecc[i] = sqrt(e2);
+	}
+	out << '\n';
+	for(int i = 1; i < n; i++){ out << ecc[i] << ' '; }
+	out << endl;
+}
+
+}
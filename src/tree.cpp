@@ -0,0 +1,357 @@
+#include <cmath>      // to include sqrt(), etc.
+#include <cfloat>     // for DBL_MAX
+#include <vector>
+#include "nbody.h"
+#include "evolve.h"
+#include "tree.h"
+#include "parallel.h"
+
+using namespace std;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  tree.cpp: a Barnes-Hut tree code for the forces, as an O(N log N)
+ *            alternative to the direct double loop for large N.
+ *
+ *           ref.: Barnes, J. & Hut, P., 1986, Nature 324, 446-449.
+ *
+ *     Space is divided into a quadtree (2D) or octree (3D), each cell
+ *     holding the total mass, center of mass and center-of-mass velocity of
+ *     the particles inside it.  A cell of size s at distance d from a
+ *     particle is treated as a single pseudo-particle when s < theta * d
+ *     (theta is the opening angle); otherwise its children are examined.
+ *     The acceleration, jerk, potential and collision time estimates for a
+ *     pseudo-particle use the same formulas as for a real one, so the jerk
+ *     is that of the monopole moving with the cell's mean velocity.
+ *
+ *     Cells are split until they hold at most LEAF_MAX particles, and the
+ *     particles in a leaf are summed directly.  The tree is rebuilt from
+ *     scratch at every force calculation, and the walk for each particle is
+ *     independent, so the walks are shared out over the thread pool.
+ *-----------------------------------------------------------------------------
+ */
+
+const int NCHILD = 1 << NDIM;     // children per cell
+const int LEAF_MAX = 8;           // most particles in an unsplit cell
+const int DEPTH_MAX = 64;         // guards against coincident particles
+
+static real opening_angle = 0;    // theta; zero means the tree is not used
+
+struct cell {
+	real mass;
+	real com[NDIM];               // center of mass
+	real cvel[NDIM];              // center-of-mass velocity
+	real size;                    // side length of the cell
+	int first, count;             // particles order[first ... first+count-1]
+	int child[NCHILD];            // indices of child cells, -1 if none
+	bool leaf;
+};
+
+/*-----------------------------------------------------------------------------
+ *  tree  --  the cells and the particle order they refer to.  The particles
+ *            in any cell are contiguous in order[], and where[i] is the
+ *            position of particle i in order[], which tells whether a cell
+ *            contains a given particle.
+ *-----------------------------------------------------------------------------
+ */
+
+struct tree {
+	vector<cell> cells;
+	vector<int> order;
+	vector<int> where;
+	vector<int> octant;           // scratch space for the build
+	vector<int> sorted;
+};
+
+static thread_local tree current; // one per calling thread
+
+/*-----------------------------------------------------------------------------
+ *  build_cell  --  builds the cell for order[first ... first+count-1] inside
+ *                  the box with the given center and half side length,
+ *                  splitting it recursively, and returns its index.
+ *-----------------------------------------------------------------------------
+ */
+
+static int build_cell(const real mass[], const real pos[][NDIM],
+					  const real vel[][NDIM], int first, int count,
+					  const real center[], real half, int depth){
+	tree & t = current;
+	int c = t.cells.size();
+	t.cells.push_back(cell());
+	cell & nc = t.cells[c];
+	nc.size = 2*half;
+	nc.first = first;
+	nc.count = count;
+	nc.leaf = count <= LEAF_MAX || depth >= DEPTH_MAX;
+	for(int q = 0; q < NCHILD; q++){ nc.child[q] = -1; }
+
+	real m = 0, com[NDIM] = {}, cvel[NDIM] = {};
+
+	if(nc.leaf){
+		for(int s = first; s < first + count; s++){
+			int i = t.order[s];
+			m += mass[i];
+			for(int k = 0; k < NDIM; k++){
+				com[k] += mass[i] * pos[i][k];
+				cvel[k] += mass[i] * vel[i][k];
+			}
+		}
+	}else{
+		// sort the particles into the children by octant, counting first
+		int start[NCHILD + 1] = {};
+		for(int s = first; s < first + count; s++){
+			int i = t.order[s];
+			int q = 0;
+			for(int k = 0; k < NDIM; k++){
+				if(pos[i][k] >= center[k]){ q |= 1 << k; }
+			}
+			t.octant[s] = q;
+			start[q + 1]++;
+		}
+		for(int q = 0; q < NCHILD; q++){ start[q + 1] += start[q]; }
+
+		int fill[NCHILD];
+		for(int q = 0; q < NCHILD; q++){ fill[q] = first + start[q]; }
+		for(int s = first; s < first + count; s++){
+			t.sorted[fill[t.octant[s]]++] = t.order[s];
+		}
+		for(int s = first; s < first + count; s++){ t.order[s] = t.sorted[s]; }
+
+		for(int q = 0; q < NCHILD; q++){
+			int nq = start[q + 1] - start[q];
+			if(nq == 0){ continue; }
+			real sub[NDIM];
+			for(int k = 0; k < NDIM; k++){
+				sub[k] = center[k] + ((q >> k) & 1 ? half : -half) / 2;
+			}
+			int ch = build_cell(mass, pos, vel, first + start[q], nq,
+								sub, half/2, depth + 1);
+			t.cells[c].child[q] = ch;
+			const cell & cc = t.cells[ch];
+			m += cc.mass;
+			for(int k = 0; k < NDIM; k++){
+				com[k] += cc.mass * cc.com[k];
+				cvel[k] += cc.mass * cc.cvel[k];
+			}
+		}
+	}
+
+	cell & done = t.cells[c];     // the vector may have moved meanwhile
+	done.mass = m;
+	for(int k = 0; k < NDIM; k++){
+		done.com[k] = m > 0 ? com[k] / m : center[k];  // test particles only
+		done.cvel[k] = m > 0 ? cvel[k] / m : 0;
+	}
+	return c;
+}
+
+/*-----------------------------------------------------------------------------
+ *  build_tree  --  builds the whole tree in a cube enclosing all particles.
+ *-----------------------------------------------------------------------------
+ */
+
+static void build_tree(const real mass[], const real pos[][NDIM],
+					   const real vel[][NDIM], int n){
+	real lo[NDIM], hi[NDIM];
+	for(int k = 0; k < NDIM; k++){ lo[k] = hi[k] = pos[0][k]; }
+	for(int i = 1; i < n; i++){
+		for(int k = 0; k < NDIM; k++){
+			if(pos[i][k] < lo[k]){ lo[k] = pos[i][k]; }
+			if(pos[i][k] > hi[k]){ hi[k] = pos[i][k]; }
+		}
+	}
+	real center[NDIM], half = 0;
+	for(int k = 0; k < NDIM; k++){
+		center[k] = (lo[k] + hi[k]) / 2;
+		if(half < (hi[k] - lo[k]) / 2){ half = (hi[k] - lo[k]) / 2; }
+	}
+	half *= 1.0001;               // keep the extreme particles strictly inside
+
+	tree & t = current;
+	t.cells.clear();
+	t.order.resize(n);
+	t.where.resize(n);
+	t.octant.resize(n);
+	t.sorted.resize(n);
+	for(int i = 0; i < n; i++){ t.order[i] = i; }
+
+	build_cell(mass, pos, vel, 0, n, center, half, 0);
+
+	for(int s = 0; s < n; s++){ t.where[t.order[s]] = s; }
+}
+
+/*-----------------------------------------------------------------------------
+ *  interact  --  adds the acceleration, jerk and potential due to a body (or
+ *                pseudo-body) of mass mj at relative position rji and
+ *                relative velocity vji to those of particle i, and lowers
+ *                the quartic collision time estimate as needed.  The same
+ *                formulas as in get_acc_jrk_pot_coll().
+ *-----------------------------------------------------------------------------
+ */
+
+static inline void interact(real mi, real mj, const real rji[],
+							const real vji[], real acc[], real jrk[],
+							real & pot, real & coll_time_q){
+	real r2 = 0, v2 = 0, rv_r2 = 0;
+	for(int k = 0; k < NDIM; k++){
+		r2 += rji[k] * rji[k];
+		v2 += vji[k] * vji[k];
+		rv_r2 += rji[k] * vji[k];
+	}
+	rv_r2 /= r2;
+	real r = sqrt(r2);
+	real r3 = r * r2;
+
+	real da2 = 0;
+	for(int k = 0; k < NDIM; k++){
+		real da = rji[k] / r3;
+		real dj = (vji[k] - 3 * rv_r2 * rji[k]) / r3;
+		da2 += da*da;
+		acc[k] += mj * da;
+		jrk[k] += mj * dj;
+	}
+	pot -= mj / r;
+
+	real coll_est_q = (r2*r2) / (v2*v2);
+	if(coll_time_q > coll_est_q){ coll_time_q = coll_est_q; }
+
+	real mij = mi + mj;
+	coll_est_q = G*r2/(da2*mij*mij);
+	if(coll_time_q > coll_est_q){ coll_time_q = coll_est_q; }
+}
+
+/*-----------------------------------------------------------------------------
+ *  walk_tree  --  computes the force on particle i by walking the tree tr
+ *                 from the root, opening cells that are too close or that
+ *                 contain i.  Cells and particles without mass (test
+ *                 particles) are skipped.
+ *-----------------------------------------------------------------------------
+ */
+
+static void walk_tree(const tree & tr, const real mass[],
+					  const real pos[][NDIM], const real vel[][NDIM], int i,
+					  real acc[], real jrk[], real & pot, real & coll_time_q){
+	int stack[DEPTH_MAX * NCHILD + 1];
+	int top = 0;
+	stack[top++] = 0;
+
+	while(top > 0){
+		const cell & c = tr.cells[stack[--top]];
+		if(c.mass == 0){ continue; }
+		bool inside = tr.where[i] >= c.first
+				   && tr.where[i] < c.first + c.count;
+
+		real rji[NDIM], vji[NDIM];
+		if(!inside){
+			real d2 = 0;
+			for(int k = 0; k < NDIM; k++){
+				rji[k] = c.com[k] - pos[i][k];
+				d2 += rji[k] * rji[k];
+			}
+			if(c.size * c.size < opening_angle * opening_angle * d2){
+				for(int k = 0; k < NDIM; k++){ vji[k] = c.cvel[k] - vel[i][k]; }
+				interact(mass[i], c.mass, rji, vji, acc, jrk, pot, coll_time_q);
+				continue;
+			}
+		}
+
+		if(c.leaf){
+			for(int s = c.first; s < c.first + c.count; s++){
+				int j = tr.order[s];
+				if(j == i || mass[j] == 0){ continue; }
+				for(int k = 0; k < NDIM; k++){
+					rji[k] = pos[j][k] - pos[i][k];
+					vji[k] = vel[j][k] - vel[i][k];
+				}
+				interact(mass[i], mass[j], rji, vji, acc, jrk, pot,
+						 coll_time_q);
+			}
+		}else{
+			for(int q = NCHILD - 1; q >= 0; q--){
+				if(c.child[q] >= 0){ stack[top++] = c.child[q]; }
+			}
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  set_force_tree  --  selects the tree code for get_acc_jrk_pot_coll(), with
+ *                      opening angle theta, or switches it off for theta = 0.
+ *-----------------------------------------------------------------------------
+ */
+
+void set_force_tree(real theta){
+	opening_angle = theta;
+}
+
+/*-----------------------------------------------------------------------------
+ *  force_tree  --  returns true if the tree code is selected.
+ *-----------------------------------------------------------------------------
+ */
+
+bool force_tree(){
+	return opening_angle > 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *  get_acc_jrk_pot_coll_tree  --  the tree code version of
+ *                                 get_acc_jrk_pot_coll().
+ *
+ *  note: there are no pairwise distances in a tree code, so dst[] receives
+ *        only the distances from particle 0 (normally the primary) to each
+ *        of the others, or to each of the massive ones if test particle
+ *        distances are switched off; see dst_count().
+ *-----------------------------------------------------------------------------
+ */
+
+void get_acc_jrk_pot_coll_tree(const real mass[], const real pos[][NDIM],
+							   const real vel[][NDIM], real acc[][NDIM],
+							   real jrk[][NDIM], real dst[], int n,
+							   real & epot, real & coll_time){
+	build_tree(mass, pos, vel, n);
+
+	int ntasks = pair_task_count(n * log2(n + 1.0));
+	real *task_epot = new real[ntasks];
+	real *task_coll_q = new real[ntasks];
+	const tree & tr = current;    // thread_local; the tasks need this one
+	int nm = massive_count(mass, n);
+	bool test_coll = test_particle_coll();
+
+	parallel_for(ntasks, [&](int k){
+		task_epot[k] = 0;
+		task_coll_q[k] = DBL_MAX;
+		int i1 = (long long) n * (k+1) / ntasks;
+		for(int i = (long long) n * k / ntasks; i < i1; i++){
+			real pot = 0;
+			real test_coll_q = DBL_MAX;       // ignored unless test_coll
+			for(int d = 0; d < NDIM; d++){ acc[i][d] = jrk[i][d] = 0; }
+			walk_tree(tr, mass, pos, vel, i, acc[i], jrk[i], pot,
+					  i < nm || test_coll ? task_coll_q[k] : test_coll_q);
+			task_epot[k] += 0.5 * mass[i] * pot;
+		}
+	});
+
+	epot = 0;
+	real coll_time_q = DBL_MAX;
+	for(int k = 0; k < ntasks; k++){
+		epot += task_epot[k];
+		if(coll_time_q > task_coll_q[k]){ coll_time_q = task_coll_q[k]; }
+	}
+	coll_time = sqrt(sqrt(coll_time_q));
+
+	int w = dst_width(nm, n);
+	for(int i = 1; i < w; i++){
+		real r2 = 0;
+		for(int k = 0; k < NDIM; k++){
+			real d = pos[i][k] - pos[0][k];
+			r2 += d * d;
+		}
+		dst[i-1] = sqrt(r2);
+	}
+
+	delete[] task_epot;
+	delete[] task_coll_q;
+}
+
+}
\ No newline at end of file
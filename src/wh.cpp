@@ -0,0 +1,437 @@
+#include <iostream>
+#include <cmath>      // to include sqrt(), fmod(), etc.
+#include <algorithm>  // for copy() and swap()
+#include "nbody.h"
+#include "evolve.h"
+#include "wh.h"
+#include "writer.h"
+#include "stop.h"
+#include "options.h"
+
+using namespace std;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  wh.cpp: a Wisdom-Holman symplectic integrator for systems dominated by
+ *          one central body, particle 0 (the star).
+ *
+ *     ref.: Wisdom, J. & Holman, M., 1991, Astronomical Journal 102,
+ *           1528-1538.
+ *           Duncan, M., Levison, H. & Lee, M. H., 1998, Astronomical
+ *           Journal 116, 2067-2077.
+ *
+ *     The Hamiltonian is split, in democratic heliocentric coordinates
+ *     (positions relative to the star, barycentric velocities), into
+ *
+ *        Kepler       each body on a Kepler orbit around the star alone,
+ *                     solved exactly by kepler_drift()
+ *        interaction  the mutual attraction of the bodies other than the
+ *                     star, which changes only their velocities (a kick)
+ *        sun          the motion of the star due to the total momentum of
+ *                     the others, which changes only their positions
+ *
+ *     and each step is the symmetric sequence sun, Kepler (half a step
+ *     each), interaction (a whole step), Kepler, sun (half a step each).
+ *     The Kepler part takes care of the dominant motion exactly, so the step
+ *     can be a sizeable fraction of the shortest orbital period, instead of
+ *     a fraction of the close encounter time scale as in the Hermite scheme.
+ *     The step size is fixed, which keeps the scheme symplectic: the energy
+ *     error oscillates, but does not grow secularly.  The price is that
+ *     close encounters between the bodies are not resolved.
+ *
+ *     Masses include G, as everywhere else, so mass[0] is the G*M of the
+ *     central Kepler problems.  Test particles feel the star and the massive
+ *     bodies, as in the Hermite scheme.
+ *-----------------------------------------------------------------------------
+ */
+
+/*-----------------------------------------------------------------------------
+ *  stumpff  --  the Stumpff functions c0(x) to c3(x), by their series for
+ *               small |x|, where the closed forms lose precision.
+ *-----------------------------------------------------------------------------
+ */
+
+static void stumpff(real x, real c[4]){
+	if(fabs(x) < 1){
+		real c2 = 0, c3 = 0, term2 = 0.5, term3 = 1.0/6;
+		for(int k = 1; k <= 12; k++){
+			c2 += term2;
+			c3 += term3;
+			term2 *= -x / ((2*k + 1) * (2*k + 2));
+			term3 *= -x / ((2*k + 2) * (2*k + 3));
+		}
+		c[2] = c2;
+		c[3] = c3;
+		c[1] = 1 - x * c3;
+		c[0] = 1 - x * c2;
+	}else if(x > 0){
+		real z = sqrt(x);
+		real h = sin(z / 2);
+		c[0] = cos(z);
+		c[1] = sin(z) / z;
+		c[2] = 2 * h * h / x;
+		c[3] = (1 - c[1]) / x;
+	}else{
+		real z = sqrt(-x);
+		real h = sinh(z / 2);
+		c[0] = cosh(z);
+		c[1] = sinh(z) / z;
+		c[2] = -2 * h * h / x;
+		c[3] = (1 - c[1]) / x;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  kepler_drift  --  advances a body at pos with velocity vel relative to a
+ *                    central mass gm (including G) by a time dt along its
+ *                    Kepler orbit, elliptic or hyperbolic, with the f and g
+ *                    functions in universal variables.
+ *
+ *     ref.: Danby, J. M. A., 1988, Fundamentals of Celestial Mechanics,
+ *           2nd ed., Willmann-Bell, ch. 6.
+ *
+ *  Kepler's equation in the universal anomaly s is solved with the
+ *  Laguerre-Conway iteration, which converges from the simple starting value
+ *  s = dt/r for any orbit.  Bound orbits are first reduced to less than one
+ *  period.
+ *-----------------------------------------------------------------------------
+ */
+
+void kepler_drift(real gm, real pos[NDIM], real vel[NDIM], real dt){
+	real r0 = 0, v2 = 0, eta = 0;
+	for(int k = 0; k < NDIM; k++){
+		r0 += pos[k] * pos[k];
+		v2 += vel[k] * vel[k];
+		eta += pos[k] * vel[k];
+	}
+	r0 = sqrt(r0);
+	real beta = 2 * gm / r0 - v2;        // -2 times the orbital energy
+
+	if(beta > 0){
+		real period = 2 * M_PI * gm / (beta * sqrt(beta));
+		dt = fmod(dt, period);
+	}
+
+	real s = dt / r0;
+	real c[4], g1, g2, g3, r;
+	for(int iter = 0; iter < 50; iter++){
+		stumpff(beta * s * s, c);
+		g1 = s * c[1];
+		g2 = s * s * c[2];
+		g3 = s * s * s * c[3];
+		real f = r0 * g1 + eta * g2 + gm * g3 - dt;
+		r = r0 * c[0] + eta * g1 + gm * g2;         // df/ds
+		real fpp = eta * c[0] + (gm - beta * r0) * g1;
+		real root = sqrt(fabs(16 * r * r - 20 * f * fpp));
+		real ds = -5 * f / (r + (r < 0 ? -root : root));
+		s += ds;
+		if(fabs(ds) <= 1e-15 * fabs(s)){ break; }
+	}
+	stumpff(beta * s * s, c);
+	g1 = s * c[1];
+	g2 = s * s * c[2];
+	r = r0 * c[0] + eta * g1 + gm * g2;
+
+	real f = 1 - gm * g2 / r0;
+	real g = r0 * g1 + eta * g2;
+	real fdot = -gm * g1 / (r0 * r);
+	real gdot = 1 - gm * g2 / r;
+	for(int k = 0; k < NDIM; k++){
+		real x = pos[k], v = vel[k];
+		pos[k] = f * x + g * v;
+		vel[k] = fdot * x + gdot * v;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  wh_time_step  --  returns the given fraction of the shortest orbital
+ *                    period of a body bound to particle 0, from the
+ *                    osculating heliocentric orbits.  Returns 0, with a
+ *                    message, if the system does not suit the scheme:
+ *                    particle 0 is not the most massive one, or nothing is
+ *                    bound to it.
+ *-----------------------------------------------------------------------------
+ */
+
+real wh_time_step(const real mass[], const real pos[][NDIM],
+				  const real vel[][NDIM], int n, real fraction){
+	for(int i = 1; i < n; i++){
+		if(mass[i] > mass[0]){
+			cerr << "wh_time_step: particle 0 must be the most massive"
+				 << " (the central body)" << endl;
+			return 0;
+		}
+	}
+
+	real period = 0;
+	for(int i = 1; i < n; i++){
+		real gm = mass[0] + mass[i];
+		real r = 0, v2 = 0;
+		for(int k = 0; k < NDIM; k++){
+			r += (pos[i][k] - pos[0][k]) * (pos[i][k] - pos[0][k]);
+			v2 += (vel[i][k] - vel[0][k]) * (vel[i][k] - vel[0][k]);
+		}
+		real beta = 2 * gm / sqrt(r) - v2;
+		if(beta <= 0){ continue; }
+		real p = 2 * M_PI * gm / (beta * sqrt(beta));
+		if(period == 0 || p < period){ period = p; }
+	}
+	if(period == 0){
+		cerr << "wh_time_step: no orbits bound to particle 0" << endl;
+	}
+	return fraction * period;
+}
+
+/*-----------------------------------------------------------------------------
+ *  to_democratic, from_democratic  --  convert between barycentric positions
+ *                                      and velocities and the democratic
+ *                                      heliocentric coordinates: positions
+ *                                      hpos relative to particle 0, and
+ *                                      barycentric velocities bvel.  Entry 0
+ *                                      of hpos and bvel is not used.
+ *
+ *  note: the center of mass is assumed to be at rest at the origin, as set
+ *        up on input by set_up_snapshot().
+ *-----------------------------------------------------------------------------
+ */
+
+void to_democratic(const real mass[], const real pos[][NDIM],
+				   const real vel[][NDIM], int n, real hpos[][NDIM],
+				   real bvel[][NDIM]){
+	for(int i = 1; i < n; i++){
+		for(int k = 0; k < NDIM; k++){
+			hpos[i][k] = pos[i][k] - pos[0][k];
+			bvel[i][k] = vel[i][k];
+		}
+	}
+}
+
+void from_democratic(const real mass[], const real hpos[][NDIM],
+					 const real bvel[][NDIM], int n, real pos[][NDIM],
+					 real vel[][NDIM]){
+	real mtot = mass[0];
+	real x0[NDIM] = {}, p[NDIM] = {};
+	for(int i = 1; i < n; i++){
+		mtot += mass[i];
+		for(int k = 0; k < NDIM; k++){
+			x0[k] -= mass[i] * hpos[i][k];
+			p[k] += mass[i] * bvel[i][k];
+		}
+	}
+	for(int k = 0; k < NDIM; k++){
+		pos[0][k] = x0[k] / mtot;
+		vel[0][k] = -p[k] / mass[0];
+	}
+	for(int i = 1; i < n; i++){
+		for(int k = 0; k < NDIM; k++){
+			pos[i][k] = hpos[i][k] + pos[0][k];
+			vel[i][k] = bvel[i][k];
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  sun_drift  --  moves all bodies by the motion of the star over dt, which
+ *                 follows from the total momentum of the massive ones.
+ *-----------------------------------------------------------------------------
+ */
+
+static void sun_drift(const real mass[], real hpos[][NDIM],
+					  const real bvel[][NDIM], int n, int nm, real dt){
+	real p[NDIM] = {};
+	for(int i = 1; i < nm; i++){
+		for(int k = 0; k < NDIM; k++){ p[k] += mass[i] * bvel[i][k]; }
+	}
+	for(int i = 1; i < n; i++){
+		for(int k = 0; k < NDIM; k++){ hpos[i][k] += dt * p[k] / mass[0]; }
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  interaction_kick  --  changes the velocities by the mutual attraction of
+ *                        all bodies but the star over dt.  Test particles
+ *                        only feel the massive bodies.
+ *-----------------------------------------------------------------------------
+ */
+
+static void interaction_kick(const real mass[], const real hpos[][NDIM],
+							 real bvel[][NDIM], real acc[][NDIM], int n,
+							 int nm, real dt){
+	for(int i = 1; i < n; i++){
+		for(int k = 0; k < NDIM; k++){ acc[i][k] = 0; }
+	}
+	for(int i = 1; i < n; i++){
+		for(int j = (i < nm ? i+1 : 1); j < nm; j++){
+			real rji[NDIM];
+			real r2 = 0;
+			for(int k = 0; k < NDIM; k++){
+				rji[k] = hpos[j][k] - hpos[i][k];
+				r2 += rji[k] * rji[k];
+			}
+			real r3 = r2 * sqrt(r2);
+			for(int k = 0; k < NDIM; k++){
+				acc[i][k] += mass[j] * rji[k] / r3;
+				if(i < nm){ acc[j][k] -= mass[i] * rji[k] / r3; }
+			}
+		}
+	}
+	for(int i = 1; i < n; i++){
+		for(int k = 0; k < NDIM; k++){ bvel[i][k] += dt * acc[i][k]; }
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  wh_step  --  one Wisdom-Holman step of size dt in democratic heliocentric
+ *               coordinates; acc[] is scratch space for n particles.
+ *-----------------------------------------------------------------------------
+ */
+
+void wh_step(const real mass[], real hpos[][NDIM], real bvel[][NDIM],
+			 real acc[][NDIM], int n, real dt){
+	int nm = massive_count(mass, n);
+	sun_drift(mass, hpos, bvel, n, nm, dt/2);
+	for(int i = 1; i < n; i++){ kepler_drift(mass[0], hpos[i], bvel[i], dt/2); }
+	interaction_kick(mass, hpos, bvel, acc, n, nm, dt);
+	for(int i = 1; i < n; i++){ kepler_drift(mass[0], hpos[i], bvel[i], dt/2); }
+	sun_drift(mass, hpos, bvel, n, nm, dt/2);
+}
+
+/*-----------------------------------------------------------------------------
+ *  evolve_wh  --  integrates an N-body system for a total duration dt_tot
+ *                 with the Wisdom-Holman scheme, at a fixed step dt (see
+ *                 wh_time_step()).  Output follows the same rules as
+ *                 evolve().
+ *
+ *  With dense output (e_flag) the steps stay on the fixed grid, which keeps
+ *  the scheme symplectic; a copy of the state is taken from the start of the
+ *  step that contains an output time to that time with one shorter step,
+ *  and written.  Only at the end time, or at a stop, does the run itself
+ *  continue from such a copy.
+ *
+ *  Between outputs the system is kept in democratic heliocentric
+ *  coordinates.  At output times it is converted back, and the forces are
+ *  computed once for the potential energy, distances and (for x_flag) the
+ *  accelerations and jerks.  Stop conditions are checked at those times
+ *  only, as in evolve_block().
+ *-----------------------------------------------------------------------------
+ */
+
+stop_reason evolve_wh(const real mass[], real pos[][NDIM], real vel[][NDIM],
+					  real dst[], int n, real t, real dt,
+					  const options & opt){
+
+	real dt_dia = opt.dt_dia;
+	real dt_out = opt.dt_out;
+	real dt_tot = opt.dt_tot;
+	bool x_flag = opt.x_flag;
+	bool e_flag = opt.e_flag;
+
+	real (* acc)[NDIM] = new real[n][NDIM];   // for diagnostics only
+	real (* jrk)[NDIM] = new real[n][NDIM];
+	real (* hpos)[NDIM] = new real[n][NDIM];  // democratic heliocentric
+	real (* bvel)[NDIM] = new real[n][NDIM];  // coordinates
+	real (* kick)[NDIM] = new real[n][NDIM];  // scratch for wh_step()
+	real (* out_hpos)[NDIM] = e_flag ? new real[n][NDIM] : 0;  // taken to
+	real (* out_bvel)[NDIM] = e_flag ? new real[n][NDIM] : 0;  // t_out
+
+	real epot;
+	real coll_time;           // not used
+
+	get_acc_jrk_pot_coll(mass, pos, vel, acc, jrk, dst, n, epot, coll_time);
+	real einit = total_energy(mass, vel, n, epot);
+	bool checking = stop_checks(opt);
+	stop_reason why;
+
+	queue_diagnostics(mass, pos, vel, acc, jrk,
+					  n, t, epot, 0, x_flag);
+
+	queue_snapshot(mass, pos, vel, dst, dst_count(mass, n), n, t);
+
+	to_democratic(mass, pos, vel, n, hpos, bvel);
+
+	real t_dia = t + dt_dia;  // next time for diagnostics output
+	real t_out = t + dt_out;  // next time for snapshot output
+	real t_end = t + dt_tot;  // final time, to finish the integration
+
+	real t_start = t;         // dense output comes at t_start + k*dt_out,
+	int k_out = 1;            // and at t_end
+	if(e_flag && t_out > t_end){ t_out = t_end; }
+
+	int nsteps = 0;           // number of integration time steps completed
+	bool done = false;        // dense output reached t_end, or a stop
+	while(t < t_end){
+		while(e_flag && t_out <= t + dt){
+			copy(&hpos[0][0], &hpos[0][0] + n*NDIM, &out_hpos[0][0]);
+			copy(&bvel[0][0], &bvel[0][0] + n*NDIM, &out_bvel[0][0]);
+			wh_step(mass, out_hpos, out_bvel, kick, n, t_out - t);
+			from_democratic(mass, out_hpos, out_bvel, n, pos, vel);
+			get_acc_jrk_pot_coll(mass, pos, vel, acc, jrk, dst, n, epot,
+								 coll_time);
+			done = (checking && check_stop(mass, pos, vel, dst, n, t_out,
+										   epot, einit, opt, why))
+				|| t_out == t_end;
+			queue_snapshot(mass, pos, vel, dst, dst_count(mass, n), n,
+						   t_out);
+			if(done){ break; }
+			t_out = t_start + ++k_out * dt_out;
+			if(t_out > t_end){ t_out = t_end; }
+		}
+		if(done){
+			swap(hpos, out_hpos);
+			swap(bvel, out_bvel);
+			t = t_out;
+			nsteps++;
+			break;
+		}
+
+		wh_step(mass, hpos, bvel, kick, n, dt);
+		t += dt;
+		nsteps++;
+
+		bool dia_due = dt_dia > 0 && t >= t_dia;
+		bool out_due = !e_flag && t >= t_out;
+		if(dia_due || out_due){
+			from_democratic(mass, hpos, bvel, n, pos, vel);
+			get_acc_jrk_pot_coll(mass, pos, vel, acc, jrk, dst, n, epot,
+								 coll_time);
+		}
+		bool stop = (dia_due || out_due) && checking
+				 && check_stop(mass, pos, vel, dst, n, t, epot, einit, opt,
+							   why);
+		if(dia_due){
+			queue_diagnostics(mass, pos, vel, acc, jrk,
+							  n, t, epot, nsteps, x_flag);
+			do{ t_dia += dt_dia; } while(t_dia < t);
+		}
+		if(out_due){
+			queue_snapshot(mass, pos, vel, dst, dst_count(mass, n), n, t);
+			do{ t_out += dt_out; } while(t_out < t);
+		}
+		if(stop){
+			if(!out_due){
+				queue_snapshot(mass, pos, vel, dst, dst_count(mass, n), n, t);
+			}
+			break;
+		}
+	}
+
+	from_democratic(mass, hpos, bvel, n, pos, vel);
+	if(dt_dia == 0 || t > (t_dia - dt_dia)){
+		get_acc_jrk_pot_coll(mass, pos, vel, acc, jrk, dst, n, epot,
+							 coll_time);
+		queue_diagnostics(mass, pos, vel, acc, jrk,
+						  n, t, epot, nsteps, x_flag);
+	}
+
+	delete[] acc;
+	delete[] jrk;
+	delete[] hpos;
+	delete[] bvel;
+	delete[] kick;
+	delete[] out_hpos;
+	delete[] out_bvel;
+	return why;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,267 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <queue>
+#include <cstring>
+#include "nbody.h"
+#include "nbodyio.h"
+#include "summary.h"
+#include "writer.h"
+
+using namespace std;
+
+namespace NBODY_VARIANT {
+
+/*-----------------------------------------------------------------------------
+ *  writer.cpp: asynchronous output.
+ *
+ *     Formatting and writing snapshots and diagnostics takes long enough to
+ *     stall the integration noticeably when output is frequent.  Once
+ *     start_writer() has been called, queue_snapshot(), queue_diagnostics()
+ *     and queue_summary() only copy the data into a free buffer from a small
+ *     pool and return, and a background thread passes the buffers on to
+ *     put_snapshot(), write_diagnostics() and put_summary() in the order
+ *     they were queued, each with the output target (see set_output())
+ *     that was current in the thread that queued it.  When all buffers are
+ *     waiting to be written, the integrator waits for the writer to free
+ *     one, so a slow output device holds up the run rather than filling
+ *     the memory.
+ *
+ *     Without start_writer(), or with a depth of 0, the output functions are
+ *     called directly, as before.
+ *-----------------------------------------------------------------------------
+ */
+
+/*-----------------------------------------------------------------------------
+ *  out_record  --  one queued snapshot, diagnostics or summary output, with
+ *                  copies of all the data it needs.  The vectors keep their
+ *                  capacity when a buffer is reused, so there is no
+ *                  allocation after the first few outputs.
+ *-----------------------------------------------------------------------------
+ */
+
+enum out_kind { OUT_SNAPSHOT, OUT_DIAGNOSTICS, OUT_SUMMARY };
+
+struct out_record {
+	out_kind kind;
+	output_target *to;        // the output target of the queueing thread
+	int n, ndst, nsteps;
+	bool x_flag;
+	real t, epot;
+	vector<real> mass, dst;
+	vector<real> pos, vel, acc, jrk;   // n*NDIM each
+	summary sum;
+};
+
+static vector<out_record> pool;
+static queue<int> free_bufs;      // indices into pool
+static queue<int> ready;          // queued for writing, oldest first
+static long long nqueued = 0;     // records queued since the start
+static long long nwritten = 0;    // and written
+static bool stopping = false;
+static thread writer;
+static mutex out_mutex;           // guards everything above
+static condition_variable ready_cv;
+static condition_variable free_cv;
+static condition_variable written_cv;
+
+static void write_record(out_record & r){
+	set_output(r.to);
+	real (* pos)[NDIM] = (real (*)[NDIM]) r.pos.data();
+	real (* vel)[NDIM] = (real (*)[NDIM]) r.vel.data();
+	if(r.kind == OUT_DIAGNOSTICS){
+		real (* acc)[NDIM] = (real (*)[NDIM]) r.acc.data();
+		real (* jrk)[NDIM] = (real (*)[NDIM]) r.jrk.data();
+		write_diagnostics(r.mass.data(), pos, vel, acc, jrk, r.n, r.t,
+						  r.epot, r.nsteps, r.x_flag);
+	}else if(r.kind == OUT_SUMMARY){
+		put_summary(r.mass.data(), pos, vel, r.n, r.t, r.sum);
+	}else{
+		put_snapshot(r.mass.data(), pos, vel, r.dst.data(), r.ndst, r.n, r.t);
+	}
+}
+
+static void write_loop(){
+	unique_lock<mutex> lock(out_mutex);
+	for(;;){
+		ready_cv.wait(lock, []{ return stopping || !ready.empty(); });
+		if(ready.empty()){ return; }      // stopping, and all written
+		int b = ready.front();
+		ready.pop();
+		lock.unlock();
+
+		write_record(pool[b]);
+
+		lock.lock();
+		nwritten++;
+		free_bufs.push(b);
+		free_cv.notify_one();
+		written_cv.notify_all();
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *  start_writer  --  starts the writer thread, with depth buffers for output
+ *                    waiting to be written.  A depth of 0 keeps all output
+ *                    synchronous.
+ *-----------------------------------------------------------------------------
+ */
+
+void start_writer(int depth){
+	if(depth < 1 || writer.joinable()){ return; }
+	pool.assign(depth, out_record());
+	for(int b = 0; b < depth; b++){ free_bufs.push(b); }
+	stopping = false;
+	writer = thread(write_loop);
+}
+
+/*-----------------------------------------------------------------------------
+ *  flush_writer  --  waits until everything queued so far has been written.
+ *                    Output queued later, by other threads, is not waited
+ *                    for, so a thread can flush its own output while others
+ *                    keep the writer busy.
+ *-----------------------------------------------------------------------------
+ */
+
+void flush_writer(){
+	unique_lock<mutex> lock(out_mutex);
+	long long target = nqueued;
+	written_cv.wait(lock, [target]{ return nwritten >= target; });
+}
+
+/*-----------------------------------------------------------------------------
+ *  stop_writer  --  writes what is still queued and stops the writer thread.
+ *-----------------------------------------------------------------------------
+ */
+
+void stop_writer(){
+	if(!writer.joinable()){ return; }
+	{
+		lock_guard<mutex> lock(out_mutex);
+		stopping = true;
+	}
+	ready_cv.notify_one();
+	writer.join();
+	pool.clear();
+	free_bufs = queue<int>();
+}
+
+/*-----------------------------------------------------------------------------
+ *  take_buffer, queue_buffer  --  get a free buffer, waiting for the writer
+ *                                 if there is none, and hand a filled one to
+ *                                 the writer.
+ *-----------------------------------------------------------------------------
+ */
+
+static out_record & take_buffer(int & b){
+	unique_lock<mutex> lock(out_mutex);
+	free_cv.wait(lock, []{ return !free_bufs.empty(); });
+	b = free_bufs.front();
+	free_bufs.pop();
+	return pool[b];
+}
+
+static void queue_buffer(int b){
+	{
+		lock_guard<mutex> lock(out_mutex);
+		ready.push(b);
+		nqueued++;
+	}
+	ready_cv.notify_one();
+}
+
+static void copy_vectors(vector<real> & to, const real from[][NDIM], int n){
+	to.resize(n * NDIM);
+	memcpy(to.data(), from, n * NDIM * sizeof(real));
+}
+
+/*-----------------------------------------------------------------------------
+ *  queue_snapshot  --  put_snapshot(), through the writer thread if running.
+ *-----------------------------------------------------------------------------
+ */
+
+void queue_snapshot(const real mass[], const real pos[][NDIM],
+					const real vel[][NDIM], const real dst[], int ndst,
+					int n, real t){
+	if(!writer.joinable()){
+		put_snapshot(mass, pos, vel, dst, ndst, n, t);
+		return;
+	}
+
+	int b;
+	out_record & r = take_buffer(b);
+	r.kind = OUT_SNAPSHOT;
+	r.to = get_output();
+	r.n = n;
+	r.ndst = ndst;
+	r.t = t;
+	r.mass.assign(mass, mass + n);
+	copy_vectors(r.pos, pos, n);
+	copy_vectors(r.vel, vel, n);
+	r.dst.assign(dst, dst + ndst);
+	queue_buffer(b);
+}
+
+/*-----------------------------------------------------------------------------
+ *  queue_diagnostics  --  write_diagnostics(), through the writer thread if
+ *                         running.  Positions, accelerations and jerks are
+ *                         only copied when x_flag asks for them.
+ *-----------------------------------------------------------------------------
+ */
+
+void queue_diagnostics(const real mass[], const real pos[][NDIM],
+					   const real vel[][NDIM], const real acc[][NDIM],
+					   const real jrk[][NDIM], int n, real t, real epot,
+					   int nsteps, bool x_flag){
+	if(!writer.joinable()){
+		write_diagnostics(mass, pos, vel, acc, jrk, n, t, epot, nsteps,
+						  x_flag);
+		return;
+	}
+
+	int b;
+	out_record & r = take_buffer(b);
+	r.kind = OUT_DIAGNOSTICS;
+	r.to = get_output();
+	r.n = n;
+	r.t = t;
+	r.epot = epot;
+	r.nsteps = nsteps;
+	r.x_flag = x_flag;
+	r.mass.assign(mass, mass + n);
+	copy_vectors(r.vel, vel, n);
+	if(x_flag){
+		copy_vectors(r.pos, pos, n);
+		copy_vectors(r.acc, acc, n);
+		copy_vectors(r.jrk, jrk, n);
+	}
+	queue_buffer(b);
+}
+
+/*-----------------------------------------------------------------------------
+ *  queue_summary  --  put_summary(), through the writer thread if running.
+ *-----------------------------------------------------------------------------
+ */
+
+void queue_summary(const real mass[], const real pos[][NDIM],
+				   const real vel[][NDIM], int n, real t, const summary & s){
+	if(!writer.joinable()){
+		put_summary(mass, pos, vel, n, t, s);
+		return;
+	}
+
+	int b;
+	out_record & r = take_buffer(b);
+	r.kind = OUT_SUMMARY;
+	r.to = get_output();
+	r.n = n;
+	r.t = t;
+	r.mass.assign(mass, mass + n);
+	copy_vectors(r.pos, pos, n);
+	copy_vectors(r.vel, vel, n);
+	r.sum = s;
+	queue_buffer(b);
+}
+
+}
\ No newline at end of file